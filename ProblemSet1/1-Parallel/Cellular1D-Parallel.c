@@ -18,6 +18,8 @@
  *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  * */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,104 +27,340 @@
 #include <time.h>
 #include <unistd.h>
 #include "functions.h"
+#include "output.h"
+#include "bench.h"
+#include "trace.h"
+#include "balance.h"
+#include "generator.h"
 
 #define MAX_CHAR 1024
+#define NUM_GHOST_REQUESTS 4 //two receives and two sends per generation
+#define OUTPUT_FRAMES 64     //vectors that can wait to be printed, in rank 0
 
 /**
  * Function used to free all the memory allocations (if any),
  * close the files used (if any) and call finalize MPI
  * for termination of the program
  * */
-void program_destroy(FILE* f1, FILE* f2, char* array1, 
-                char* array2, int* count1, int* count2){
+void program_destroy(FILE* f1, FILE* f2, char* array1, char* array2, char* array3,
+                int* count1, int* count2){
     if (f1) fclose(f1);
     if (f2) fclose(f2);
     if (array1) free(array1);
     if (array2) free(array2);
+    if (array3) free(array3);
     if (count1) free(count1);
     if (count2) free(count2);
     MPI_Finalize();
 }
 
+/**
+ * Gathers the slices of the vector into a frame of output, which is
+ * printed by a thread of its own (with spaces for the character 0 and #
+ * for the character 1, for visualization purposes) while the next
+ * generations are computed. output is only given in rank 0, the other
+ * processes pass NULL. The wait for a free frame and the gather are timed
+ * as the given generation
+ * */
+void queue_vector(output_pipeline* output, const char* cells, int count, const int* sendcounts,
+                  const int* displacements, int tam, trace_log* trace, int generation){
+    double since = trace_now(trace);
+    char* vector = output ? output_frame_begin(output, 1, tam, "") : NULL;
+
+    if (output) trace_mark(trace, 0, TRACE_PRINT, generation, &since);
+    MPI_Gatherv(cells, count, MPI_CHAR, vector, sendcounts, displacements, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (output) output_frame_end(output);
+    trace_mark(trace, 0, TRACE_GATHER, generation, &since);
+}
+
+/**
+ * Creates the persistent requests that fill the ghost cells of cells (the
+ * ghost cells at each end of the slice, cells[0..ghost-1] and
+ * cells[count+ghost..count+2*ghost-1]) with the boundary cells of the
+ * neighbor processes, and send them the boundary cells of this slice.
+ * The vector is a ring, so the first process and the last one are neighbors
+ * */
+void ghost_requests_init(char* cells, int count, int ghost, int left, int right, MPI_Request* requests){
+    MPI_Recv_init(&cells[count+ghost], ghost, MPI_CHAR, right, 0, MPI_COMM_WORLD, &requests[0]);
+    MPI_Recv_init(&cells[0], ghost, MPI_CHAR, left, 1, MPI_COMM_WORLD, &requests[1]);
+    MPI_Send_init(&cells[ghost], ghost, MPI_CHAR, left, 0, MPI_COMM_WORLD, &requests[2]);
+    MPI_Send_init(&cells[count], ghost, MPI_CHAR, right, 1, MPI_COMM_WORLD, &requests[3]);
+}
+
+/**
+ * Reads the count cells of the slice that starts at cell displacement of
+ * the vector straight from the file path with MPI-IO, all the processes
+ * at once. The cells of the vector follow the first line of the file
+ * (header_size bytes) without separators. Returns 0 if every process got
+ * its cells and they are all '0' or '1', and -1 otherwise
+ * */
+int read_slice(const char* path, long header_size, char* cells, int count, int displacement){
+    MPI_File fh;
+    MPI_Status read_status;
+    int i, received = 0, status = 0;
+
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) return -1;
+    MPI_File_set_view(fh, (MPI_Offset)header_size + displacement, MPI_CHAR, MPI_CHAR, "native", MPI_INFO_NULL);
+    if (MPI_File_read_all(fh, cells, count, MPI_CHAR, &read_status) != MPI_SUCCESS) status = -1;
+    else MPI_Get_count(&read_status, MPI_CHAR, &received);
+    MPI_File_close(&fh);
+
+    if (received != count) status = -1;
+    for(i=0; i<count && status == 0; i++)
+        if (cells[i] != '0' && cells[i] != '1') status = -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    return status;
+}
+
+/**
+ * Writes the vector to path in the format of the initial configuration,
+ * every process writing its count cells at once with MPI-IO, so that the
+ * whole vector is never held by a single process.
+ * Returns 0 on success and -1 otherwise (on every process)
+ * */
+int write_snapshot(const char* path, const char* cells, int count, int displacement, int tam){
+    MPI_File fh;
+    char size[MAX_CHAR];
+    int current_id, num_procs, header_size, status = 0;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &current_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    header_size = snprintf(size, sizeof size, "%d\n", tam);
+
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh)
+            != MPI_SUCCESS){
+        if (current_id == 0) fprintf(stderr, "%s: the snapshot could not be created\n", path);
+        return -1;
+    }
+    MPI_File_set_size(fh, (MPI_Offset)header_size + tam + 1);
+    if (current_id == 0
+        && MPI_File_write_at(fh, 0, size, header_size, MPI_CHAR, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+        status = -1;
+    if (current_id == num_procs - 1
+        && MPI_File_write_at(fh, (MPI_Offset)header_size + tam, "\n", 1, MPI_CHAR, MPI_STATUS_IGNORE)
+           != MPI_SUCCESS)
+        status = -1;
+
+    MPI_File_set_view(fh, (MPI_Offset)header_size + displacement, MPI_CHAR, MPI_CHAR, "native", MPI_INFO_NULL);
+    if (MPI_File_write_all(fh, cells, count, MPI_CHAR, MPI_STATUS_IGNORE) != MPI_SUCCESS) status = -1;
+    MPI_File_close(&fh);
+
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (status != 0 && current_id == 0) fprintf(stderr, "%s: the snapshot could not be written\n", path);
+    return status;
+}
 
-/**Function that receives an input string and the transformation function
- * file and returns the output according to the file. In case of error
- * returns the string "E"
+/**
+ * Computes the cells first..last of the next generation of cells
  * */
-char* transform(char* in, FILE * funct){
-    char line[MAX_CHAR];
-    char *function_input = NULL, *function_output = NULL;
-    rewind(funct);
-    while(fgets(line, sizeof line, funct)!= NULL){ 
-      function_input = strtok(line, " ");
-      function_output = strtok(NULL, " ");
-      if (strcmp(function_input, in) == 0){
-          return function_output;
-      }
-    }
-    return "E";
+void step_cells(const rule_table* rule, const char* cells, char* next_cells, int first, int last){
+    int i;
+    for(i=first; i<=last; i++){
+        next_cells[i] = rule->outputs[CELL_BIT(cells[i-1]) << 2
+                            | CELL_BIT(cells[i]) << 1 | CELL_BIT(cells[i+1])];
+    }
 }
 
+/**
+ * Dynamic load balancing: every process tells the others the time it took
+ * computing its cells (busy seconds) since the slices last moved, and if the
+ * slowest one took BALANCE_THRESHOLD times the mean and evening them out
+ * saves more than the last move took (see balance_worth), the boundaries
+ * of the slices move so that all of them take the same time (see
+ * balance_split). The cells of buffers[current] go to their new owners,
+ * mostly the neighbors, in one all-to-all, and both buffers and their ghost
+ * requests are made again with the new size. sendcounts and displacements
+ * get the new slices, move_seconds the seconds the move took on the
+ * slowest process, and imbalance the measured one. Returns 1 if the slices
+ * moved, 0 if they did not and -1 if there was not enough memory (on every
+ * process), in which case nothing changes
+ * */
+int rebalance(double busy, int tam, int ghost, int current, char* buffers[2],
+              MPI_Request requests[2][NUM_GHOST_REQUESTS], int* sendcounts, int* displacements, double* move_seconds,
+              double* imbalance){
+    int current_id, num_procs, count, i, j, status = 0;
+    int *counts, *displs, *send_counts, *send_displs, *recv_counts, *recv_displs;
+    double slowest = 0, start, *loads;
+    char* moved[2] = {NULL, NULL};
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &current_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    loads = (double*) calloc (sizeof(double), num_procs);
+    counts = (int*) calloc (sizeof(int), 6 * (size_t)num_procs);
+    if (!loads || !counts) status = -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (status != 0){
+        free(loads);
+        free(counts);
+        return -1;
+    }
+    displs = counts + num_procs;
+    send_counts = displs + num_procs;
+    send_displs = send_counts + num_procs;
+    recv_counts = send_displs + num_procs;
+    recv_displs = recv_counts + num_procs;
+
+    MPI_Allgather(&busy, 1, MPI_DOUBLE, loads, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+    for(i=0; i<num_procs; i++)
+        if (loads[i] > slowest) slowest = loads[i];
+    *imbalance = balance_imbalance(loads, num_procs);
+    if (!balance_worth(*imbalance, slowest, *move_seconds)
+        || !balance_split(tam, num_procs, ghost, loads, sendcounts, displacements, counts, displs)){
+        free(loads);
+        free(counts);
+        return 0;
+    }
+
+    start = MPI_Wtime();
+    count = counts[current_id];
+    for(i=0; i<2; i++){
+        moved[i] = (char*) calloc (sizeof(char), count + 2*ghost);
+        if (!moved[i]) status = -1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (status == 0){
+        balance_overlaps(sendcounts, displacements, counts, displs, num_procs, current_id,
+                         send_counts, send_displs, recv_counts, recv_displs);
+        MPI_Alltoallv(&buffers[current][ghost], send_counts, send_displs, MPI_CHAR,
+                      &moved[current][ghost], recv_counts, recv_displs, MPI_CHAR, MPI_COMM_WORLD);
+        for(i=0; i<2; i++){
+            for(j=0; j<NUM_GHOST_REQUESTS; j++) MPI_Request_free(&requests[i][j]);
+            free(buffers[i]);
+            buffers[i] = moved[i];
+            moved[i] = NULL;
+            ghost_requests_init(buffers[i], count, ghost, (current_id - 1 + num_procs) % num_procs,
+                                (current_id + 1) % num_procs, requests[i]);
+        }
+        memcpy(sendcounts, counts, sizeof(int) * num_procs);
+        memcpy(displacements, displs, sizeof(int) * num_procs);
+        *move_seconds = MPI_Wtime() - start;
+        MPI_Allreduce(MPI_IN_PLACE, move_seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+    free(moved[0]);
+    free(moved[1]);
+    free(loads);
+    free(counts);
+    return (status == 0) ? 1 : -1;
+}
 
 int main(int argc, char *argv[]) {
     FILE * initial_configuration = NULL;
     FILE * transformation_function = NULL;
     
-    char size[MAX_CHAR];
-    char *input = NULL, *output = NULL;
-    char *partial_input = NULL, *partial_output = NULL;
-    char current_input[MAX_CHAR];
-    char char_act, first_element, last_element;
+    char size[MAX_CHAR], path[MAX_CHAR];
+    char *buffers[2] = {NULL, NULL}, *cells, *next_cells;
+    MPI_Request requests[2][NUM_GHOST_REQUESTS];
+    rule_table rule;
+    generator gen;
+    output_pipeline output, *printer = NULL;
+    output_format format = OUTPUT_TEXT;
 
-    int current_id, num_procs;
+    int current_id, num_procs, left, right, count;
     int tam = -1;
-    int i;
-    int number_iterations = -1, rest = 0, total_sum = 0;
+    int i, j, option, status = 0, current, from_file;
+    int number_iterations = -1, generation = 0, output_every = 1, snapshot_every = 0;
+    int rest = 0, total_sum = 0;
+    long header_size;
+    int ghost = 1, depth, step, first, last, bench = 0, profile = 0, balance_every = 0, balanced = 0, moved;
+    double start, elapsed, setup, since, computing, busy = 0, move_seconds = 0, imbalance;
+    const char* trace_prefix = NULL;
+    trace_log trace;
 
     int *sendcounts = NULL, *displacements = NULL;
 
-    //FILE * results = fopen("results.txt", "a");
-	//clock_t start = clock();
-
     //Argument check
-    if (argc != 4){
-        fprintf(stderr, "Invalid number of arguments. Try ./Cellular1D-Parallel file1 file2 num_iterations");
+    while((option = getopt(argc, argv, "o:f:s:k:L:BPJ:")) != -1){
+        if (option == 'o') output_every = atoi(optarg);
+        else if (option == 'f') status = output_format_parse(optarg, &format);
+        else if (option == 's') snapshot_every = atoi(optarg);
+        else if (option == 'k') ghost = atoi(optarg);
+        else if (option == 'L') balance_every = atoi(optarg);
+        else if (option == 'B') bench = 1;
+        else if (option == 'P') profile = 1;
+        else if (option == 'J'){
+            profile = 1;
+            trace_prefix = optarg;
+        }
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 3 || output_every < 0 || snapshot_every < 0 || ghost < 1
+        || balance_every < 0){
+        fprintf(stderr, "Invalid arguments. Try ./Cellular1D-Parallel [-o output_every] [-f format] "
+                        "[-s snapshot_every] [-k ghost_depth] [-L balance_every] [-B] [-P] [-J trace] "
+                        "file1 file2 num_iterations\n"
+                        "  -o N  print the vector every N generations (default 1, 0 = never)\n"
+                        "  -f F  format of the printed vector: text (default) or rle\n"
+                        "  -s N  write the vector to snapshot_<generation>.txt every N generations "
+                        "(default 0 = never)\n"
+                        "  -k K  exchange K ghost cells every K generations (default 1)\n"
+                        "  -L N  measure the time every process spends computing every N generations, and\n"
+                        "        move the boundaries of the slices if the slowest one takes %d%% longer\n"
+                        "        than the mean (default 0 = never)\n"
+                        "  -B    report the wall time of the generations on stderr (see benchmark.sh)\n"
+                        "  -P    report on stderr the time of every phase (scatter, halo, compute, gather,\n"
+                        "        print, io) in the fastest, mean and slowest process\n"
+                        "  -J F  like -P, and write the phases of every generation of rank R to F_R.json,\n"
+                        "        a trace for chrome://tracing or Perfetto\n"
+                        "file1 can also be generated by every process for its own slice, with\n"
+                        "random:N[:density[:seed]], seed:N or tile:N:cells (see generator.h)\n",
+                (int) (BALANCE_THRESHOLD * 100 + 0.5) - 100);
         return EXIT_FAILURE;
     }
 
-    number_iterations = atoi(argv[3]);
+    number_iterations = atoi(argv[optind+2]);
     if (number_iterations<1){
         fprintf(stderr, "Number of iterations has to be > 0\n");
         return EXIT_FAILURE;
     }
+    from_file = generator_parse(&gen, argv[optind], 1);
+    if (from_file < 0) return EXIT_FAILURE;
 
     //initialize MPI
     MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &current_id);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    //the reading of the configuration is timed from the same moment in every process
+    if (profile) MPI_Barrier(MPI_COMM_WORLD);
+    setup = MPI_Wtime();
 
-
-    //initial_configuration = fopen (argv[1], "r");
-    initial_configuration = fopen(argv[1], "r");
-    transformation_function = fopen(argv[2], "r");
-    if (!initial_configuration || !transformation_function){
+    if (from_file) initial_configuration = fopen(argv[optind], "r");
+    transformation_function = fopen(argv[optind+1], "r");
+    if ((from_file && !initial_configuration) || !transformation_function){
         fprintf(stderr, "Files do not exist or could not open them\n");
-        program_destroy(initial_configuration, transformation_function, input, 
-                    partial_input, sendcounts, displacements);
+        generator_destroy(&gen);
+        program_destroy(initial_configuration, transformation_function, NULL, 
+                    buffers[0], buffers[1], sendcounts, displacements);
         return EXIT_FAILURE;
     }
 
-    //get size of the matrix
-    fgets(size, MAX_CHAR, initial_configuration);
-    tam = atoi(size);
-    if (tam<1){
-        fprintf(stderr, "Size of the matrix should be > 0. Check initial configuration file\n");
+    //the transformation function is read only once, as a lookup table
+    if (rule_table_load(&rule, transformation_function, RULE_1D_INPUTS) != 0){
+        generator_destroy(&gen);
+        program_destroy(initial_configuration, transformation_function, NULL, 
+                    buffers[0], buffers[1], sendcounts, displacements);
+        return EXIT_FAILURE;
+    }
+
+    //get size of the matrix; the cells start right after its line
+    if (!from_file){
+        tam = gen.tam;
+        header_size = 0;
+    } else {
+        fgets(size, MAX_CHAR, initial_configuration);
+        tam = atoi(size);
+        header_size = ftell(initial_configuration);
+    }
+    if (tam/num_procs < ghost){
+        fprintf(stderr, "Size of the vector should be >= number of processes * ghost depth. "
+                        "Check initial configuration file\n");
+        generator_destroy(&gen);
+        rule_table_destroy(&rule);
         program_destroy(initial_configuration, transformation_function, 
-                       input, partial_input, sendcounts, displacements);
+                       NULL, buffers[0], buffers[1], sendcounts, displacements);
         return EXIT_FAILURE;
     }
 
-    //fill in sendcounts and displacements arrays (used in scatterv)
+    //fill in sendcounts and displacements arrays (slice of every process)
     sendcounts = (int*) calloc (sizeof(int), num_procs);
     displacements = (int*) calloc (sizeof(int), num_procs);
     rest = tam%num_procs;
@@ -136,108 +374,137 @@ int main(int argc, char *argv[]) {
         total_sum += sendcounts[i];
     }
     
-    //------------------------boss process: reads input vector
-    if (current_id == 0){
-        input = (char*)calloc(tam, sizeof(char));
-
-        for (i=0; i<tam; i++){
-            char_act = fgetc(initial_configuration);
-            if (char_act != '0' && char_act != '1'){
-                fprintf(stderr, "Initial configuration contains non-boolean value");
-                program_destroy(initial_configuration, transformation_function, input, partial_input, sendcounts, displacements);
-                return EXIT_FAILURE;
-            }
-            input[i] = char_act;
-            
-            //print for visualization
-            if(input[i] == '1') printf("#");
-            else printf(" ");
-            if (i==tam-1) printf ("\n");
-        }
-        output = (char*)malloc(tam*sizeof(char));
+    /**
+     * each process keeps its slice of the vector for the whole run, with ghost
+     * cells at each end holding the neighbor's boundary cells. Every process
+     * reads its own slice from the file, or generates it, and the vector is
+     * only gathered in rank 0 for the generations that are printed.
+     * Generations alternate between two buffers, each with its own persistent
+     * requests for the ghost cells
+     * */
+    count = sendcounts[current_id];
+    left = (current_id - 1 + num_procs) % num_procs;
+    right = (current_id + 1) % num_procs;
+    for(i=0; i<2; i++){
+        buffers[i] = (char*) calloc (sizeof(char), count + 2*ghost);
+        ghost_requests_init(buffers[i], count, ghost, left, right, requests[i]);
     }
-    //---------------------------------------------------------
-    
+
+    //every process stops if some of them could not read their slice
+    if (!from_file){
+        generator_fill(&gen, 0, displacements[current_id], count, &buffers[0][ghost]);
+        generator_destroy(&gen);
+    } else if (read_slice(argv[optind], header_size, &buffers[0][ghost], count, displacements[current_id]) != 0){
+        if (current_id == 0) fprintf(stderr, "Initial configuration contains non-boolean value\n");
+        for(i=0; i<2; i++)
+            for(j=0; j<NUM_GHOST_REQUESTS; j++) MPI_Request_free(&requests[i][j]);
+        rule_table_destroy(&rule);
+        program_destroy(initial_configuration, transformation_function, NULL, 
+                       buffers[0], buffers[1], sendcounts, displacements);
+        return EXIT_FAILURE;
+    }
+
+    //print for visualization, from a thread of its own in rank 0
+    if (current_id == 0 && output_every > 0){
+        if (output_open(&output, stdout, format, " #", OUTPUT_FRAMES, tam) == 0) printer = &output;
+        else status = -1;
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0){
+        if (current_id == 0) fprintf(stderr, "Not enough memory for the output queue\n");
+        for(i=0; i<2; i++)
+            for(j=0; j<NUM_GHOST_REQUESTS; j++) MPI_Request_free(&requests[i][j]);
+        rule_table_destroy(&rule);
+        program_destroy(initial_configuration, transformation_function, NULL, 
+                       buffers[0], buffers[1], sendcounts, displacements);
+        return EXIT_FAILURE;
+    }
+    trace_open(&trace, profile, trace_prefix, 1, setup, MPI_COMM_WORLD);
+    trace_add(&trace, 0, TRACE_SCATTER, 0, setup, trace_now(&trace));
+    if (output_every > 0)
+        queue_vector(printer, &buffers[0][ghost], count, sendcounts, displacements, tam, &trace, 0);
+
     /**
-     * each process has its local partial input (result of scatter) and creates the partial output
-     * for the posterior gather
+     * with ghost cells at each end, ghost generations can be computed between
+     * two exchanges: every generation the valid part of the buffer shrinks by
+     * one cell at each end (the ghost cells are computed redundantly by both
+     * neighbors), until only the slice itself is left
      * */
-    partial_input = (char*) calloc (sizeof(char), sendcounts[current_id]);
-    partial_output = (char*) calloc (sizeof(char),sendcounts[current_id]);
-
-    while(number_iterations > 0){
-        MPI_Scatterv(input, sendcounts, displacements, MPI_CHAR, partial_input, sendcounts[current_id], 
-                                    MPI_CHAR, 0, MPI_COMM_WORLD);
-
-        if(num_procs>1){
-            if (current_id == 0){ //case first process
-                MPI_Send(&partial_input[sendcounts[current_id]-1], 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD);
-                MPI_Recv(&first_element, 1, MPI_CHAR, num_procs-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE); 
-                MPI_Send(&partial_input[0], 1, MPI_CHAR, num_procs-1, 0, MPI_COMM_WORLD);
-                MPI_Recv(&last_element, 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-            } else if (current_id == num_procs-1){ //case last process
-                MPI_Recv(&first_element, 1, MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&partial_input[sendcounts[current_id]-1], 1,  MPI_CHAR, 0, 0, MPI_COMM_WORLD);
-                MPI_Recv(&last_element, 1, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&partial_input[0], 1,  MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD);
-
-            } else {//case default process
-                MPI_Recv(&first_element, 1, MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&partial_input[sendcounts[current_id]-1], 1,  MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD);
-                MPI_Recv(&last_element, 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&partial_input[0], 1,  MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD);
-            }
+    MPI_Barrier(MPI_COMM_WORLD);
+    start = MPI_Wtime();
+    while(generation < number_iterations){
+        //the slices move between two exchanges, when only buffers[generation%2] holds cells (timed as scatter)
+        if (balance_every > 0 && generation - balanced >= balance_every){
+            since = trace_now(&trace);
+            moved = rebalance(busy, tam, ghost, generation % 2, buffers, requests, sendcounts, displacements,
+                              &move_seconds, &imbalance);
+            if (moved < 0 && current_id == 0) fprintf(stderr, "Not enough memory to move the slices\n");
+            if (moved > 0 && profile && current_id == 0)
+                fprintf(stderr, "BALANCE generation=%d imbalance=%.3f\n", generation, imbalance);
+            count = sendcounts[current_id];
+            balanced = generation;
+            //the time since the slices last moved, every window half as much as the next one
+            busy = (moved > 0) ? 0 : busy / 2;
+            trace_mark(&trace, 0, TRACE_SCATTER, generation, &since);
         }
-        
-        current_input[3] = '\0';
-        for(i=0; i<sendcounts[current_id]; i++){
-            if (sendcounts[current_id] == 1){
-                current_input[0] = first_element;
-                current_input[1] = partial_input[i];
-                current_input[2] = last_element;
-            }else if(i==0){
-                current_input[0] = first_element;
-                current_input[1] = partial_input[i];
-                current_input[2] = partial_input[i+1];
-            } else if (i == sendcounts[current_id]-1){
-                current_input[0] = partial_input[i-1];
-                current_input[1] = partial_input[i];
-                current_input[2] = last_element;
+        depth = (number_iterations - generation < ghost) ? number_iterations - generation : ghost;
+        for(step=0; step<depth; step++){
+            current = generation % 2;
+            cells = buffers[current];
+            next_cells = buffers[1 - current];
+            first = step + 1;
+            last = count + 2*ghost - 2 - step;
+            since = trace_now(&trace);
+            computing = MPI_Wtime();
+
+            if (step == 0){
+                //the cells that do not depend on the ghost cells are computed while they travel
+                MPI_Startall(NUM_GHOST_REQUESTS, requests[current]);
+                step_cells(&rule, cells, next_cells, ghost+1, count+ghost-2);
+                trace_mark(&trace, 0, TRACE_COMPUTE, generation + 1, &since);
+                busy += MPI_Wtime() - computing;
+                MPI_Waitall(NUM_GHOST_REQUESTS, requests[current], MPI_STATUSES_IGNORE);
+                trace_mark(&trace, 0, TRACE_HALO, generation + 1, &since);
+                computing = MPI_Wtime();
+                step_cells(&rule, cells, next_cells, first, (ghost < last) ? ghost : last);
+                step_cells(&rule, cells, next_cells, (count+ghost-1 > ghost+1) ? count+ghost-1 : ghost+1, last);
             } else {
-                current_input[0] = partial_input[i-1];
-                current_input[1] = partial_input[i];
-                current_input[2] = partial_input[i+1];
+                step_cells(&rule, cells, next_cells, first, last);
             }
-            partial_output[i] = *transform(current_input, transformation_function);
-        }
 
-        MPI_Gatherv(partial_output, sendcounts[current_id],  MPI_CHAR,  output,  
-                    sendcounts,  displacements,  MPI_CHAR,  0,  MPI_COMM_WORLD);
-        
-        if (current_id == 0){
-            //print output for visualization purposes
             //the output is the new input for the next iteration
-            for(i=0; i<tam; i++){
-                if(output[i] == '1') printf("#");
-                else printf(" ");
-                if (i==tam-1) printf ("\n");
-                input[i] = output[i];
-            } 
+            busy += MPI_Wtime() - computing;
+            generation++;
+            trace_mark(&trace, 0, TRACE_COMPUTE, generation, &since);
+
+            //print output for visualization purposes
+            if (output_every > 0 && generation % output_every == 0)
+                queue_vector(printer, &next_cells[ghost], count, sendcounts, displacements, tam, &trace, generation);
+            if (snapshot_every > 0 && generation % snapshot_every == 0){
+                snprintf(path, sizeof path, "snapshot_%d.txt", generation);
+                since = trace_now(&trace);
+                write_snapshot(path, &next_cells[ghost], count, displacements[current_id], tam);
+                trace_mark(&trace, 0, TRACE_IO, generation, &since);
+            }
         }
-        number_iterations--;
     }
-	
-	/*FOR EXPERIMENTS
-    clock_t end = clock();
-    double timedif = (double)(end-start)/CLOCKS_PER_SEC;
-	if(current_id == 0)
-		fprintf(results, "%d %d %f\n", tam, num_procs, timedif);
-    */
+
+    for(i=0; i<2; i++)
+        for(j=0; j<NUM_GHOST_REQUESTS; j++) MPI_Request_free(&requests[i][j]);
+
+    //the run takes as long as its slowest process
+    elapsed = MPI_Wtime() - start;
+    MPI_Reduce(current_id == 0 ? MPI_IN_PLACE : &elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (bench && current_id == 0) bench_report("Cellular1D-Parallel", tam, number_iterations, num_procs, 1, elapsed);
+
+    since = trace_now(&trace);
+    if (printer && output_close(printer) != 0) fprintf(stderr, "The output could not be written\n");
+    if (printer) trace_mark(&trace, 0, TRACE_PRINT, number_iterations, &since);
+    trace_close(&trace, number_iterations, MPI_COMM_WORLD);
 
     //free resources
-    program_destroy(initial_configuration, transformation_function, input, 
-                   partial_input, sendcounts, displacements);
-    //fclose(results);
+    rule_table_destroy(&rule);
+    program_destroy(initial_configuration, transformation_function, NULL, 
+                   buffers[0], buffers[1], sendcounts, displacements);
     return EXIT_SUCCESS;    
 }
@@ -0,0 +1,124 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include "balance.h"
+
+/**
+ * Time of the slowest part over the mean time of all of them, 1 if none
+ * of them did any work
+ * */
+double balance_imbalance(const double* loads, int parts){
+    double max = 0, total = 0;
+    int i;
+
+    for(i=0; i<parts; i++){
+        total += loads[i];
+        if (loads[i] > max) max = loads[i];
+    }
+    return (total > 0) ? max * parts / total : 1;
+}
+
+/**
+ * Whether moving the parts pays off: the slowest part took imbalance times
+ * the mean over the time measured, seconds for the slowest part, so evening
+ * them out saves about 1 - 1/imbalance of as much time again, which has to
+ * be more than the seconds the last move took (0 before the first one).
+ * The imbalance has to reach BALANCE_THRESHOLD too
+ * */
+int balance_worth(double imbalance, double seconds, double move_seconds){
+    return imbalance >= BALANCE_THRESHOLD && seconds * (1 - 1 / imbalance) > move_seconds;
+}
+
+/**
+ * Splits num elements (rows, columns or cells) in parts consecutive parts
+ * that take the same time, given the time loads[i] that part i took on its
+ * counts[i] elements from displs[i] on. The time of a part is taken as
+ * evenly spread over its elements, so the boundaries move towards the
+ * parts that were slow, be it because their elements have more work or
+ * because their process runs on a slower processor. Every part keeps at
+ * least min elements (num >= parts * min). The new split goes to
+ * new_counts and new_displs. Returns 1 if it is different from the old
+ * one and 0 otherwise
+ * */
+int balance_split(int num, int parts, int min, const double* loads, const int* counts, const int* displs,
+                  int* new_counts, int* new_displs){
+    double total = 0, target, before = 0;
+    int k, part = 0, bound, next, changed = 0;
+
+    for(k=0; k<parts; k++) total += loads[k];
+    for(k=0; k<parts; k++){
+        new_counts[k] = counts[k];
+        new_displs[k] = displs[k];
+    }
+    if (total <= 0) return 0;
+
+    //boundary k is where the time of the parts before it adds up to k/parts of the total
+    for(k=1; k<parts; k++){
+        target = total * k / parts;
+        while (part < parts - 1 && before + loads[part] < target){
+            before += loads[part];
+            part++;
+        }
+        bound = displs[part];
+        if (loads[part] > 0) bound += (int) ((target - before) / loads[part] * counts[part] + 0.5);
+        if (bound > displs[part] + counts[part]) bound = displs[part] + counts[part];
+        new_displs[k] = bound;
+    }
+
+    for(k=1; k<parts; k++)
+        if (new_displs[k] < new_displs[k-1] + min) new_displs[k] = new_displs[k-1] + min;
+    for(k=parts-1; k>0; k--){
+        next = (k == parts - 1) ? num : new_displs[k+1];
+        if (new_displs[k] > next - min) new_displs[k] = next - min;
+    }
+    for(k=0; k<parts; k++){
+        new_counts[k] = ((k == parts - 1) ? num : new_displs[k+1]) - new_displs[k];
+        if (new_counts[k] != counts[k]) changed = 1;
+    }
+    return changed;
+}
+
+/**
+ * Elements that part me exchanges with every other part when the split
+ * goes from counts/displs to new_counts/new_displs: part q gets
+ * send_counts[q] elements from send_displs[q] on (counted from the start
+ * of the old part me), and sends recv_counts[q] elements that go from
+ * recv_displs[q] on (counted from the start of the new part me). Only
+ * the parts whose ranges overlap exchange anything: when the boundaries
+ * move a little, the neighbors
+ * */
+void balance_overlaps(const int* counts, const int* displs, const int* new_counts, const int* new_displs,
+                      int parts, int me, int* send_counts, int* send_displs, int* recv_counts, int* recv_displs){
+    int q, first, last;
+
+    for(q=0; q<parts; q++){
+        first = (displs[me] > new_displs[q]) ? displs[me] : new_displs[q];
+        last = (displs[me] + counts[me] < new_displs[q] + new_counts[q])
+               ? displs[me] + counts[me] : new_displs[q] + new_counts[q];
+        send_counts[q] = (last > first) ? last - first : 0;
+        send_displs[q] = (last > first) ? first - displs[me] : 0;
+
+        first = (displs[q] > new_displs[me]) ? displs[q] : new_displs[me];
+        last = (displs[q] + counts[q] < new_displs[me] + new_counts[me])
+               ? displs[q] + counts[q] : new_displs[me] + new_counts[me];
+        recv_counts[q] = (last > first) ? last - first : 0;
+        recv_displs[q] = (last > first) ? first - new_displs[me] : 0;
+    }
+}
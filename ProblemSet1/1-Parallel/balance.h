@@ -0,0 +1,34 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef BALANCE_H
+#define BALANCE_H
+
+//the parts are moved when the slowest one takes this much longer than the mean
+#define BALANCE_THRESHOLD 1.10
+
+double balance_imbalance(const double* loads, int parts);
+int balance_worth(double imbalance, double seconds, double move_seconds);
+int balance_split(int num, int parts, int min, const double* loads, const int* counts, const int* displs,
+                  int* new_counts, int* new_displs);
+void balance_overlaps(const int* counts, const int* displs, const int* new_counts, const int* new_displs,
+                      int parts, int me, int* send_counts, int* send_displs, int* recv_counts, int* recv_displs);
+
+#endif
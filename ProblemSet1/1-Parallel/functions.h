@@ -27,6 +27,28 @@
 #include<time.h>
 #include <math.h>
 
+#define RULE_1D_INPUTS 3 //left, center, right
+#define RULE_2D_INPUTS 9 //3x3 neighborhood read row by row
+
+/**
+ * '0' and '1' only differ in the lowest bit, so a cell character
+ * can be turned into its boolean value without a comparison
+ * */
+#define CELL_BIT(c) ((c) & 1)
+
+/**
+ * Transformation function compiled into a lookup table. The output
+ * of a neighborhood is stored at the index obtained by reading the
+ * neighborhood as a binary number (e.g. "011" is entry 3)
+ * */
+typedef struct {
+    int num_inputs;  //number of cells in the neighborhood
+    int num_entries; //2^num_inputs
+    char* outputs;   //'0' or '1' for every neighborhood
+} rule_table;
+
+int rule_table_load(rule_table* table, FILE* funct, int num_inputs);
+void rule_table_destroy(rule_table* table);
 
 void generate_gameoflife();
 void generate_2k(int k);
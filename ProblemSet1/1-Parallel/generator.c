@@ -0,0 +1,161 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "generator.h"
+
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+
+/**
+ * Reads the size of the lattice at the start of text, which has to be
+ * followed by ':' or the end of the spec. Returns the rest of the spec,
+ * or NULL if the size is not valid
+ * */
+static const char* parse_size(const char* text, int* tam){
+    char* end;
+    long value = strtol(text, &end, 10);
+
+    if (end == text || value < 1 || value > INT_MAX || (*end != ':' && *end != '\0')) return NULL;
+    *tam = (int) value;
+    return end;
+}
+
+/**
+ * Reads the tile of a tile:N:rows spec. Returns 0 on success and -1 if
+ * the rows are empty, have other characters than '0' and '1' or are not
+ * all as wide
+ * */
+static int parse_tile(generator* gen, const char* rows){
+    int i, width = 0;
+
+    gen->width = (int) strcspn(rows, "/");
+    gen->height = 1;
+    for(i=0; rows[i] != '\0'; i++) if (rows[i] == '/') gen->height++;
+    if (gen->width == 0) return -1;
+    gen->tile = (char*) calloc (sizeof(char), (size_t)gen->width * gen->height);
+    if (!gen->tile) return -1;
+
+    for(i=0; *rows != '\0'; rows++){
+        if (*rows == '/'){
+            if (width != gen->width) return -1;
+            width = 0;
+        } else if (*rows != '0' && *rows != '1') return -1;
+        else {
+            if (width == gen->width) return -1;
+            gen->tile[i++] = *rows;
+            width++;
+        }
+    }
+    return (width == gen->width) ? 0 : -1;
+}
+
+/**
+ * Recognizes spec as a generator (see generator.h) of a lattice of the
+ * given dimensions (1 or 2). Returns 0 if it is one, 1 if it is not (it
+ * must be a file name then) and -1 if it is not valid, which is reported
+ * on stderr
+ * */
+int generator_parse(generator* gen, const char* spec, int dimensions){
+    const char* rest;
+    char* end;
+    int status = 0;
+
+    memset(gen, 0, sizeof *gen);
+    gen->density = 0.5;
+    gen->seed = 1;
+    if (strncmp(spec, "random:", 7) == 0){
+        gen->kind = GENERATOR_RANDOM;
+        rest = parse_size(spec + 7, &gen->tam);
+        if (rest && *rest == ':'){
+            gen->density = strtod(rest + 1, &end);
+            if (end == rest + 1 || gen->density < 0 || gen->density > 1 || (*end != ':' && *end != '\0')) rest = NULL;
+            else if (*end == ':'){
+                gen->seed = strtoull(end + 1, &end, 10);
+                if (*end != '\0') rest = NULL;
+            }
+        }
+        if (!rest) status = -1;
+    } else if (strncmp(spec, "seed:", 5) == 0){
+        gen->kind = GENERATOR_SEED;
+        rest = parse_size(spec + 5, &gen->tam);
+        if (!rest || *rest != '\0') status = -1;
+    } else if (strncmp(spec, "tile:", 5) == 0){
+        gen->kind = GENERATOR_TILE;
+        rest = parse_size(spec + 5, &gen->tam);
+        if (!rest || *rest != ':' || parse_tile(gen, rest + 1) != 0) status = -1;
+    } else return 1;
+
+    gen->rows = (dimensions == 2) ? gen->tam : 1;
+    if (status != 0){
+        fprintf(stderr, "%s: not a valid generator, try random:N[:density[:seed]], seed:N or tile:N:rows\n", spec);
+        generator_destroy(gen);
+    }
+    return status;
+}
+
+void generator_destroy(generator* gen){
+    free(gen->tile);
+    gen->tile = NULL;
+}
+
+/**
+ * Random number of the given index of a sequence, computed from the index
+ * alone (the splitmix64 mix of seed + (index+1) * gamma): the same as the
+ * index-th number of the splitmix64 generator started at seed, which is
+ * what Cellular2D-Convert uses, so random:N:p:S gives the cells of
+ * Cellular2D-Convert -n N -p p -S S
+ * */
+uint64_t generator_random(uint64_t seed, uint64_t index){
+    uint64_t z = seed + (index + 1) * GOLDEN_GAMMA;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Writes count cells of row of the lattice, from column first_col on, to
+ * cells as '0' or '1'
+ * */
+void generator_fill(const generator* gen, int row, int first_col, int count, char* cells){
+    uint64_t index = (uint64_t)row * gen->tam + first_col;
+    const char* tile_row;
+    int j, col;
+
+    if (gen->kind == GENERATOR_RANDOM){
+        //the 53 high bits make a uniform number in [0, 1)
+        for(j=0; j<count; j++)
+            cells[j] = ((generator_random(gen->seed, index + j) >> 11) * 0x1.0p-53 < gen->density) ? '1' : '0';
+    } else if (gen->kind == GENERATOR_SEED){
+        memset(cells, '0', count);
+        if (row == gen->rows / 2 && first_col <= gen->tam / 2 && gen->tam / 2 < first_col + count)
+            cells[gen->tam / 2 - first_col] = '1';
+    } else {
+        tile_row = gen->tile + (size_t)(row % gen->height) * gen->width;
+        col = first_col % gen->width;
+        for(j=0; j<count; j++){
+            cells[j] = tile_row[col];
+            if (++col == gen->width) col = 0;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+
+/**
+ * Initial configuration generated in memory instead of being read, given
+ * in place of the file name as
+ *   random:N[:density[:seed]]  cells alive with the given probability
+ *                              (default 0.5, seed 1)
+ *   seed:N                     a single live cell in the middle
+ *   tile:N:rows                the rows of '0'/'1' separated by '/' (for
+ *                              example 010/001/111, a glider) repeated
+ *                              all over the lattice
+ * where N is the side of the matrix (or the length of the vector). Every
+ * cell is a function of its position alone, so each process generates
+ * its own part and the result does not depend on how many there are
+ * */
+typedef enum {GENERATOR_RANDOM, GENERATOR_SEED, GENERATOR_TILE} generator_kind;
+
+typedef struct {
+    generator_kind kind;
+    int rows, tam;         //rows (1 for a vector) and columns of the lattice
+    double density;
+    uint64_t seed;
+    int width, height;     //of the tile
+    char* tile;            //height rows of width cells
+} generator;
+
+int generator_parse(generator* gen, const char* spec, int dimensions);
+void generator_destroy(generator* gen);
+uint64_t generator_random(uint64_t seed, uint64_t index);
+void generator_fill(const generator* gen, int row, int first_col, int count, char* cells);
+
+#endif
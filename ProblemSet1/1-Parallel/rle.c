@@ -0,0 +1,224 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "rle.h"
+
+#define RLE_HEADER 1024  //longest header line that is parsed
+
+/**
+ * Tells whether the file holds an RLE pattern: its first character, after
+ * any blanks, starts a comment or the header. The file is rewound
+ * */
+int rle_is_rle(FILE* f){
+    int c;
+
+    rewind(f);
+    do{
+        c = getc(f);
+    } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+    rewind(f);
+    return c == '#' || c == 'x';
+}
+
+/**
+ * Skips the comments of the pattern in f and reads its header, leaving f
+ * at the first run. Returns 0 on success and -1 otherwise
+ * */
+int rle_reader_open(rle_reader* r, FILE* f, const char* name){
+    char line[RLE_HEADER];
+    int c;
+
+    memset(r, 0, sizeof *r);
+    r->file = f;
+    r->name = name;
+    for(;;){
+        do{
+            c = getc(f);
+        } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+        if (c != '#') break;
+        do{
+            c = getc(f);
+        } while (c != '\n' && c != EOF);
+    }
+    if (c == EOF || ungetc(c, f) == EOF || !fgets(line, RLE_HEADER, f)
+        || sscanf(line, " x = %ld , y = %ld", &r->width, &r->height) != 2 || r->width < 0 || r->height < 0){
+        fprintf(stderr, "%s: not valid RLE header\n", name);
+        return -1;
+    }
+    //the rule, if any, is not used: the transformation function is given apart
+    while (!strchr(line, '\n') && fgets(line, RLE_HEADER, f));
+    return 0;
+}
+
+/**
+ * Reads the next item of the runs: its count (1 if it has none) and its
+ * tag, skipping blanks and comment lines. f must be locked
+ * */
+static int next_item(rle_reader* r, long* count){
+    long n = 0;
+    int c, digits = 0;
+
+    for(;;){
+        c = getc_unlocked(r->file);
+        if (c >= '0' && c <= '9'){
+            //a count this long does not fit in any row, and is reported as such
+            n = (n > (LONG_MAX - 9) / 10) ? LONG_MAX : n*10 + (c - '0');
+            digits = 1;
+        } else if (c == '#' && !digits){
+            do{
+                c = getc_unlocked(r->file);
+            } while (c != '\n' && c != EOF);
+        } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+    }
+    *count = digits ? n : 1;
+    return c;
+}
+
+/**
+ * Reads the next row of the pattern and writes its columns first_col to
+ * first_col + num_cols - 1 into cells, as '0' or '1'; columns outside the
+ * pattern are dead. The runs are clipped to those columns, so that a
+ * process can decode just its own block. With cells NULL the row is
+ * skipped. Returns 0 on success and -1 if the pattern is not valid
+ * */
+int rle_read_row(rle_reader* r, long first_col, long num_cols, char* cells){
+    long col = 0, count, from, to;
+    int tag, status = 0;
+
+    if (cells && num_cols > 0) memset(cells, '0', num_cols);
+    if (r->empty_rows > 0 || r->done){
+        if (r->empty_rows > 0) r->empty_rows--;
+        r->row++;
+        return 0;
+    }
+
+    flockfile(r->file);
+    for(;;){
+        tag = next_item(r, &count);
+        if (tag == '$' || tag == '!'){
+            r->empty_rows = (tag == '$' && count > 1) ? count - 1 : 0;
+            r->done = tag == '!';
+            break;
+        }
+        if (tag != 'b' && tag != '.' && tag != 'o' && (tag < 'A' || tag > 'X')){
+            if (tag == EOF) fprintf(stderr, "%s: the pattern does not end with !\n", r->name);
+            else fprintf(stderr, "%s: not valid character '%c' in row %ld\n", r->name, tag, r->row);
+            status = -1;
+            break;
+        }
+        if (r->row >= r->height || count > r->width - col){
+            fprintf(stderr, "%s: row %ld does not fit in the size of the header\n", r->name, r->row);
+            status = -1;
+            break;
+        }
+        //any state but the dead one (b or .) is alive
+        if (cells && tag != 'b' && tag != '.'){
+            from = (col > first_col) ? col : first_col;
+            to = (col + count < first_col + num_cols) ? col + count : first_col + num_cols;
+            if (from < to) memset(cells + (from - first_col), '1', to - from);
+        }
+        col += count;
+    }
+    funlockfile(r->file);
+    r->row++;
+    return status;
+}
+
+/**
+ * Reads num_rows rows of the pattern without decoding them. Returns 0 on
+ * success and -1 if the pattern is not valid
+ * */
+int rle_skip_rows(rle_reader* r, long num_rows){
+    for(; num_rows > 0; num_rows--)
+        if (rle_read_row(r, 0, 0, NULL) != 0) return -1;
+    return 0;
+}
+
+/**
+ * Writes the header of a width x height pattern to f. Returns 0 on success
+ * and -1 otherwise
+ * */
+int rle_writer_open(rle_writer* w, FILE* f, long width, long height){
+    memset(w, 0, sizeof *w);
+    w->file = f;
+    w->width = width;
+    w->height = height;
+    return (fprintf(f, "x = %ld, y = %ld\n", width, height) < 0) ? -1 : 0;
+}
+
+/**
+ * Adds a run of count cells (or row ends) of the given tag, starting a new
+ * line if it would not fit. f must be locked
+ * */
+static void put_run(rle_writer* w, long count, char tag){
+    char digits[24];
+    int num_digits = 0, length;
+
+    if (count < 1) return;
+    if (count > 1)
+        for(; count > 0; count /= 10) digits[num_digits++] = '0' + count % 10;
+    length = num_digits + 1;
+    if (w->line_length + length > RLE_LINE){
+        putc_unlocked('\n', w->file);
+        w->line_length = 0;
+    }
+    while (num_digits > 0) putc_unlocked(digits[--num_digits], w->file);
+    putc_unlocked(tag, w->file);
+    w->line_length += length;
+}
+
+/**
+ * Writes the next row of the pattern, width cells '0' or '1'. Dead cells at
+ * the end of the row are left out
+ * */
+void rle_writer_put_row(rle_writer* w, const char* cells){
+    long j, last, run;
+
+    w->row++;
+    for(last=w->width-1; last>=0 && cells[last] != '1'; last--);
+    if (last < 0){
+        w->empty_rows++;
+        return;
+    }
+    flockfile(w->file);
+    put_run(w, w->empty_rows, '$');
+    for(j=0; j<=last; j+=run){
+        for(run=1; j+run<=last && cells[j+run] == cells[j]; run++);
+        put_run(w, run, (cells[j] == '1') ? 'o' : 'b');
+    }
+    funlockfile(w->file);
+    w->empty_rows = 1;
+}
+
+/**
+ * Ends the pattern. Returns 0 on success and -1 if some write failed
+ * */
+int rle_writer_close(rle_writer* w){
+    flockfile(w->file);
+    put_run(w, 1, '!');
+    putc_unlocked('\n', w->file);
+    funlockfile(w->file);
+    return ferror(w->file) ? -1 : 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace.h"
+
+#define TRACE_INITIAL_EVENTS 1024
+
+static const char* const phase_names[TRACE_PHASES] = {
+    "scatter", "halo", "compute", "gather", "print", "io"
+};
+
+/**
+ * Prepares the timers of a process with num_threads threads. origin is
+ * the MPI_Wtime the trace starts at, taken by every rank right after a
+ * barrier so that their traces line up. Collective if enabled, which must
+ * be the same in every process: if some of them has not enough memory,
+ * none is timed (so that trace_close is called by all or none) and -1 is
+ * returned. Returns 0 otherwise
+ * */
+int trace_open(trace_log* t, int enabled, const char* prefix, int num_threads, double origin, MPI_Comm comm){
+    int status;
+
+    t->enabled = 0;
+    t->threads = NULL;
+    t->num_threads = num_threads;
+    t->origin = origin;
+    t->prefix = prefix;
+    MPI_Comm_rank(comm, &t->rank);
+    if (!enabled) return 0;
+
+    t->threads = (trace_thread*) calloc (sizeof(trace_thread), num_threads);
+    status = t->threads ? 0 : -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, comm);
+    if (status != 0){
+        if (t->rank == 0) fprintf(stderr, "Not enough memory for the phase timers, the run is not timed\n");
+        free(t->threads);
+        t->threads = NULL;
+        return -1;
+    }
+    t->enabled = 1;
+    return 0;
+}
+
+/**
+ * Current time, or 0 without spending a call to the clock if the timers
+ * are disabled
+ * */
+double trace_now(const trace_log* t){
+    return t->enabled ? MPI_Wtime() : 0;
+}
+
+/**
+ * Adds the time from start to end to the given phase of a thread, and
+ * keeps it as an event of the trace. Every thread only touches its own
+ * counters, so no locking is needed. If the events do not fit in memory
+ * they are dropped, but their time is still counted
+ * */
+void trace_add(trace_log* t, int thread, trace_phase phase, int generation, double start, double end){
+    trace_thread* th;
+    trace_event* events;
+    size_t capacity;
+
+    if (!t->enabled) return;
+    th = &t->threads[thread];
+    th->totals[phase] += end - start;
+    if (!t->prefix) return;
+
+    if (th->num_events == th->capacity){
+        capacity = th->capacity ? 2 * th->capacity : TRACE_INITIAL_EVENTS;
+        events = (trace_event*) realloc (th->events, capacity * sizeof(trace_event));
+        if (!events){
+            th->dropped++;
+            return;
+        }
+        th->events = events;
+        th->capacity = capacity;
+    }
+    th->events[th->num_events++] = (trace_event) {start, end, phase, generation};
+}
+
+/**
+ * Ends a phase that started at *since and starts the next one now
+ * */
+void trace_mark(trace_log* t, int thread, trace_phase phase, int generation, double* since){
+    double now;
+
+    if (!t->enabled) return;
+    now = MPI_Wtime();
+    trace_add(t, thread, phase, generation, *since, now);
+    *since = now;
+}
+
+/**
+ * Writes the events of the process as a Chrome trace (the JSON event
+ * format read by chrome://tracing and Perfetto): one process per rank,
+ * one thread per worker, times in microseconds from the origin
+ * */
+static int write_trace(const trace_log* t){
+    char path[FILENAME_MAX];
+    FILE* file;
+    size_t e;
+    int i, status = 0;
+    const trace_event* ev;
+
+    snprintf(path, sizeof path, "%s_%d.json", t->prefix, t->rank);
+    file = fopen(path, "w");
+    if (!file){
+        fprintf(stderr, "%s: could not be created\n", path);
+        return -1;
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"rank %d\"}}",
+            t->rank, t->rank);
+    for(i=0; i<t->num_threads; i++){
+        fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                      "\"args\": {\"name\": \"worker %d\"}}", t->rank, i, i);
+        for(e=0; e<t->threads[i].num_events; e++){
+            ev = &t->threads[i].events[e];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, "
+                          "\"dur\": %.3f, \"args\": {\"generation\": %d}}", phase_names[ev->phase], t->rank, i,
+                    (ev->start - t->origin) * 1e6, (ev->end - ev->start) * 1e6, ev->generation);
+        }
+        if (t->threads[i].dropped > 0)
+            fprintf(stderr, "Rank %d: %zu events of worker %d did not fit in memory and are not in %s\n",
+                    t->rank, t->threads[i].dropped, i, path);
+    }
+    fprintf(file, "\n]}\n");
+    if (ferror(file)) status = -1;
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "%s: could not be written\n", path);
+    return status;
+}
+
+/**
+ * Collective: reduces the time of every phase over the processes and rank
+ * 0 writes to stderr, for each phase, the time of the fastest process, the
+ * mean, the slowest one, and the slowest over the mean (1 is a perfect
+ * balance), as lines
+ *   PHASE name=N min=S mean=S max=S imbalance=R per_generation=S
+ * where per_generation is the mean over the given number of generations.
+ * Then every process writes its trace, if asked, and frees the timers.
+ * Returns 0, or -1 if the trace of some process could not be written
+ * */
+int trace_close(trace_log* t, int generations, MPI_Comm comm){
+    double local[TRACE_PHASES] = {0}, low[TRACE_PHASES], high[TRACE_PHASES], sum[TRACE_PHASES], mean;
+    int i, p, num_procs, status = 0;
+
+    if (!t->enabled) return 0;
+
+    //the threads of a process work at the same time, so the process takes as long as the slowest one
+    for(i=0; i<t->num_threads; i++)
+        for(p=0; p<TRACE_PHASES; p++)
+            if (t->threads[i].totals[p] > local[p]) local[p] = t->threads[i].totals[p];
+    MPI_Comm_size(comm, &num_procs);
+    MPI_Reduce(local, low, TRACE_PHASES, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(local, high, TRACE_PHASES, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(local, sum, TRACE_PHASES, MPI_DOUBLE, MPI_SUM, 0, comm);
+    if (t->rank == 0){
+        for(p=0; p<TRACE_PHASES; p++){
+            mean = sum[p] / num_procs;
+            fprintf(stderr, "PHASE name=%s min=%.6f mean=%.6f max=%.6f imbalance=%.3f per_generation=%.6e\n",
+                    phase_names[p], low[p], mean, high[p], (mean > 0) ? high[p] / mean : 1.0,
+                    (generations > 0) ? mean / generations : 0.0);
+        }
+    }
+
+    if (t->prefix && write_trace(t) != 0) status = -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, comm);
+
+    for(i=0; i<t->num_threads; i++) free(t->threads[i].events);
+    free(t->threads);
+    t->threads = NULL;
+    t->enabled = 0;
+    return status;
+}
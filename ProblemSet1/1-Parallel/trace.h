@@ -0,0 +1,73 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <mpi.h>
+
+/**
+ * Phases of a run that are timed. Every rank adds up the time of each
+ * phase (for the threads of a process, the one that spent the longest)
+ * and, if asked, keeps one event per phase and generation for a trace
+ * */
+typedef enum {
+    TRACE_SCATTER,      //reading and distributing the initial configuration
+    TRACE_HALO,         //waiting for the ghost cells of the neighbors
+    TRACE_COMPUTE,      //computing generations
+    TRACE_GATHER,       //collecting the lattice in rank 0 to print it
+    TRACE_PRINT,        //rank 0 waiting for the printing thread
+    TRACE_IO,           //writing snapshots and checkpoints
+    TRACE_PHASES
+} trace_phase;
+
+typedef struct {
+    double start, end;
+    int phase, generation;
+} trace_event;
+
+typedef struct {
+    double totals[TRACE_PHASES];
+    trace_event* events;
+    size_t num_events, capacity, dropped;
+    char padding[64];   //threads do not share the cache line of their totals
+} trace_thread;
+
+/**
+ * Timers of the phases of a process, enabled by the -P and -J options.
+ * When disabled nothing is allocated and every call returns at once
+ * */
+typedef struct {
+    int enabled;
+    int rank;
+    int num_threads;
+    double origin;          //MPI_Wtime the times of the trace are counted from
+    const char* prefix;     //the trace of every rank goes to <prefix>_<rank>.json, NULL = no trace
+    trace_thread* threads;
+} trace_log;
+
+int trace_open(trace_log* t, int enabled, const char* prefix, int num_threads, double origin, MPI_Comm comm);
+double trace_now(const trace_log* t);
+void trace_add(trace_log* t, int thread, trace_phase phase, int generation, double start, double end);
+void trace_mark(trace_log* t, int thread, trace_phase phase, int generation, double* since);
+int trace_close(trace_log* t, int generations, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "functions.h"
+#include "hashlife.h"
+#include "bench.h"
+
+#define MAX_CHAR 1024
+#define DEFAULT_CACHE_MB 1024
+
+/**
+ * Function used to free all the memory allocations (if any)
+ * and close the files used (if any) for termination of the program
+ * */
+void program_destroy(char* vector1, char* vector2, FILE* f1, FILE* f2){
+    if(vector1) free(vector1);
+    if(vector2) free(vector2);
+    if(f1) fclose(f1);
+    if(f2) fclose(f2);
+}
+
+/**
+ * Prints the vector using spaces for the character 0
+ * and # for the character 1. line must have room for
+ * tam+1 characters
+ * */
+void pretty_print(const char* vector, char* line, int tam){
+    int i;
+    for(i=0; i<tam; i++) line[i] = (vector[i] == '0') ? ' ' : '#';
+    line[tam] = '\n';
+    fwrite(line, sizeof(char), tam + 1, stdout);
+}
+
+int main(int argc, char *argv[]) {
+    FILE * initial_configuration = NULL;
+    FILE * transformation_function = NULL;
+    char size[MAX_CHAR] = "";
+    char *cells = NULL, *line = NULL, *end;
+    char char_act;
+    rule_table rule;
+    hashlife h;
+    int tam = -1, i, option, status = 0, bench = 0;
+    double start;
+    unsigned long long num_iterations = 0, generation = 0, output_every = 1, chunk;
+    long cache_mb = DEFAULT_CACHE_MB;
+
+    //Argument check
+    while((option = getopt(argc, argv, "o:m:B")) != -1){
+        if (option == 'o') output_every = strtoull(optarg, NULL, 10);
+        else if (option == 'm') cache_mb = atol(optarg);
+        else if (option == 'B') bench = 1;
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 3 || cache_mb < 1){
+        fprintf(stderr, "Incorrect arguments. Try ./Cellular1D-Hashlife [-o output_every] [-m cache_mb] [-B] "
+                        "initial_configuration transformation_function number_iterations\n"
+                        "  -o N  print the lattice every N generations (default 1, 0 = never)\n"
+                        "  -m M  memory for the node cache in MB (default %d)\n"
+                        "  -B    report the wall time of the generations on stderr (see benchmark.sh)\n",
+                        DEFAULT_CACHE_MB);
+        return EXIT_FAILURE;
+    }
+
+    num_iterations = strtoull(argv[optind+2], &end, 10);
+    if (*end != '\0' || argv[optind+2][0] == '-' || num_iterations < 1
+        || (num_iterations >> (HASHLIFE_MAX_JUMP + 1))){
+        fprintf(stderr, "Number of iterations must be between 1 and 2^%d - 1\n", HASHLIFE_MAX_JUMP + 1);
+        return EXIT_FAILURE;
+    }
+
+    initial_configuration = fopen (argv[optind], "r");
+    transformation_function = fopen(argv[optind+1], "r");
+    if (!initial_configuration || !transformation_function){
+        fprintf(stderr, "Files do not exist or could not open them\n");
+        program_destroy(cells, line, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    if (rule_table_load(&rule, transformation_function, RULE_1D_INPUTS) != 0){
+        program_destroy(cells, line, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    fgets(size, MAX_CHAR, initial_configuration);
+    tam = atoi(size);
+    if (tam<1){
+        fprintf(stderr, "Error. Size of input vector is < 1\n");
+        program_destroy(cells, line, transformation_function, initial_configuration);
+        rule_table_destroy(&rule);
+        return EXIT_FAILURE;
+    }
+
+    cells = (char*) calloc (sizeof(char), tam+1);
+    line = (char*) calloc (sizeof(char), tam+1);
+    if (!cells || !line || hashlife_create(&h, &rule, (size_t)cache_mb << 20) != 0){
+        fprintf(stderr, "Not enough memory for a lattice of %d cells\n", tam);
+        program_destroy(cells, line, transformation_function, initial_configuration);
+        rule_table_destroy(&rule);
+        return EXIT_FAILURE;
+    }
+    //the universe keeps its own copy of the rule
+    rule_table_destroy(&rule);
+
+    for(i=0; i<tam; i++){
+        char_act = fgetc(initial_configuration);
+        if(char_act != '0' && char_act != '1'){
+            fprintf(stderr, "Initial configuration file contains non-boolean value\n");
+            hashlife_destroy(&h);
+            program_destroy(cells, line, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+        cells[i] = char_act;
+    }
+
+    if (output_every > 0) pretty_print(cells, line, tam);
+
+    /**
+     * the lattice is advanced straight from one printed generation to the
+     * next: a jump costs about the same whatever its length
+     * */
+    start = bench_now();
+    while(generation < num_iterations){
+        chunk = (output_every > 0) ? output_every : num_iterations;
+        if (chunk > num_iterations - generation) chunk = num_iterations - generation;
+        if (hashlife_advance(&h, cells, tam, chunk) != 0){
+            fprintf(stderr, "Not enough memory for the node cache\n");
+            status = -1;
+            break;
+        }
+        generation += chunk;
+
+        if (output_every > 0 && generation % output_every == 0) pretty_print(cells, line, tam);
+    }
+
+    if (bench && status == 0) bench_report("Cellular1D-Hashlife", tam, num_iterations, 1, 1, bench_now() - start);
+
+    //free resources
+    hashlife_destroy(&h);
+    program_destroy(cells, line, transformation_function, initial_configuration);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,211 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "functions.h"
+#include "packed.h"
+#include "workers.h"
+#include "output.h"
+#include "bench.h"
+
+#define MAX_CHAR 1024
+
+//words per cache line: the unit in which the lattice is split among workers
+#define WORDS_PER_LINE 8
+
+#define OUTPUT_FRAMES 64 //lattices that can wait to be printed
+
+/**
+ * State shared by the workers: generation g is computed from
+ * lattices[g%2] into lattices[1-g%2]
+ * */
+typedef struct {
+    const packed_rule* prule;
+    packed_lattice* lattices;
+    output_pipeline* output;
+} simulation;
+
+/**
+ * Function used to free all the memory allocations (if any)
+ * and close the files used (if any) for termination of the program
+ * */
+void program_destroy(packed_lattice* lattice1, packed_lattice* lattice2, char* line,
+                     FILE* f1, FILE* f2){
+    if(lattice1) packed_lattice_destroy(lattice1);
+    if(lattice2) packed_lattice_destroy(lattice2);
+    if(line) free(line);
+    if(f1) fclose(f1);
+    if(f2) fclose(f2);
+}
+
+/**
+ * Queues the lattice to be printed by the output thread, using spaces
+ * for the cells in state 0 and # for the cells in state 1
+ * */
+void pretty_print(const packed_lattice* lattice, output_pipeline* output){
+    packed_lattice_to_chars(lattice, output_frame_begin(output, 1, lattice->tam, ""), '0', '1');
+    output_frame_end(output);
+}
+
+/**
+ * Computes the words of the next generation that belong to the worker
+ * */
+void simulation_step(void* state, int worker, int num_workers, int generation){
+    simulation* sim = (simulation*) state;
+    const packed_lattice* in = &sim->lattices[generation % 2];
+    int first, last;
+
+    workers_split(in->num_words, WORDS_PER_LINE, worker, num_workers, &first, &last);
+    packed_step_range(sim->prule, in, &sim->lattices[1 - generation % 2], first, last);
+}
+
+/**
+ * Prints the lattice after the given number of generations, which is
+ * written while the next ones are computed
+ * */
+void simulation_publish(void* state, int generation){
+    simulation* sim = (simulation*) state;
+    pretty_print(&sim->lattices[generation % 2], sim->output);
+}
+
+int main(int argc, char *argv[]) {
+    FILE * initial_configuration = NULL;
+    FILE * transformation_function = NULL;
+    char size[MAX_CHAR] = "";
+    char *line = NULL;
+    char char_act;
+    rule_table rule;
+    packed_rule prule;
+    packed_lattice lattices[2] = {{0, 0, 0, NULL}, {0, 0, 0, NULL}};
+    packed_lattice *input = &lattices[0], *output = &lattices[1];
+    simulation sim;
+    worker_job job;
+    output_pipeline printer;
+    output_format format = OUTPUT_TEXT;
+    int tam = -1, num_iterations = -1, i;
+    int num_workers = workers_default_count(), output_every = 1, option, status = 0, bench = 0;
+    double start;
+
+    //Argument check
+    while((option = getopt(argc, argv, "t:o:f:B")) != -1){
+        if (option == 't') num_workers = atoi(optarg);
+        else if (option == 'o') output_every = atoi(optarg);
+        else if (option == 'f') status = output_format_parse(optarg, &format);
+        else if (option == 'B') bench = 1;
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 3 || num_workers < 1 || output_every < 0){
+        fprintf(stderr, "Incorrect arguments. Try ./Cellular1D-Packed [-t threads] [-o output_every] [-f format] [-B] "
+                        "initial_configuration transformation_function number_iterations\n"
+                        "  -t N  number of threads (default: one per processor)\n"
+                        "  -o N  print the lattice every N generations (default 1, 0 = never)\n"
+                        "  -f F  format of the printed lattices: text (default) or rle\n"
+                        "  -B    report the wall time of the generations on stderr (see benchmark.sh)\n");
+        return EXIT_FAILURE;
+    }
+
+    num_iterations = atoi(argv[optind+2]);
+    if (num_iterations<1){
+        fprintf(stderr, "Number of iterations must be > 0\n");
+        return EXIT_FAILURE;
+    }
+
+    initial_configuration = fopen (argv[optind], "r");
+    transformation_function = fopen(argv[optind+1], "r");
+    if (!initial_configuration || !transformation_function){
+        fprintf(stderr, "Files do not exist or could not open them\n");
+        program_destroy(NULL, NULL, line, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    if (rule_table_load(&rule, transformation_function, RULE_1D_INPUTS) != 0){
+        program_destroy(NULL, NULL, line, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+    packed_rule_init(&prule, &rule);
+    rule_table_destroy(&rule);
+
+    fgets(size, MAX_CHAR, initial_configuration);
+    tam = atoi(size);
+    if (tam<1){
+        fprintf(stderr, "Error. Size of input vector is < 1\n");
+        program_destroy(NULL, NULL, line, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    //the characters are read into the line buffer and then packed 64 cells per word
+    line = (char*) calloc (sizeof(char), tam+1);
+    if (!line || packed_lattice_create(input, tam) != 0 || packed_lattice_create(output, tam) != 0){
+        fprintf(stderr, "Not enough memory for a lattice of %d cells\n", tam);
+        program_destroy(input, output, line, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    for(i=0; i<tam; i++){
+        char_act = fgetc(initial_configuration);
+        if(char_act != '0' && char_act != '1'){
+            fprintf(stderr, "Initial configuration file contains non-boolean value\n");
+            program_destroy(input, output, line, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+        line[i] = char_act;
+    }
+    packed_lattice_from_chars(input, line);
+
+    //the lattices are printed by a thread of their own, while the workers go on
+    if (output_every > 0){
+        if (output_open(&printer, stdout, format, " #", OUTPUT_FRAMES, tam) != 0){
+            fprintf(stderr, "Not enough memory for the output queue\n");
+            program_destroy(input, output, line, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+        pretty_print(input, &printer);
+    }
+
+    /**
+     * the generations are computed by a team of threads, each of them
+     * owning a range of words of the lattice
+     * */
+    sim.prule = &prule;
+    sim.lattices = lattices;
+    sim.output = &printer;
+    job.num_workers = num_workers;
+    job.num_generations = num_iterations;
+    job.publish_every = output_every;
+    job.step = simulation_step;
+    job.publish = simulation_publish;
+    job.state = &sim;
+    start = bench_now();
+    workers_run(&job);
+    if (output_every > 0 && output_close(&printer) != 0){
+        fprintf(stderr, "The output could not be written\n");
+        status = -1;
+    }
+    if (bench) bench_report("Cellular1D-Packed", tam, num_iterations, 1, num_workers, bench_now() - start);
+
+    //free resources
+    program_destroy(input, output, line, transformation_function, initial_configuration);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "functions.h"
 
 #define MAX_CHAR 1024
 
@@ -35,26 +36,6 @@ void program_destroy(char* vector1, char* vector2, FILE* f1, FILE* f2){
     if(f2) fclose(f2);
 }
 
-/**Function that receives an input string and the transformation function
- * file and returns the output according to the file. In case of error
- * returns the string "E"
- * */
-char* transform(char *vector, FILE * funct){
-    char line[MAX_CHAR];
-    char *function_input = NULL, *function_output = NULL;
-
-    rewind(funct);
-    while(fgets(line, sizeof line, funct)!= NULL){ 
-      function_input = strtok(line, " ");
-      function_output = strtok(NULL, " ");
-
-      if (strcmp(function_input, vector) == 0){
-          return function_output;
-      }
-    }
-    return "E";
-}
-
 /**
  * Returns the module of the given numbers. Contrary to the
  * operator %, returns the module of negative numbers too
@@ -82,10 +63,10 @@ int main(int argc, char const *argv[]) {
     FILE * initial_configuration = NULL;
     FILE * transformation_function = NULL;
     char size[MAX_CHAR] = "";
-    char *input;
-    char *output;
-    char *partial_input = (char*) calloc (sizeof(char), 3);
+    char *input = NULL;
+    char *output = NULL;
     char char_act;
+    rule_table rule;
     int tam = -1, num_iterations = -1, i;
 
     //Argument check
@@ -110,12 +91,19 @@ int main(int argc, char const *argv[]) {
         program_destroy(input, output, transformation_function, initial_configuration);
         return EXIT_FAILURE;
     }
+
+    //the transformation function is read only once, as a lookup table
+    if (rule_table_load(&rule, transformation_function, RULE_1D_INPUTS) != 0){
+        program_destroy(input, output, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
     
     fgets(size, MAX_CHAR, initial_configuration);
     tam = atoi(size);
     if (tam<1){
         fprintf(stderr, "Error. Size of input vector is < 1\n");
         program_destroy(input, output, transformation_function, initial_configuration);
+        rule_table_destroy(&rule);
         return(EXIT_FAILURE);
     }
 
@@ -131,6 +119,7 @@ int main(int argc, char const *argv[]) {
             if(input[i] != '0' && input[i] != '1'){
                 fprintf(stderr, "Initial configuration file contains non-boolean value\n");
                 program_destroy(input, output, transformation_function, initial_configuration);
+                rule_table_destroy(&rule);
                 return EXIT_FAILURE;
             }
         }
@@ -141,10 +130,9 @@ int main(int argc, char const *argv[]) {
     //start of iterative loop
     while(num_iterations > 0){
         for (i = 0; i<tam; i++){
-            partial_input[0] = input[module(i-1, tam)];
-            partial_input[1] = input[module(i, tam)];
-            partial_input[2] = input[module(i+1, tam)];
-            output[i] = *transform(partial_input, transformation_function);
+            output[i] = rule.outputs[CELL_BIT(input[module(i-1, tam)]) << 2
+                                    | CELL_BIT(input[i]) << 1
+                                    | CELL_BIT(input[module(i+1, tam)])];
         }
 
         pretty_print(output);
@@ -158,6 +146,6 @@ int main(int argc, char const *argv[]) {
     
     //free resources
     program_destroy(input, output, transformation_function, initial_configuration);
-    free(partial_input);
+    rule_table_destroy(&rule);
     return EXIT_SUCCESS;    
 }
@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RULE_1D_INPUTS 3 //left, center, right
+#define RULE_2D_INPUTS 9 //3x3 neighborhood read row by row
+
+/**
+ * '0' and '1' only differ in the lowest bit, so a cell character
+ * can be turned into its boolean value without a comparison
+ * */
+#define CELL_BIT(c) ((c) & 1)
+
+/**
+ * Transformation function compiled into a lookup table. The output
+ * of a neighborhood is stored at the index obtained by reading the
+ * neighborhood as a binary number (e.g. "011" is entry 3)
+ * */
+typedef struct {
+    int num_inputs;  //number of cells in the neighborhood
+    int num_entries; //2^num_inputs
+    char* outputs;   //'0' or '1' for every neighborhood
+} rule_table;
+
+int rule_table_load(rule_table* table, FILE* funct, int num_inputs);
+void rule_table_destroy(rule_table* table);
+
+#endif
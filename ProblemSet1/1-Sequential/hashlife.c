@@ -0,0 +1,461 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hashlife.h"
+
+#define BASE_LEVEL 7       //results of 128 cell segments are computed word by word
+#define MIN_NODES 1024
+#define INITIAL_BUCKETS 4096
+
+enum {LEFT, RIGHT};
+
+static uint64_t leaf_bits(const hashlife_node* node){
+    return (uint64_t)node->child[0] | (uint64_t)node->child[1] << 32;
+}
+
+static uint32_t hash_key(int level, const uint32_t child[2]){
+    uint64_t key = (uint64_t)(level + 1) * 0x9E3779B97F4A7C15ULL;
+    int i;
+    for(i=0; i<2; i++){
+        key = (key ^ child[i]) * 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 32;
+    }
+    return (uint32_t) key;
+}
+
+/**
+ * Keeps the node alive until the stack is cut below it.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+static int protect(hashlife* h, uint32_t node){
+    uint32_t* stack;
+    size_t capacity;
+
+    if (h->stack_size == h->stack_capacity){
+        capacity = h->stack_capacity ? 2 * h->stack_capacity : 256;
+        stack = (uint32_t*) realloc (h->stack, sizeof(uint32_t) * capacity);
+        if (!stack) return -1;
+        h->stack = stack;
+        h->stack_capacity = capacity;
+    }
+    h->stack[h->stack_size++] = node;
+    return 0;
+}
+
+static void insert_node(hashlife* h, uint32_t node){
+    uint32_t bucket = hash_key(h->nodes[node].level, h->nodes[node].child) & (h->num_buckets - 1);
+    h->nodes[node].next = h->buckets[bucket];
+    h->buckets[bucket] = node;
+}
+
+static void mark(hashlife* h, uint32_t node, int keep_results){
+    hashlife_node* n = &h->nodes[node];
+
+    if (!node || n->marked) return;
+    n->marked = 1;
+    if (n->level > HASHLIFE_LEAF_LEVEL){
+        mark(h, n->child[LEFT], keep_results);
+        mark(h, n->child[RIGHT], keep_results);
+    }
+    if (keep_results) mark(h, n->result, keep_results);
+}
+
+/**
+ * Frees every node that can not be reached from the stack, going through
+ * children and, if keep_results is set, memoized results. Otherwise the
+ * results whose node is freed are forgotten and computed again if needed
+ * */
+static void collect(hashlife* h, int keep_results){
+    uint32_t node;
+    size_t i;
+
+    for(i=0; i<h->stack_size; i++) mark(h, h->stack[i], keep_results);
+
+    if (!keep_results){
+        for(node=1; node<h->num_nodes; node++){
+            if (h->nodes[node].marked && h->nodes[node].result
+                && !h->nodes[h->nodes[node].result].marked) h->nodes[node].result = 0;
+        }
+    }
+
+    memset(h->buckets, 0, sizeof(uint32_t) * h->num_buckets);
+    h->free_list = 0;
+    h->live_nodes = 0;
+    for(node=h->num_nodes-1; node>0; node--){
+        if (h->nodes[node].marked){
+            h->nodes[node].marked = 0;
+            insert_node(h, node);
+            h->live_nodes++;
+        } else {
+            h->nodes[node].level = -1;
+            h->nodes[node].result = 0;
+            h->nodes[node].next = h->free_list;
+            h->free_list = node;
+        }
+    }
+}
+
+/**
+ * Doubles the hash table when it holds more nodes than buckets.
+ * If there is no memory for it the chains just get longer
+ * */
+static void grow_buckets(hashlife* h){
+    uint32_t* buckets;
+    uint32_t node;
+
+    if (h->live_nodes <= h->num_buckets || h->num_buckets >= ((uint32_t)1 << 31)) return;
+    buckets = (uint32_t*) calloc (sizeof(uint32_t), (size_t)h->num_buckets * 2);
+    if (!buckets) return;
+    free(h->buckets);
+    h->buckets = buckets;
+    h->num_buckets *= 2;
+    for(node=1; node<h->num_nodes; node++)
+        if (h->nodes[node].level >= 0) insert_node(h, node);
+}
+
+/**
+ * Hands out an unused node, collecting garbage first if the pool is full
+ * and at the memory cap. If keeping the memoized results frees little,
+ * they are dropped too; on lattices that never repeat nearly every node
+ * hangs from some result. If even that frees little, the pool is let
+ * grow past the cap instead of collecting again and again. Returns 0 if
+ * there is not enough memory
+ * */
+static uint32_t new_node(hashlife* h){
+    hashlife_node* nodes;
+    uint32_t node, capacity;
+
+    if (!h->free_list && h->num_nodes == h->capacity && h->capacity >= h->collect_limit){
+        collect(h, 1);
+        if (h->live_nodes > h->capacity - h->capacity / 4) collect(h, 0);
+        if (h->live_nodes > h->capacity - h->capacity / 4){
+            if (!h->over_cap) fprintf(stderr, "Warning: the nodes in use do not fit in the memory cap\n");
+            h->over_cap = 1;
+            h->collect_limit = 2 * h->capacity;
+        }
+    }
+    if (h->free_list){
+        node = h->free_list;
+        h->free_list = h->nodes[node].next;
+        return node;
+    }
+
+    if (h->num_nodes == h->capacity){
+        if (h->capacity >= UINT32_MAX / 2) return 0;
+        capacity = 2 * h->capacity;
+        if (capacity > h->max_nodes && h->capacity < h->max_nodes) capacity = h->max_nodes;
+        nodes = (hashlife_node*) realloc (h->nodes, sizeof(hashlife_node) * capacity);
+        if (!nodes) return 0;
+        h->nodes = nodes;
+        h->capacity = capacity;
+    }
+    return h->num_nodes++;
+}
+
+/**
+ * Returns the only node with the given level and children, creating it
+ * if needed, and protects it. Returns 0 if there is not enough memory
+ * */
+static uint32_t find_node(hashlife* h, int level, uint32_t left, uint32_t right){
+    uint32_t child[2] = {left, right};
+    uint32_t node = h->buckets[hash_key(level, child) & (h->num_buckets - 1)];
+    hashlife_node* n;
+
+    while (node){
+        n = &h->nodes[node];
+        if (n->level == level && n->child[LEFT] == left && n->child[RIGHT] == right) break;
+        node = n->next;
+    }
+
+    if (!node){
+        node = new_node(h);
+        if (!node) return 0;
+        n = &h->nodes[node];
+        memcpy(n->child, child, sizeof(child));
+        n->level = (int8_t) level;
+        n->result = 0;
+        n->result_step = -1;
+        n->marked = 0;
+        insert_node(h, node);
+        h->live_nodes++;
+        grow_buckets(h);
+    }
+    return (protect(h, node) == 0) ? node : 0;
+}
+
+static uint32_t find_leaf(hashlife* h, uint64_t bits){
+    return find_node(h, HASHLIFE_LEAF_LEVEL, (uint32_t) bits, (uint32_t)(bits >> 32));
+}
+
+/**
+ * Node made of the inner halves of two contiguous nodes of the given
+ * level: the center of the segment they form
+ * */
+static uint32_t centered(hashlife* h, int level, uint32_t left, uint32_t right){
+    if (level > HASHLIFE_LEAF_LEVEL)
+        return find_node(h, level, h->nodes[left].child[RIGHT], h->nodes[right].child[LEFT]);
+    return find_leaf(h, (leaf_bits(&h->nodes[left]) >> 32) | (leaf_bits(&h->nodes[right]) << 32));
+}
+
+/**
+ * Result of a 128 cell node: its center 64 cells advanced 2^step (up to
+ * 32) generations. The segment is stepped two words at a time with the
+ * packed rule; the cells that see past its ends are wrong, but they are
+ * one more per side every generation and never reach the center
+ * */
+static uint32_t step_base(hashlife* h, uint32_t node, int step){
+    uint64_t w0 = leaf_bits(&h->nodes[h->nodes[node].child[LEFT]]);
+    uint64_t w1 = leaf_bits(&h->nodes[h->nodes[node].child[RIGHT]]);
+    uint64_t n0, n1;
+    int t, gens = 1 << step;
+
+    for(t=0; t<gens; t++){
+        n0 = packed_apply_rule(&h->prule, w0 << 1, w0, (w0 >> 1) | (w1 << 63));
+        n1 = packed_apply_rule(&h->prule, (w1 << 1) | (w0 >> 63), w1, w1 >> 1);
+        w0 = n0;
+        w1 = n1;
+    }
+    return find_leaf(h, (w0 >> 32) | (w1 << 32));
+}
+
+/**
+ * Returns the center half of the node advanced 2^step generations, with
+ * step <= level-2. The node is split in 3 overlapping segments of the
+ * level below, which are advanced; for the largest step their results are
+ * joined in 2 segments that are advanced again, and otherwise their
+ * centers are joined. Returns 0 if there is not enough memory
+ * */
+static uint32_t step_node(hashlife* h, uint32_t node, int step){
+    hashlife_node* n = &h->nodes[node];
+    int level = n->level, full = (step == level - 2);
+    int a, sub_step = full ? level - 3 : step;
+    uint32_t grand[4], res[3], half[2], sub, joined, result = 0;
+    size_t base = h->stack_size;
+
+    if (n->result && n->result_step == step) return n->result;
+
+    if (level == BASE_LEVEL){
+        result = step_base(h, node, step);
+    } else {
+        for(a=0; a<4; a++) grand[a] = h->nodes[h->nodes[node].child[a / 2]].child[a % 2];
+
+        for(a=0; a<3; a++){
+            sub = find_node(h, level - 1, grand[a], grand[a+1]);
+            if (!sub || !(res[a] = step_node(h, sub, sub_step)) || protect(h, res[a]) != 0) return 0;
+        }
+
+        for(a=0; a<2; a++){
+            if (full){
+                joined = find_node(h, level - 1, res[a], res[a+1]);
+                half[a] = joined ? step_node(h, joined, sub_step) : 0;
+                if (half[a] && protect(h, half[a]) != 0) return 0;
+            } else {
+                half[a] = centered(h, level - 2, res[a], res[a+1]);
+            }
+            if (!half[a]) return 0;
+        }
+        result = find_node(h, level - 1, half[LEFT], half[RIGHT]);
+    }
+    if (!result) return 0;
+
+    //the result stays alive through the node, everything else made here can go
+    h->stack_size = base;
+    n = &h->nodes[node];
+    n->result = result;
+    n->result_step = (int8_t) step;
+    return result;
+}
+
+/**
+ * Nodes already built for the segments of the periodic line, by level
+ * and position of the first cell modulo the lattice size
+ * */
+typedef struct {
+    uint64_t* keys;
+    uint32_t* values;
+    size_t capacity, size;
+} line_memo;
+
+static uint32_t* memo_slot(line_memo* memo, uint64_t key){
+    size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & (memo->capacity - 1);
+    while (memo->keys[i] && memo->keys[i] != key) i = (i + 1) & (memo->capacity - 1);
+    if (!memo->keys[i]){
+        memo->keys[i] = key;
+        memo->values[i] = 0;
+    }
+    return &memo->values[i];
+}
+
+static int memo_grow(line_memo* memo){
+    line_memo bigger;
+    size_t i;
+
+    bigger.capacity = memo->capacity ? 2 * memo->capacity : 4096;
+    bigger.size = memo->size;
+    bigger.keys = (uint64_t*) calloc (sizeof(uint64_t), bigger.capacity);
+    bigger.values = (uint32_t*) calloc (sizeof(uint32_t), bigger.capacity);
+    if (!bigger.keys || !bigger.values){
+        free(bigger.keys);
+        free(bigger.values);
+        return -1;
+    }
+    for(i=0; i<memo->capacity; i++)
+        if (memo->keys[i]) *memo_slot(&bigger, memo->keys[i]) = memo->values[i];
+    free(memo->keys);
+    free(memo->values);
+    *memo = bigger;
+    return 0;
+}
+
+/**
+ * Node for the 2^level cells of the line tiled with the lattice that
+ * start at cell pos modulo tam. half[l] is 2^(l-1) mod tam
+ * */
+static uint32_t build(hashlife* h, line_memo* memo, const char* cells, int tam, const int* half,
+                      int level, int pos){
+    uint64_t key = (uint64_t)level << 58 | (uint64_t)pos, bits = 0;
+    uint32_t *slot, node, left, right;
+    int i;
+
+    if (memo->size * 2 >= memo->capacity && memo_grow(memo) != 0) return 0;
+    slot = memo_slot(memo, key);
+    if (*slot) return *slot;
+
+    if (level == HASHLIFE_LEAF_LEVEL){
+        for(i=0; i<WORD_BITS; i++)
+            bits |= (uint64_t)CELL_BIT(cells[(pos + i) % tam]) << i;
+        node = find_leaf(h, bits);
+    } else {
+        left = build(h, memo, cells, tam, half, level - 1, pos);
+        right = left ? build(h, memo, cells, tam, half, level - 1, (pos + half[level]) % tam) : 0;
+        node = right ? find_node(h, level, left, right) : 0;
+    }
+    if (!node) return 0;
+
+    //the memo may have moved while building the children
+    *memo_slot(memo, key) = node;
+    memo->size++;
+    return node;
+}
+
+/**
+ * Writes the cells of the node that fall in the first tam cells of the
+ * line into the lattice, shifted by shift cells
+ * */
+static void extract(const hashlife* h, uint32_t node, int level, long long pos,
+                    int tam, int shift, char* cells){
+    const hashlife_node* n = &h->nodes[node];
+    uint64_t bits;
+    int i;
+
+    if (pos >= tam) return;
+    if (level == HASHLIFE_LEAF_LEVEL){
+        bits = leaf_bits(n);
+        for(i=0; i<WORD_BITS && pos + i < tam; i++)
+            cells[(shift + pos + i) % tam] = ((bits >> i) & 1) ? '1' : '0';
+        return;
+    }
+    extract(h, n->child[LEFT], level - 1, pos, tam, shift, cells);
+    extract(h, n->child[RIGHT], level - 1, pos + (1LL << (level - 1)), tam, shift, cells);
+}
+
+/**
+ * Prepares an empty universe for the rule, whose node pool takes at
+ * most (about) max_bytes. Returns 0 on success and -1 if there is not
+ * enough memory
+ * */
+int hashlife_create(hashlife* h, const rule_table* rule, size_t max_bytes){
+    size_t max_nodes = max_bytes / (sizeof(hashlife_node) + sizeof(uint32_t));
+
+    memset(h, 0, sizeof(hashlife));
+    packed_rule_init(&h->prule, rule);
+    h->max_nodes = (max_nodes < MIN_NODES) ? MIN_NODES
+                 : (max_nodes > UINT32_MAX / 2) ? UINT32_MAX / 2 : (uint32_t) max_nodes;
+    h->capacity = MIN_NODES;
+    h->collect_limit = h->max_nodes;
+    h->num_nodes = 1; //node 0 means none
+    h->num_buckets = INITIAL_BUCKETS;
+    h->nodes = (hashlife_node*) calloc (sizeof(hashlife_node), h->capacity);
+    h->buckets = (uint32_t*) calloc (sizeof(uint32_t), h->num_buckets);
+    if (!h->nodes || !h->buckets){
+        hashlife_destroy(h);
+        return -1;
+    }
+    return 0;
+}
+
+void hashlife_destroy(hashlife* h){
+    if(h->nodes) free(h->nodes);
+    if(h->buckets) free(h->buckets);
+    if(h->stack) free(h->stack);
+    h->nodes = NULL;
+    h->buckets = NULL;
+    h->stack = NULL;
+}
+
+/**
+ * Advances the lattice of tam cells stored in cells the given number of
+ * generations, one jump of 2^j generations per bit set. For every jump
+ * the lattice is tiled over a segment of the line long enough for the
+ * result to cover a whole period, which evolves just like the ring.
+ * The nodes stay cached for the next jumps. Returns 0 on success and
+ * -1 if there is not enough memory
+ * */
+int hashlife_advance(hashlife* h, char* cells, int tam, unsigned long long generations){
+    line_memo memo = {NULL, NULL, 0, 0};
+    int half[HASHLIFE_MAX_JUMP + 3];
+    int j, l, level, min_level = BASE_LEVEL, status = 0;
+    uint32_t root, result;
+
+    if (generations >> (HASHLIFE_MAX_JUMP + 1)) return -1;
+    while ((1LL << (min_level - 1)) < tam) min_level++;
+    half[1] = 1 % tam;
+    for(l=2; l<HASHLIFE_MAX_JUMP + 3; l++) half[l] = (2 * half[l-1]) % tam;
+
+    for(j=0; j<=HASHLIFE_MAX_JUMP && status == 0; j++){
+        if (!((generations >> j) & 1)) continue;
+        level = (j + 2 > min_level) ? j + 2 : min_level;
+
+        h->stack_size = 0;
+        memo.size = 0;
+        if (memo.keys) memset(memo.keys, 0, sizeof(uint64_t) * memo.capacity);
+        root = build(h, &memo, cells, tam, half, level, 0);
+        h->stack_size = 0;
+        if (!root || protect(h, root) != 0){
+            status = -1;
+            break;
+        }
+
+        result = step_node(h, root, j);
+        if (!result){
+            status = -1;
+            break;
+        }
+        extract(h, result, level - 1, 0, tam, half[level - 1], cells);
+    }
+
+    h->stack_size = 0;
+    free(memo.keys);
+    free(memo.values);
+    return status;
+}
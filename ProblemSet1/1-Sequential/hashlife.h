@@ -0,0 +1,72 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stdint.h>
+#include "functions.h"
+#include "packed.h"
+
+#define HASHLIFE_LEAF_LEVEL 6 //leaves hold 64 cells
+#define HASHLIFE_MAX_JUMP 59  //largest j of a single 2^j generations jump
+
+/**
+ * Segment of 2^level cells. Leaves keep their 64 cells in child[0] (cells
+ * 0-31) and child[1] (cells 32-63), cell i being bit i; any other node has
+ * two children of the level below (left, right). Nodes are indices into
+ * the pool of the universe, 0 meaning none. result is the center
+ * 2^(level-1) cells advanced 2^result_step generations
+ * */
+typedef struct {
+    uint32_t child[2];
+    uint32_t result;
+    uint32_t next;       //next node of the hash bucket, or of the free list
+    int8_t level;        //-1 for free nodes
+    int8_t result_step;
+    uint8_t marked;
+} hashlife_node;
+
+/**
+ * Hash-consed binary tree of the lattice: every segment is stored once, so
+ * every result is computed once. When the pool reaches max_nodes the nodes
+ * that are not reachable from the stack of nodes in use are collected
+ * */
+typedef struct {
+    packed_rule prule;
+    hashlife_node* nodes;
+    uint32_t num_nodes;   //nodes[1..num_nodes-1] have been handed out
+    uint32_t capacity;
+    uint32_t max_nodes;
+    uint32_t collect_limit; //pool size from which it is collected when full
+    uint32_t free_list;
+    uint32_t live_nodes;
+    uint32_t* buckets;
+    uint32_t num_buckets;
+    uint32_t* stack;
+    size_t stack_size, stack_capacity;
+    int over_cap;
+} hashlife;
+
+int hashlife_create(hashlife* h, const rule_table* rule, size_t max_bytes);
+void hashlife_destroy(hashlife* h);
+int hashlife_advance(hashlife* h, char* cells, int tam, unsigned long long generations);
+
+#endif
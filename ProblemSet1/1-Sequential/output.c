@@ -0,0 +1,273 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "output.h"
+#include "rle.h"
+
+/**
+ * Writes the formatted bytes to the file
+ * */
+static void flush_buffer(output_pipeline* p){
+    if (p->used > 0 && fwrite(p->buffer, sizeof(char), p->used, p->out) != p->used) p->failed = 1;
+    p->used = 0;
+}
+
+static void put_bytes(output_pipeline* p, const char* bytes, size_t size){
+    size_t chunk;
+
+    while (size > 0){
+        if (p->used == OUTPUT_BUFFER) flush_buffer(p);
+        chunk = (size < OUTPUT_BUFFER - p->used) ? size : OUTPUT_BUFFER - p->used;
+        memcpy(p->buffer + p->used, bytes, chunk);
+        p->used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+/**
+ * Writes the title as is for text, and as one comment per line for RLE
+ * */
+static void write_title(output_pipeline* p, const char* title){
+    const char* end;
+
+    if (p->format == OUTPUT_TEXT){
+        put_bytes(p, title, strlen(title));
+        return;
+    }
+    while (*title){
+        end = strchr(title, '\n');
+        if (!end) end = title + strlen(title);
+        put_bytes(p, "#C ", 3);
+        put_bytes(p, title, end - title);
+        put_bytes(p, "\n", 1);
+        title = *end ? end + 1 : end;
+    }
+}
+
+/**
+ * Maps count cells to their symbols in the buffer, which must have room
+ * for them. There are no branches: '1' is odd and '0' even, so the low
+ * bit of every byte selects the symbol, 8 cells per 64-bit word
+ * */
+static void put_symbols(output_pipeline* p, const char* cells, size_t count){
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t dead = ones * (unsigned char) p->symbols[0];
+    const uint64_t flip = ones * (unsigned char) (p->symbols[0] ^ p->symbols[1]);
+    char* text = p->buffer + p->used;
+    uint64_t word;
+    size_t j;
+
+    for(j=0; j+8<=count; j+=8){
+        memcpy(&word, cells + j, sizeof word);
+        word = dead ^ (((word & ones) * 0xff) & flip);
+        memcpy(text + j, &word, sizeof word);
+    }
+    for(; j<count; j++) text[j] = p->symbols[0] ^ (-(cells[j] & 1) & (p->symbols[0] ^ p->symbols[1]));
+    p->used += count;
+}
+
+static void write_text(output_pipeline* p, const output_frame* frame){
+    const char* cells = frame->cells;
+    size_t left, chunk, cols = frame->cols;
+    int i;
+
+    for(i=0; i<frame->rows; i++){
+        //rows longer than the buffer go out in pieces
+        for(left=cols; left>0; left-=chunk){
+            if (p->used == OUTPUT_BUFFER) flush_buffer(p);
+            chunk = (left < OUTPUT_BUFFER - p->used) ? left : OUTPUT_BUFFER - p->used;
+            put_symbols(p, cells, chunk);
+            cells += chunk;
+        }
+        put_bytes(p, "\n", 1);
+    }
+}
+
+/**
+ * The formatted bytes go out first, then the pattern is streamed to the
+ * file by the RLE writer
+ * */
+static void write_rle(output_pipeline* p, const output_frame* frame){
+    rle_writer w;
+    int i;
+
+    flush_buffer(p);
+    if (rle_writer_open(&w, p->out, frame->cols, frame->rows) != 0){
+        p->failed = 1;
+        return;
+    }
+    for(i=0; i<frame->rows; i++) rle_writer_put_row(&w, frame->cells + (size_t)i * frame->cols);
+    if (rle_writer_close(&w) != 0) p->failed = 1;
+}
+
+static void write_frame(output_pipeline* p, const output_frame* frame){
+    write_title(p, frame->title);
+    if (p->format == OUTPUT_TEXT) write_text(p, frame);
+    else write_rle(p, frame);
+}
+
+/**
+ * Loop of the writer thread: takes the frames in order until the pipeline
+ * is closed and the queue is empty
+ * */
+static void* writer_main(void* arg){
+    output_pipeline* p = (output_pipeline*) arg;
+    output_frame* frame;
+    int empty;
+
+    for(;;){
+        pthread_mutex_lock(&p->lock);
+        while (p->queued == 0 && !p->closing) pthread_cond_wait(&p->changed, &p->lock);
+        if (p->queued == 0){
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        frame = &p->frames[p->first];
+        pthread_mutex_unlock(&p->lock);
+
+        //the frame is not touched by the publisher until it is handed back
+        write_frame(p, frame);
+
+        pthread_mutex_lock(&p->lock);
+        p->first = (p->first + 1) % p->num_frames;
+        p->queued--;
+        empty = p->queued == 0;
+        pthread_cond_signal(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+
+        //while the publisher is ahead the frames pile up in the buffer
+        if (empty) flush_buffer(p);
+    }
+    flush_buffer(p);
+    return NULL;
+}
+
+/**
+ * Reads the name of a format ("text" or "rle"). Returns 0 on success and
+ * -1 if it is not known
+ * */
+int output_format_parse(const char* name, output_format* format){
+    if (strcmp(name, "text") == 0) *format = OUTPUT_TEXT;
+    else if (strcmp(name, "rle") == 0) *format = OUTPUT_RLE;
+    else return -1;
+    return 0;
+}
+
+/**
+ * Starts the output of frames of up to frame_cells cells to out, with a
+ * queue of num_frames frames. symbols are the characters of a dead and a
+ * live cell in text. Returns 0 on success and -1 if there is not enough
+ * memory
+ * */
+int output_open(output_pipeline* p, FILE* out, output_format format, const char* symbols,
+                int num_frames, size_t frame_cells){
+    int i;
+
+    memset(p, 0, sizeof *p);
+    p->out = out;
+    p->format = format;
+    p->symbols[0] = symbols[0];
+    p->symbols[1] = symbols[1];
+    p->num_frames = (num_frames < 1) ? 1 : num_frames;
+    p->buffer = (char*) malloc (OUTPUT_BUFFER);
+    p->frames = (output_frame*) calloc (sizeof(output_frame), p->num_frames);
+    if (!p->buffer || !p->frames){
+        free(p->buffer);
+        free(p->frames);
+        return -1;
+    }
+    for(i=0; i<p->num_frames; i++){
+        p->frames[i].cells = (char*) malloc (frame_cells ? frame_cells : 1);
+        if (!p->frames[i].cells){
+            while (i > 0) free(p->frames[--i].cells);
+            free(p->buffer);
+            free(p->frames);
+            return -1;
+        }
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->changed, NULL);
+    p->threaded = pthread_create(&p->writer, NULL, writer_main, p) == 0;
+    return 0;
+}
+
+/**
+ * Takes the next frame of the queue for a rows x cols matrix, waiting for
+ * the writer if the queue is full, and returns its cells, which the
+ * publisher fills before calling output_frame_end
+ * */
+char* output_frame_begin(output_pipeline* p, int rows, int cols, const char* title){
+    output_frame* frame;
+
+    pthread_mutex_lock(&p->lock);
+    while (p->queued == p->num_frames) pthread_cond_wait(&p->changed, &p->lock);
+    frame = &p->frames[(p->first + p->queued) % p->num_frames];
+    pthread_mutex_unlock(&p->lock);
+
+    snprintf(frame->title, sizeof frame->title, "%s", title);
+    frame->rows = rows;
+    frame->cols = cols;
+    return frame->cells;
+}
+
+/**
+ * Hands the frame taken by output_frame_begin to the writer
+ * */
+void output_frame_end(output_pipeline* p){
+    if (!p->threaded){
+        write_frame(p, &p->frames[p->first]);
+        flush_buffer(p);
+        return;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->queued++;
+    pthread_cond_signal(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Waits for the frames in the queue to be written and frees the
+ * pipeline. Returns 0 on success and -1 if some write failed
+ * */
+int output_close(output_pipeline* p){
+    int i;
+
+    if (p->threaded){
+        pthread_mutex_lock(&p->lock);
+        p->closing = 1;
+        pthread_cond_signal(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->writer, NULL);
+    }
+    if (fflush(p->out) != 0) p->failed = 1;
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->changed);
+    for(i=0; i<p->num_frames; i++) free(p->frames[i].cells);
+    free(p->frames);
+    free(p->buffer);
+    return p->failed ? -1 : 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include "packed.h"
+
+/**
+ * Builds the masks of the packed rule from the lookup table
+ * */
+void packed_rule_init(packed_rule* prule, const rule_table* table){
+    int i;
+    for(i=0; i<8; i++)
+        prule->masks[i] = (table->outputs[i] == '1') ? ~(uint64_t)0 : 0;
+}
+
+/**
+ * Allocates a lattice of tam cells, all of them 0.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int packed_lattice_create(packed_lattice* lattice, int tam){
+    lattice->tam = tam;
+    lattice->num_words = (tam + WORD_BITS - 1) / WORD_BITS;
+    lattice->tail_bits = tam - (lattice->num_words - 1) * WORD_BITS;
+    lattice->words = (uint64_t*) calloc (sizeof(uint64_t), lattice->num_words);
+    return lattice->words ? 0 : -1;
+}
+
+void packed_lattice_destroy(packed_lattice* lattice){
+    if (lattice->words) free(lattice->words);
+    lattice->words = NULL;
+}
+
+/**
+ * Packs a vector of tam '0'/'1' characters into the lattice
+ * */
+void packed_lattice_from_chars(packed_lattice* lattice, const char* cells){
+    int i;
+    memset(lattice->words, 0, sizeof(uint64_t) * lattice->num_words);
+    for(i=0; i<lattice->tam; i++)
+        lattice->words[i / WORD_BITS] |= (uint64_t)CELL_BIT(cells[i]) << (i % WORD_BITS);
+}
+
+/**
+ * Unpacks the lattice into tam characters, using zero and one
+ * for the two states (e.g. '0'/'1', or ' '/'#' for printing)
+ * */
+void packed_lattice_to_chars(const packed_lattice* lattice, char* cells, char zero, char one){
+    int i;
+    for(i=0; i<lattice->tam; i++)
+        cells[i] = ((lattice->words[i / WORD_BITS] >> (i % WORD_BITS)) & 1) ? one : zero;
+}
+
+/**
+ * Computes word w of the next generation, wrapping around the ends of
+ * the lattice. Only used for the first and last words, the rest of them
+ * go through the branch-free loop of packed_step_range
+ * */
+static uint64_t step_edge_word(const packed_rule* prule, const packed_lattice* in, int w){
+    int last = in->num_words - 1;
+    uint64_t cur = in->words[w];
+    uint64_t prev_bit, next_bit, l, r, result;
+
+    if (w == 0) prev_bit = (in->words[last] >> (in->tail_bits - 1)) & 1;
+    else prev_bit = in->words[w-1] >> (WORD_BITS - 1);
+    if (w == last) next_bit = in->words[0] & 1;
+    else next_bit = in->words[w+1] & 1;
+
+    l = (cur << 1) | prev_bit;
+    r = (cur >> 1) | (next_bit << ((w == last) ? in->tail_bits - 1 : WORD_BITS - 1));
+    result = packed_apply_rule(prule, l, cur, r);
+
+    //bits above the end of the lattice must stay 0
+    if (w == last && in->tail_bits < WORD_BITS)
+        result &= ((uint64_t)1 << in->tail_bits) - 1;
+    return result;
+}
+
+/**
+ * Computes the words first_word..last_word-1 of the next generation of in
+ * into out. Both lattices must have the same size. Different ranges can
+ * be computed at the same time, since words are only read from in
+ * */
+void packed_step_range(const packed_rule* prule, const packed_lattice* in, packed_lattice* out,
+                       int first_word, int last_word){
+    const uint64_t* src = in->words;
+    uint64_t* dst = out->words;
+    int w, begin = first_word, end = last_word;
+
+    if (begin >= end) return;
+    if (begin == 0){
+        dst[0] = step_edge_word(prule, in, 0);
+        begin = 1;
+    }
+    if (end == in->num_words && begin < end){
+        dst[end-1] = step_edge_word(prule, in, end-1);
+        end--;
+    }
+
+    for(w=begin; w<end; w++){
+        dst[w] = packed_apply_rule(prule, (src[w] << 1) | (src[w-1] >> (WORD_BITS - 1)), src[w],
+                                   (src[w] >> 1) | (src[w+1] << (WORD_BITS - 1)));
+    }
+}
+
+/**
+ * Computes the whole next generation of in into out
+ * */
+void packed_step(const packed_rule* prule, const packed_lattice* in, packed_lattice* out){
+    packed_step_range(prule, in, out, 0, in->num_words);
+}
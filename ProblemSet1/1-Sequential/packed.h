@@ -0,0 +1,80 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdint.h>
+#include "functions.h"
+
+#define WORD_BITS 64
+
+/**
+ * Elementary rule in the form used by the bit-packed engine: one mask per
+ * neighborhood, all ones if the transformation function outputs 1 for it
+ * and all zeros otherwise. Entry l<<2 | c<<1 | r, like in rule_table
+ * */
+typedef struct {
+    uint64_t masks[8];
+} packed_rule;
+
+/**
+ * Lattice of tam cells stored 64 per word. Cell i is bit i%64 of word
+ * i/64, and the bits of the last word above the lattice size are zero
+ * */
+typedef struct {
+    int tam;
+    int num_words;
+    int tail_bits;  //valid bits in the last word (1..64)
+    uint64_t* words;
+} packed_lattice;
+
+/**
+ * Bitwise multiplexer: for every bit, takes a where s is 1 and b where s is 0
+ * */
+static inline uint64_t packed_mux(uint64_t s, uint64_t a, uint64_t b){
+    return (s & a) | (~s & b);
+}
+
+/**
+ * Evaluates the rule on 64 cells at once. l, c and r hold the left
+ * neighbors, the cells and the right neighbors. The rule table is walked
+ * as a binary decision tree on r, then c, then l, so any of the 256
+ * elementary rules costs seven multiplexers
+ * */
+static inline uint64_t packed_apply_rule(const packed_rule* prule, uint64_t l, uint64_t c, uint64_t r){
+    const uint64_t* t = prule->masks;
+    uint64_t left0 = packed_mux(c, packed_mux(r, t[3], t[2]), packed_mux(r, t[1], t[0]));
+    uint64_t left1 = packed_mux(c, packed_mux(r, t[7], t[6]), packed_mux(r, t[5], t[4]));
+    return packed_mux(l, left1, left0);
+}
+
+void packed_rule_init(packed_rule* prule, const rule_table* table);
+
+int packed_lattice_create(packed_lattice* lattice, int tam);
+void packed_lattice_destroy(packed_lattice* lattice);
+void packed_lattice_from_chars(packed_lattice* lattice, const char* cells);
+void packed_lattice_to_chars(const packed_lattice* lattice, char* cells, char zero, char one);
+
+void packed_step_range(const packed_rule* prule, const packed_lattice* in, packed_lattice* out,
+                       int first_word, int last_word);
+void packed_step(const packed_rule* prule, const packed_lattice* in, packed_lattice* out);
+
+#endif
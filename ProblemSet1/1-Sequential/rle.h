@@ -0,0 +1,66 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef RLE_H
+#define RLE_H
+
+#include <stdio.h>
+
+#define RLE_LINE 70  //longest line of run length encoded data
+
+/**
+ * Reads a pattern in run length encoding (RLE) one row at a time, so that
+ * neither the file nor the dense matrix has to be in memory. After the #
+ * comment lines, the header (x = width, y = height) gives the size of the
+ * pattern, and its rows follow as runs of dead (b) and live (o) cells,
+ * each row ending with $ (a count before it skips empty rows) and the
+ * pattern with !. Missing cells at the end of a row and missing rows at
+ * the end of the pattern are dead
+ * */
+typedef struct {
+    FILE* file;
+    const char* name;  //of the file, for the error messages
+    long width, height;
+    long row;          //rows read so far
+    long empty_rows;   //empty rows to be returned before the next runs
+    int done;          //the ! was read
+} rle_reader;
+
+/**
+ * Writes a pattern in RLE one row at a time. Empty rows are only counted
+ * until a row with live cells comes, so that trailing ones are left out
+ * */
+typedef struct {
+    FILE* file;
+    long width, height;
+    long row;          //rows written so far
+    long empty_rows;   //row ends not written yet
+    int line_length;   //of the line being written
+} rle_writer;
+
+int rle_is_rle(FILE* f);
+int rle_reader_open(rle_reader* r, FILE* f, const char* name);
+int rle_read_row(rle_reader* r, long first_col, long num_cols, char* cells);
+int rle_skip_rows(rle_reader* r, long num_rows);
+int rle_writer_open(rle_writer* w, FILE* f, long width, long height);
+void rle_writer_put_row(rle_writer* w, const char* cells);
+int rle_writer_close(rle_writer* w);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "workers.h"
+
+//busy-wait iterations before a waiting worker starts yielding the processor
+#define SPIN_LIMIT 4096
+
+/**
+ * Sense-reversing barrier. The last worker to arrive resets the counter
+ * and moves to the next phase, which releases the others. Waiting is done
+ * spinning for a short while (generations are usually short) and then
+ * yielding, so oversubscribed runs do not stall
+ * */
+typedef struct {
+    atomic_int remaining;
+    atomic_int phase;
+    int num_workers;
+} worker_barrier;
+
+typedef struct {
+    const worker_job* job;
+    worker_barrier barrier;
+    atomic_int start;
+    int num_workers;
+} worker_team;
+
+typedef struct {
+    worker_team* team;
+    int worker;
+} worker_arg;
+
+static void barrier_init(worker_barrier* barrier, int num_workers){
+    atomic_init(&barrier->remaining, num_workers);
+    atomic_init(&barrier->phase, 0);
+    barrier->num_workers = num_workers;
+}
+
+static void barrier_wait(worker_barrier* barrier){
+    int phase = atomic_load_explicit(&barrier->phase, memory_order_relaxed);
+    int spins = 0;
+
+    if (atomic_fetch_sub_explicit(&barrier->remaining, 1, memory_order_acq_rel) == 1){
+        atomic_store_explicit(&barrier->remaining, barrier->num_workers, memory_order_relaxed);
+        atomic_store_explicit(&barrier->phase, phase + 1, memory_order_release);
+        return;
+    }
+    while (atomic_load_explicit(&barrier->phase, memory_order_acquire) == phase){
+        if (spins < SPIN_LIMIT) spins++;
+        else sched_yield();
+    }
+}
+
+/**
+ * Generation loop run by every worker, worker 0 being the calling thread
+ * */
+static void run_worker(worker_team* team, int worker){
+    const worker_job* job = team->job;
+    int generation;
+
+    for(generation=0; generation<job->num_generations; generation++){
+        job->step(job->state, worker, team->num_workers, generation);
+        barrier_wait(&team->barrier);
+
+        if (job->publish_every > 0 && (generation + 1) % job->publish_every == 0){
+            if (worker == 0) job->publish(job->state, generation + 1);
+            barrier_wait(&team->barrier);
+        }
+    }
+}
+
+static void* worker_main(void* arg){
+    worker_arg* warg = (worker_arg*) arg;
+
+    //the team size is not known until every thread has been created
+    while (!atomic_load_explicit(&warg->team->start, memory_order_acquire)) sched_yield();
+    run_worker(warg->team, warg->worker);
+    return NULL;
+}
+
+/**
+ * Number of processors online, used as the default number of workers
+ * */
+int workers_default_count(void){
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count < 1) ? 1 : (int) count;
+}
+
+/**
+ * Splits total items among num_workers in contiguous ranges made of whole
+ * groups of grain items (so that two workers never write the same cache
+ * line), and returns the range first..last-1 of the given worker
+ * */
+void workers_split(int total, int grain, int worker, int num_workers, int* first, int* last){
+    long groups = (total + grain - 1) / grain;
+
+    *first = (int) (groups * worker / num_workers) * grain;
+    *last = (int) (groups * (worker + 1) / num_workers) * grain;
+    if (*first > total) *first = total;
+    if (*last > total) *last = total;
+}
+
+/**
+ * Runs the job on a team of job->num_workers threads (the calling thread
+ * included) that live until the last generation is done. If some thread
+ * cannot be created the job is run by fewer workers. Returns the number
+ * of workers used
+ * */
+int workers_run(const worker_job* job){
+    worker_team team;
+    pthread_t* threads = NULL;
+    worker_arg* args = NULL;
+    int i, created = 0;
+
+    team.job = job;
+    atomic_init(&team.start, 0);
+
+    if (job->num_workers > 1){
+        threads = (pthread_t*) calloc (sizeof(pthread_t), job->num_workers);
+        args = (worker_arg*) calloc (sizeof(worker_arg), job->num_workers);
+    }
+    if (threads && args){
+        for(i=1; i<job->num_workers; i++){
+            args[i].team = &team;
+            args[i].worker = i;
+            if (pthread_create(&threads[i], NULL, worker_main, &args[i]) != 0) break;
+            created++;
+        }
+    }
+
+    team.num_workers = created + 1;
+    barrier_init(&team.barrier, team.num_workers);
+    atomic_store_explicit(&team.start, 1, memory_order_release);
+
+    run_worker(&team, 0);
+
+    for(i=1; i<=created; i++) pthread_join(threads[i], NULL);
+    if(threads) free(threads);
+    if(args) free(args);
+    return team.num_workers;
+}
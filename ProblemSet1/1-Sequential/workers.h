@@ -0,0 +1,46 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+/**
+ * Work of a team of threads that compute the generations of an automaton
+ * together. For every generation, each worker calls step with its number
+ * (0..num_workers-1) and then waits for the rest at a barrier, so step
+ * must only write the part of the next generation that belongs to the
+ * worker. Every publish_every generations (0 = never) worker 0 calls
+ * publish with the number of generations computed while the others wait,
+ * so that the state can be printed safely
+ * */
+typedef struct {
+    int num_workers;
+    int num_generations;
+    int publish_every;
+    void (*step)(void* state, int worker, int num_workers, int generation);
+    void (*publish)(void* state, int generation);
+    void* state;
+} worker_job;
+
+int workers_default_count(void);
+void workers_split(int total, int grain, int worker, int num_workers, int* first, int* last);
+int workers_run(const worker_job* job);
+
+#endif
@@ -18,267 +18,1867 @@
  *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  * */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <limits.h>
 #include <mpi.h>
 #include <time.h>
 #include "functions.h"
+#include "bitsliced.h"
+#include "workers.h"
+#include "active.h"
+#include "state.h"
+#include "output.h"
+#include "rle.h"
+#include "bench.h"
+#include "trace.h"
+#include "balance.h"
+#include "generator.h"
 
 #define MAX_CHAR 1024 //default maximum amount of characters
+#define TILE 32       //rows and columns of a tile of the active map
+#define TILE_WORDS 4  //words of a tile of the active map, with the bit-sliced kernel
+#define OUTPUT_FRAMES 4 //frames that can wait to be written, in rank 0
+
+//the last complete checkpoint, the one before it and the one being written
+#define CHECKPOINT "checkpoint.state"
+#define CHECKPOINT_PREVIOUS "checkpoint.prev.state"
+#define CHECKPOINT_TMP "checkpoint.state.tmp"
+
+//directions of the 8 neighbors of a block, used as message tags
+enum {NORTH, SOUTH, WEST, EAST, NORTH_WEST, NORTH_EAST, SOUTH_WEST, SOUTH_EAST, NUM_DIRECTIONS};
+#define NUM_HALO_REQUESTS (2*NUM_DIRECTIONS) //one receive and one send per direction
 
+static const int opposite[NUM_DIRECTIONS] = {SOUTH, NORTH, EAST, WEST,
+                                             SOUTH_EAST, SOUTH_WEST, NORTH_EAST, NORTH_WEST};
+static const int direction_offset[NUM_DIRECTIONS][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1},
+                                                        {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+/**
+ * Block of the matrix owned by one process of the 2D Cartesian grid of
+ * processes. The block is stored row by row with a border of ghost cells
+ * ghost cells wide, that holds copies of the cells of the 8 neighbor blocks.
+ * Generations alternate between two buffers, and each of them has its own
+ * persistent requests for the halo
+ * */
+typedef struct {
+    MPI_Comm cart;
+    MPI_Comm row_comm;            //processes of the same row of the grid
+    int dims[2], coords[2];
+    int neighbors[NUM_DIRECTIONS];
+    int *row_counts, *row_displs; //rows of each row of processes
+    int *col_counts, *col_displs; //columns of each column of processes
+    int nrows, ncols;             //size of the block, without ghost cells
+    int ghost;                    //width of the ghost border
+    int stride;                   //ncols + 2*ghost
+    MPI_Datatype row_type, col_type, corner_type, block_type;
+    MPI_Request requests[2][NUM_HALO_REQUESTS];
+    int has_requests;
+} decomposition;
 
-/**Function that receives an input string and the transformation_function
- * file and returns the output according to the file. In case of error
- * returns the string "E"
+/**
+ * Splits num elements in parts as even as possible, the first parts
+ * getting one extra element when the division is not exact
  * */
-char* transform(char* input, FILE * funct){
-    char line[MAX_CHAR];
-    char *function_input = NULL, *function_output = NULL;
-    rewind(funct);
-    while(fgets(line, sizeof line, funct)!= NULL){ 
-      function_input = strtok(line, " ");
-      function_output = strtok(NULL, " ");
-      if (strcmp(function_input, input) == 0){
-          return function_output;
-      }
+void split(int num, int parts, int* counts, int* displs){
+    int i, rest = num % parts, total_sum = 0;
+    for(i=0; i<parts; i++){
+        counts[i] = num/parts;
+        if (rest != 0){
+            counts[i]++;
+            rest--;
+        }
+        displs[i] = total_sum;
+        total_sum += counts[i];
     }
-    return "E";
 }
 
 /**
- * Returns the module of the given numbers. Contrary to the
- * operator %, returns the module of negative numbers too
+ * Size of the block of the calling process for the current row and column
+ * counts, and datatypes of the halo messages, which are made again when
+ * the counts change (see rebalance)
  * */
-int module(int num1, int num2){
-    if (num1>=0) return num1%num2;
-    else return (num2+num1)%num2;
+void decomposition_layout(decomposition* d){
+    int ghost = d->ghost;
+
+    if (d->row_type != MPI_DATATYPE_NULL){
+        MPI_Type_free(&d->row_type);
+        MPI_Type_free(&d->col_type);
+        MPI_Type_free(&d->corner_type);
+        MPI_Type_free(&d->block_type);
+    }
+    d->nrows = d->row_counts[d->coords[0]];
+    d->ncols = d->col_counts[d->coords[1]];
+    d->stride = d->ncols + 2*ghost;
+
+    //one message per face and per corner
+    MPI_Type_vector(ghost, d->ncols, d->stride, MPI_CHAR, &d->row_type);
+    MPI_Type_vector(d->nrows, ghost, d->stride, MPI_CHAR, &d->col_type);
+    MPI_Type_vector(ghost, ghost, d->stride, MPI_CHAR, &d->corner_type);
+    MPI_Type_vector(d->nrows, d->ncols, d->stride, MPI_CHAR, &d->block_type);
+    MPI_Type_commit(&d->row_type);
+    MPI_Type_commit(&d->col_type);
+    MPI_Type_commit(&d->corner_type);
+    MPI_Type_commit(&d->block_type);
 }
 
+/**
+ * Creates a periodic 2D Cartesian grid of processes, assigns to the calling
+ * process its block of the tam x tam matrix and builds the datatypes used
+ * for the halo messages. Returns -1 if the matrix is too small to give at
+ * least ghost rows and columns to every process
+ * */
+int decomposition_create(decomposition* d, int tam, int num_procs, int ghost){
+    int periods[2] = {1, 1}, coords[2], i;
 
-int main(int argc, char *argv[]) {
-    char** matrix = NULL;
-    char** result_matrix = NULL;
-    char** scattered_matrix = NULL;
-    char** scattered_result = NULL;
-    char* first_vector = NULL, *last_vector = NULL;
-    FILE * initial_configuration = NULL;
-    FILE * transformation_function = NULL;
-    int i, j, num_iterations=-1, tam = -1, total_sum = 0;
-    int current_id, num_procs, rest;
-    char size[MAX_CHAR];
-    char char_act;
-    char partial_input[9];
-    int *sendcounts = NULL, *displacements = NULL;
+    d->dims[0] = d->dims[1] = 0;
+    MPI_Dims_create(num_procs, 2, d->dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, d->dims, periods, 1, &d->cart);
+    MPI_Comm_rank(d->cart, &i);
+    MPI_Cart_coords(d->cart, i, 2, d->coords);
+    MPI_Cart_sub(d->cart, (int[]){0, 1}, &d->row_comm);
 
+    for(i=0; i<NUM_DIRECTIONS; i++){
+        coords[0] = d->coords[0] + direction_offset[i][0];
+        coords[1] = d->coords[1] + direction_offset[i][1];
+        MPI_Cart_rank(d->cart, coords, &d->neighbors[i]); //periodic, so coords wrap around
+    }
 
-    //Argument check
-    num_iterations = atoi(argv[3]);
-    if (num_iterations<1){
-        fprintf(stderr, "Non-valid number of iterations\n");
-        return EXIT_FAILURE;
+    d->row_counts = (int*) calloc (sizeof(int), d->dims[0]);
+    d->row_displs = (int*) calloc (sizeof(int), d->dims[0]);
+    d->col_counts = (int*) calloc (sizeof(int), d->dims[1]);
+    d->col_displs = (int*) calloc (sizeof(int), d->dims[1]);
+    split(tam, d->dims[0], d->row_counts, d->row_displs);
+    split(tam, d->dims[1], d->col_counts, d->col_displs);
+
+    d->ghost = ghost;
+    if (tam / d->dims[0] < ghost || tam / d->dims[1] < ghost) return -1;
+    decomposition_layout(d);
+    return 0;
+}
+
+void decomposition_destroy(decomposition* d){
+    int i, j;
+    if (d->has_requests)
+        for(i=0; i<2; i++)
+            for(j=0; j<NUM_HALO_REQUESTS; j++) MPI_Request_free(&d->requests[i][j]);
+    free(d->row_counts);
+    free(d->row_displs);
+    free(d->col_counts);
+    free(d->col_displs);
+    if (d->row_type != MPI_DATATYPE_NULL) MPI_Type_free(&d->row_type);
+    if (d->col_type != MPI_DATATYPE_NULL) MPI_Type_free(&d->col_type);
+    if (d->corner_type != MPI_DATATYPE_NULL) MPI_Type_free(&d->corner_type);
+    if (d->block_type != MPI_DATATYPE_NULL) MPI_Type_free(&d->block_type);
+    MPI_Comm_free(&d->row_comm);
+    MPI_Comm_free(&d->cart);
+}
+
+/**
+ * Position inside the block of the first cell sent towards (or received
+ * from, if receive is set) direction dir, together with its datatype
+ * */
+char* halo_region(const decomposition* d, char* block, int dir, int receive, MPI_Datatype* type){
+    int g = d->ghost, row, col;
+
+    //rows/columns sent are the first/last inside the block, the ones received are outside
+    switch(direction_offset[dir][0]){
+        case -1: row = receive ? 0 : g; break;
+        case 1: row = receive ? d->nrows + g : d->nrows; break;
+        default: row = g;
     }
-    
-    /**USED FOR EXPERIMENTS
-    int k = atoi(argv[1]);
-    generate_nxn(k);
-    FILE * results = fopen("results2dparallel.txt", "a");
-    clock_t start = clock();
-    */
-
-    MPI_Init(&argc, &argv);
+    switch(direction_offset[dir][1]){
+        case -1: col = receive ? 0 : g; break;
+        case 1: col = receive ? d->ncols + g : d->ncols; break;
+        default: col = g;
+    }
+
+    if (dir == NORTH || dir == SOUTH) *type = d->row_type;
+    else if (dir == WEST || dir == EAST) *type = d->col_type;
+    else *type = d->corner_type;
+    return block + row * d->stride + col;
+}
+
+/**
+ * Creates the persistent requests that fill the ghost border of each of
+ * the two buffers with the cells of the neighbor blocks, and send them
+ * the cells they need from this block: one message per face and per corner
+ * */
+void halo_requests_init(decomposition* d, char* buffers[2]){
+    MPI_Datatype send_type, recv_type;
+    char *send_buf, *recv_buf;
+    int i, dir;
+
+    for(i=0; i<2; i++){
+        for(dir=0; dir<NUM_DIRECTIONS; dir++){
+            recv_buf = halo_region(d, buffers[i], opposite[dir], 1, &recv_type);
+            MPI_Recv_init(recv_buf, 1, recv_type, d->neighbors[opposite[dir]], dir,
+                          d->cart, &d->requests[i][dir]);
+            send_buf = halo_region(d, buffers[i], dir, 0, &send_type);
+            MPI_Send_init(send_buf, 1, send_type, d->neighbors[dir], dir,
+                          d->cart, &d->requests[i][NUM_DIRECTIONS + dir]);
+        }
+    }
+    d->has_requests = 1;
+}
+
+/**
+ * Rank 0 sends every process its block of matrix (gather is 0) or receives
+ * the blocks of all the processes into matrix (gather is 1). block is the
+ * local block of the calling process, ghost cells included
+ * */
+void transfer_blocks(const decomposition* d, char* matrix, char* block, int tam, int gather){
+    int rank, current_id, num_procs, coords[2];
+    int sizes[2] = {tam, tam}, subsizes[2], starts[2];
+    char* interior = block + d->ghost * d->stride + d->ghost;
+    MPI_Datatype subarray;
+    MPI_Request request;
+
+    MPI_Comm_rank(d->cart, &current_id);
+    MPI_Comm_size(d->cart, &num_procs);
+
+    if (gather) MPI_Isend(interior, 1, d->block_type, 0, 0, d->cart, &request);
+    else if (current_id != 0) MPI_Irecv(interior, 1, d->block_type, 0, 0, d->cart, &request);
+
+    if (current_id == 0){
+        for(rank=0; rank<num_procs; rank++){
+            MPI_Cart_coords(d->cart, rank, 2, coords);
+            subsizes[0] = d->row_counts[coords[0]];
+            subsizes[1] = d->col_counts[coords[1]];
+            starts[0] = d->row_displs[coords[0]];
+            starts[1] = d->col_displs[coords[1]];
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &subarray);
+            MPI_Type_commit(&subarray);
+            if (gather) MPI_Recv(matrix, 1, subarray, rank, 0, d->cart, MPI_STATUS_IGNORE);
+            else if (rank == 0) MPI_Sendrecv(matrix, 1, subarray, 0, 0, interior, 1, d->block_type,
+                                             0, 0, d->cart, MPI_STATUS_IGNORE);
+            else MPI_Send(matrix, 1, subarray, rank, 0, d->cart);
+            MPI_Type_free(&subarray);
+        }
+    }
+    if (gather || current_id != 0) MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+/**
+ * Opens the binary state file path for all the processes and reads its
+ * header, and the words of its rule into rule_bits if it is not NULL
+ * (STATE_RULE_WORDS(STATE_MAX_RULE_INPUTS) words). Returns 0 on success
+ * and -1 if it is not a valid state file, in which case the file is closed
+ * */
+int state_open_all(const char* path, MPI_File* fh, state_header* header, uint64_t* rule_bits){
+    uint64_t area[STATE_MAX_HEADER_WORDS] = {0};
+    MPI_Offset size;
+    int current_id, status = 0;
+
     MPI_Comm_rank(MPI_COMM_WORLD, &current_id);
-    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, fh) != MPI_SUCCESS){
+        if (current_id == 0) fprintf(stderr, "%s: could not be opened with MPI-IO\n", path);
+        return -1;
+    }
 
-    initial_configuration = fopen (argv[1], "r");
-    transformation_function = fopen(argv[2], "r");
-    if (!initial_configuration || !transformation_function){
-        fprintf(stderr, "Unable to read specified files\n");
-        MPI_Finalize();
-        return EXIT_FAILURE;
+    MPI_File_get_size(*fh, &size);
+    if ((size_t)size < sizeof area) MPI_File_read_at_all(*fh, 0, area, (int) size, MPI_BYTE, MPI_STATUS_IGNORE);
+    else MPI_File_read_at_all(*fh, 0, area, sizeof area, MPI_BYTE, MPI_STATUS_IGNORE);
+    memcpy(header, area, sizeof *header);
+    if (current_id == 0 && state_check_header(header, size, path) != 0) status = -1;
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0) MPI_File_close(fh);
+    else if (rule_bits && header->rule_inputs > 0)
+        memcpy(rule_bits, area + sizeof *header / sizeof(uint64_t),
+               sizeof(uint64_t) * STATE_RULE_WORDS(header->rule_inputs));
+    return status;
+}
+
+/**
+ * Reads the block of the calling process from the state file opened by
+ * state_open_all into block (ghost cells included). Every process reads
+ * the words that hold its columns of its rows, all in one collective
+ * call, and unpacks them; neighbor blocks may share a word, which is then
+ * read by both but only added to the partial checksum of the one that owns
+ * its first cell. Returns 0 on success and -1 otherwise
+ * */
+int read_state_block(const decomposition* d, MPI_File fh, const state_header* header, char* block,
+                     uint64_t* checksum){
+    int first_col = d->col_displs[d->coords[1]];
+    int first_word = first_col / STATE_WORD_BITS;
+    int num_words = (first_col + d->ncols - 1) / STATE_WORD_BITS + 1 - first_word;
+    int first_owned = (first_col + STATE_WORD_BITS - 1) / STATE_WORD_BITS - first_word;
+    int sizes[2] = {(int) header->rows, (int) header->row_words};
+    int subsizes[2] = {d->nrows, num_words}, starts[2] = {d->row_displs[d->coords[0]], first_word};
+    MPI_Datatype file_type, row_type;
+    uint64_t* words;
+    int i, status = 0;
+
+    *checksum = 0;
+    words = (uint64_t*) calloc (sizeof(uint64_t), (size_t)d->nrows * num_words);
+    if (!words) return -1;
+
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_UINT64_T, &file_type);
+    MPI_Type_contiguous(num_words, MPI_UINT64_T, &row_type);
+    MPI_Type_commit(&file_type);
+    MPI_Type_commit(&row_type);
+    MPI_File_set_view(fh, header->header_size, MPI_UINT64_T, file_type, "native", MPI_INFO_NULL);
+    if (MPI_File_read_all(fh, words, d->nrows, row_type, MPI_STATUS_IGNORE) != MPI_SUCCESS) status = -1;
+    MPI_Type_free(&file_type);
+    MPI_Type_free(&row_type);
+
+    for(i=0; i<d->nrows && status == 0; i++){
+        state_unpack_cells(words + (size_t)i * num_words, first_col - first_word * STATE_WORD_BITS,
+                           d->ncols, block + (size_t)(d->ghost + i) * d->stride + d->ghost);
+        *checksum += state_words_checksum(words + (size_t)i * num_words + first_owned,
+                                          (uint64_t)(starts[0] + i) * header->row_words
+                                          + first_word + first_owned, num_words - first_owned);
     }
+    free(words);
+    return status;
+}
 
+enum {OUTPUT_IDLE, OUTPUT_SWAP, OUTPUT_WRITE};
 
-    fgets(size, MAX_CHAR, initial_configuration);
-    tam = atoi(size);
-    if (tam<1){
-        fprintf(stderr, "Matrix size not valid\n");
-        return EXIT_FAILURE;
+/**
+ * State file being written in the background. Blocks side by side can
+ * share a word of a packed row, so the processes of each row of the grid
+ * first swap their cells in one all-to-all, each of them getting whole
+ * rows of their band of the matrix. Those rows are then packed and
+ * written by all the processes in one collective call. The cells of the
+ * block are copied when the output starts, and both steps are nonblocking,
+ * so the simulation goes on while they are in flight
+ * */
+typedef struct {
+    int phase;
+    int tam;
+    char path[MAX_CHAR];          //file being written
+    char final_path[MAX_CHAR];    //name it gets once complete, empty to keep path
+    char previous_path[MAX_CHAR]; //name the previous final_path gets, if any
+    char* block;                  //copy of the block, without ghost cells
+    char* rows;                   //band of whole rows of this process
+    uint64_t* words;              //those rows, packed
+    int *band_counts, *band_displs, *counts, *displs;
+    MPI_Datatype *send_types, *recv_types, row_type;
+    MPI_Request requests[2];
+    MPI_File fh;
+    state_header header;
+    uint64_t area[STATE_MAX_HEADER_WORDS]; //header and rule, as written
+} state_output;
+
+/**
+ * Allocates the buffers and builds the datatypes of the outputs of the
+ * tam x tam matrix split by d. Returns 0 on success and -1 otherwise (on
+ * every process)
+ * */
+int state_output_create(state_output* out, const decomposition* d, int tam){
+    int procs = d->dims[1], me = d->coords[1], c, status = 0;
+    int sizes[2], subsizes[2], starts[2];
+    uint64_t row_words = (tam + STATE_WORD_BITS - 1) / STATE_WORD_BITS;
+
+    memset(out, 0, sizeof *out);
+    out->phase = OUTPUT_IDLE;
+    out->row_type = MPI_DATATYPE_NULL;
+    out->tam = tam;
+    out->band_counts = (int*) calloc (sizeof(int), procs);
+    out->band_displs = (int*) calloc (sizeof(int), procs);
+    out->counts = (int*) calloc (sizeof(int), procs);
+    out->displs = (int*) calloc (sizeof(int), procs);
+    out->send_types = (MPI_Datatype*) calloc (sizeof(MPI_Datatype), procs);
+    out->recv_types = (MPI_Datatype*) calloc (sizeof(MPI_Datatype), procs);
+    out->block = (char*) calloc (sizeof(char), (size_t)d->nrows * d->ncols);
+    if (!out->band_counts || !out->band_displs || !out->counts || !out->displs || !out->send_types
+        || !out->recv_types || !out->block) status = -1;
+    else {
+        split(d->nrows, procs, out->band_counts, out->band_displs);
+        out->rows = (char*) calloc (sizeof(char), (size_t)out->band_counts[me] * tam + 1);
+        out->words = (uint64_t*) calloc (sizeof(uint64_t), (size_t)out->band_counts[me] * row_words + 1);
+        if (!out->rows || !out->words) status = -1;
     }
-        
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, d->cart);
+    if (status != 0) return -1;
 
-    matrix = (char **) calloc (tam, sizeof(char*));
+    //band c of the block goes to process c of the row, which gets the whole width of its band
+    for(c=0; c<procs; c++){
+        out->counts[c] = 1;
+        out->displs[c] = 0;
+        sizes[0] = d->nrows;
+        sizes[1] = subsizes[1] = d->ncols;
+        subsizes[0] = out->band_counts[c];
+        starts[0] = out->band_displs[c];
+        starts[1] = 0;
+        if (out->band_counts[c] > 0)
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &out->send_types[c]);
+        else
+            MPI_Type_contiguous(0, MPI_CHAR, &out->send_types[c]);
+        sizes[0] = subsizes[0] = out->band_counts[me];
+        sizes[1] = tam;
+        subsizes[1] = d->col_counts[c];
+        starts[0] = 0;
+        starts[1] = d->col_displs[c];
+        if (out->band_counts[me] > 0)
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &out->recv_types[c]);
+        else
+            MPI_Type_contiguous(0, MPI_CHAR, &out->recv_types[c]);
+        MPI_Type_commit(&out->send_types[c]);
+        MPI_Type_commit(&out->recv_types[c]);
+    }
+    MPI_Type_contiguous((int) row_words, MPI_UINT64_T, &out->row_type);
+    MPI_Type_commit(&out->row_type);
+    return 0;
+}
 
-    //fill in sendcounts and displacements array
-    sendcounts = (int*) calloc (sizeof(int), num_procs);
-    displacements = (int*) calloc (sizeof(int), num_procs);
+void state_output_destroy(state_output* out, const decomposition* d){
+    int c;
 
-    rest = tam%num_procs;
-    for (i=0; i<num_procs; i++){
-        sendcounts[i] = tam/(num_procs);
-        if (rest != 0){
-            sendcounts[i]++;
-            rest--;
+    if (out->row_type != MPI_DATATYPE_NULL && out->send_types){
+        for(c=0; c<d->dims[1]; c++){
+            MPI_Type_free(&out->send_types[c]);
+            MPI_Type_free(&out->recv_types[c]);
         }
-        displacements[i] = total_sum;
-        total_sum += sendcounts[i];
+        MPI_Type_free(&out->row_type);
+    }
+    free(out->band_counts);
+    free(out->band_displs);
+    free(out->counts);
+    free(out->displs);
+    free(out->send_types);
+    free(out->recv_types);
+    free(out->block);
+    free(out->rows);
+    free(out->words);
+}
+
+/**
+ * Starts writing the matrix held in the blocks, after generation
+ * generations, into path, together with rule. If final_path is not NULL
+ * the file is renamed to it once it is complete, the previous final_path
+ * being renamed to previous_path first, so that a complete state is
+ * always on disk. The output must be idle. Returns 0 on success and -1 if
+ * the file could not be created (on every process)
+ * */
+int state_output_start(state_output* out, const decomposition* d, const char* block, const char* path,
+                       const char* final_path, const char* previous_path, uint64_t generation,
+                       const rule_table* rule){
+    int i, current_id, opened, status;
+
+    MPI_Comm_rank(d->cart, &current_id);
+    snprintf(out->path, sizeof out->path, "%s", path);
+    snprintf(out->final_path, sizeof out->final_path, "%s", final_path ? final_path : "");
+    snprintf(out->previous_path, sizeof out->previous_path, "%s", previous_path ? previous_path : "");
+    for(i=0; i<d->nrows; i++)
+        memcpy(out->block + (size_t)i * d->ncols, block + (size_t)(d->ghost + i) * d->stride + d->ghost,
+               d->ncols);
+
+    memset(out->area, 0, sizeof out->area);
+    state_header_init(&out->header, out->tam, out->tam, generation, 0);
+    state_header_set_rule(&out->header, rule, out->area + sizeof out->header / sizeof(uint64_t));
+
+    opened = MPI_File_open(d->cart, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &out->fh)
+             == MPI_SUCCESS;
+    status = opened ? 0 : -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, d->cart);
+    if (status != 0){
+        if (current_id == 0) fprintf(stderr, "%s: could not be created\n", path);
+        if (opened) MPI_File_close(&out->fh);
+        return -1;
     }
+    MPI_File_set_size(out->fh, out->header.header_size
+                               + (MPI_Offset)out->tam * out->header.row_words * sizeof(uint64_t));
 
-    
-    //---------------------boss process: reads input matrix from file
-    if(current_id == 0){
-        matrix = (char **) calloc (tam, sizeof(char*));
-        for(i=0; i<tam; i++){
-            matrix[i] = (char *) calloc (tam, sizeof(char));
-            for(j=0; j<tam; j++){
-                do{
-                    char_act = fgetc(initial_configuration);
-                } while (char_act != '0' && char_act != '1' && char_act != EOF);
-                
-                if(char_act != EOF){
-                    matrix[i][j] = char_act;
-                }
-
-                if (matrix[i][j] != '0' && matrix[i][j] != '1'){
-                    fprintf(stderr, "Matrix contains non-boolean value\n");
-                    MPI_Finalize();
-                    return EXIT_FAILURE;
-                }
+    MPI_Ialltoallw(out->block, out->counts, out->displs, out->send_types,
+                   out->rows, out->counts, out->displs, out->recv_types, d->row_comm, &out->requests[0]);
+    out->requests[1] = MPI_REQUEST_NULL;
+    out->phase = OUTPUT_SWAP;
+    return 0;
+}
+
+/**
+ * Moves the output forward if the requests of its current phase have
+ * completed in every process, waiting for them if wait is set (then the
+ * output is finished when it returns). Returns -1 if the file could not
+ * be written, and 0 otherwise
+ * */
+int state_output_progress(state_output* out, const decomposition* d, int wait){
+    int me = d->coords[1], current_id, i, flags[2];
+    uint64_t checksum = 0, first_row;
+    MPI_Offset offset;
+
+    MPI_Comm_rank(d->cart, &current_id);
+    while (out->phase != OUTPUT_IDLE){
+        //every process has to see the phase completed before any of them goes on
+        flags[0] = 1;
+        flags[1] = 0;
+        if (wait){
+            if (MPI_Waitall(2, out->requests, MPI_STATUSES_IGNORE) != MPI_SUCCESS) flags[1] = -1;
+        } else if (MPI_Testall(2, out->requests, &flags[0], MPI_STATUSES_IGNORE) != MPI_SUCCESS) flags[1] = -1;
+        MPI_Allreduce(MPI_IN_PLACE, flags, 2, MPI_INT, MPI_MIN, d->cart);
+        if (!flags[0]) return 0;
+
+        if (flags[1] != 0 || out->phase == OUTPUT_WRITE){
+            MPI_File_close(&out->fh);
+            out->phase = OUTPUT_IDLE;
+            if (flags[1] != 0){
+                if (current_id == 0) fprintf(stderr, "%s: could not be written\n", out->path);
+                return -1;
             }
+            if (current_id == 0 && out->final_path[0] != '\0'){
+                if (out->previous_path[0] != '\0') rename(out->final_path, out->previous_path);
+                if (rename(out->path, out->final_path) != 0)
+                    fprintf(stderr, "%s: could not be renamed to %s\n", out->path, out->final_path);
+            }
+            return 0;
+        }
+
+        //the rows have arrived: the checksum of the file is the sum of the ones of every band
+        first_row = d->row_displs[d->coords[0]] + out->band_displs[me];
+        for(i=0; i<out->band_counts[me]; i++){
+            state_pack_cells(out->rows + (size_t)i * out->tam, out->tam,
+                             out->words + (size_t)i * out->header.row_words);
+            checksum += state_words_checksum(out->words + (size_t)i * out->header.row_words,
+                                             (first_row + i) * out->header.row_words, out->header.row_words);
         }
+        MPI_Allreduce(MPI_IN_PLACE, &checksum, 1, MPI_UINT64_T, MPI_SUM, d->cart);
+        out->header.checksum = state_checksum_fold(checksum);
+        memcpy(out->area, &out->header, sizeof out->header);
+
+        out->requests[0] = MPI_REQUEST_NULL;
+        if (current_id == 0)
+            MPI_File_iwrite_at(out->fh, 0, out->area, out->header.header_size, MPI_BYTE, &out->requests[0]);
+        offset = out->header.header_size + (MPI_Offset)first_row * out->header.row_words * sizeof(uint64_t);
+        MPI_File_iwrite_at_all(out->fh, offset, out->words, out->band_counts[me], out->row_type,
+                               &out->requests[1]);
+        out->phase = OUTPUT_WRITE;
     }
-    //----------------------------------------------------------------
+    return 0;
+}
 
-    scattered_matrix = (char**) calloc (sizeof(char*), tam); //each process has its own partial matrix
-    scattered_result = (char**) calloc (sizeof(char*), tam); //partial output
-    
-    first_vector = (char*)calloc(sizeof(char), tam); //vector containing the last elements of the previous column in the matrix
-    last_vector = (char*)calloc(sizeof(char), tam); //vector containing the first elements of the next column in the matrix
+/**
+ * Writes the tam x tam matrix held in the blocks into path as a binary
+ * state file, with rule, and waits for it. Returns 0 on success and -1
+ * otherwise (on every process)
+ * */
+int write_state_snapshot(const decomposition* d, const char* block, int tam, const char* path,
+                         uint64_t generation, const rule_table* rule){
+    state_output out;
+    int status;
 
-    result_matrix = (char**) calloc (sizeof(char*), tam);
+    status = state_output_create(&out, d, tam);
+    if (status == 0) status = state_output_start(&out, d, block, path, NULL, NULL, generation, rule);
+    if (status == 0) status = state_output_progress(&out, d, 1);
+    state_output_destroy(&out, d);
+    return status;
+}
 
-    for(i=0; i<tam; i++){
-        scattered_result[i] = (char*) calloc (sizeof(char), sendcounts[current_id]);
-        scattered_matrix[i] = (char*) calloc (sizeof(char), sendcounts[current_id]);
-        result_matrix[i] = (char*) calloc (sizeof(char), sendcounts[current_id]);
+/**
+ * Reads the block of the calling process from the checkpoint path, which
+ * has to hold a tam x tam matrix, its rule and a checksum that matches its
+ * rows. On success stored gets the rule of the checkpoint and generation
+ * the generations computed before it was written. Returns 0 on success and
+ * -1 otherwise (on every process)
+ * */
+int read_checkpoint(const decomposition* d, const char* path, int tam, char* block,
+                    rule_table* stored, uint64_t* generation){
+    uint64_t rule_bits[STATE_RULE_WORDS(STATE_MAX_RULE_INPUTS)];
+    uint64_t checksum;
+    state_header header;
+    MPI_File fh;
+    int current_id, status = 0;
+
+    MPI_Comm_rank(d->cart, &current_id);
+    if (current_id == 0 && access(path, R_OK) != 0) status = -1;
+    MPI_Bcast(&status, 1, MPI_INT, 0, d->cart);
+    if (status != 0 || state_open_all(path, &fh, &header, rule_bits) != 0) return -1;
+
+    if (header.rows != (uint64_t)tam || header.cols != (uint64_t)tam || header.checksum == 0
+        || header.rule_inputs != RULE_2D_INPUTS){
+        if (current_id == 0) fprintf(stderr, "%s: not a complete checkpoint of this matrix\n", path);
+        MPI_File_close(&fh);
+        return -1;
     }
+    if (read_state_block(d, fh, &header, block, &checksum) != 0) status = -1;
+    MPI_File_close(&fh);
+    MPI_Allreduce(MPI_IN_PLACE, &checksum, 1, MPI_UINT64_T, MPI_SUM, d->cart);
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, d->cart);
+    if (status == 0 && state_checksum_fold(checksum) != header.checksum){
+        if (current_id == 0) fprintf(stderr, "%s: checksum mismatch\n", path);
+        status = -1;
+    }
+    if (status == 0 && state_rule_load(&header, rule_bits, stored) != 0){
+        if (current_id == 0) fprintf(stderr, "%s: the stored transformation function is corrupt\n", path);
+        status = -1;
+    }
+    *generation = header.generation;
+    return status;
+}
 
-    //print initial input (for debugging purposes)
-    if (current_id == 0){
-        for(i=0; i<tam; i++){
-            if(i==0) printf("MOTHER MATRIX:\n");
-            printf("%s\n", matrix[i]);
+/**
+ * Computes the next generation of the cells of rows row0..row1-1 and
+ * columns col0..col1-1 of block (positions inside the block, ghost cells
+ * included) into result. Their neighbors must be up to date. Returns 1 if
+ * any of those cells is different from what result held before
+ * */
+int step_region(const rule_table* rule, const decomposition* d, const char* block, char* result,
+                int row0, int row1, int col0, int col1){
+    int i, j, s = d->stride, changed = 0;
+    const char *up, *cur, *down;
+    char cell;
+
+    for(i=row0; i<row1; i++){
+        up = block + (i-1) * s;
+        cur = up + s;
+        down = cur + s;
+        for(j=col0; j<col1; j++){
+            cell = rule->outputs[
+                  CELL_BIT(up[j-1]) << 8   | CELL_BIT(up[j]) << 7   | CELL_BIT(up[j+1]) << 6
+                | CELL_BIT(cur[j-1]) << 5  | CELL_BIT(cur[j]) << 4  | CELL_BIT(cur[j+1]) << 3
+                | CELL_BIT(down[j-1]) << 2 | CELL_BIT(down[j]) << 1 | CELL_BIT(down[j+1])];
+            changed |= cell != result[i*s + j];
+            result[i*s + j] = cell;
         }
     }
+    return changed;
+}
 
-    while(num_iterations>0){
-        for(i=0; i<tam; i++){
-            MPI_Scatterv(matrix[i], sendcounts, displacements, MPI_CHAR, scattered_matrix[i], 
-                        sendcounts[current_id], MPI_CHAR, 0, MPI_COMM_WORLD);  
+/**
+ * Computes the cells of rows row0..row1-1 and columns col0..col1-1 that are
+ * outside the rectangle inner_row0..inner_row1-1, inner_col0..inner_col1-1.
+ * Returns 1 if any of them changed, like step_region
+ * */
+int step_frame(const rule_table* rule, const decomposition* d, const char* block, char* result,
+                int row0, int row1, int col0, int col1,
+                int inner_row0, int inner_row1, int inner_col0, int inner_col1){
+    if (inner_row0 < row0) inner_row0 = row0;
+    if (inner_row0 > row1) inner_row0 = row1;
+    if (inner_row1 > row1) inner_row1 = row1;
+    if (inner_row1 < inner_row0) inner_row1 = inner_row0;
+    if (inner_col0 < col0) inner_col0 = col0;
+    if (inner_col0 > col1) inner_col0 = col1;
+    if (inner_col1 > col1) inner_col1 = col1;
+    if (inner_col1 < inner_col0) inner_col1 = inner_col0;
 
-            if (current_id == 0){ //case first process
-                MPI_Send(&scattered_matrix[i][sendcounts[current_id]-1], 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD);
-                MPI_Recv(&first_vector[i], 1, MPI_CHAR, num_procs-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    return step_region(rule, d, block, result, row0, inner_row0, col0, col1)
+         | step_region(rule, d, block, result, inner_row1, row1, col0, col1)
+         | step_region(rule, d, block, result, inner_row0, inner_row1, col0, inner_col0)
+         | step_region(rule, d, block, result, inner_row0, inner_row1, inner_col1, col1);
+}
 
-                MPI_Send(&scattered_matrix[i][0], 1, MPI_CHAR, num_procs-1, 0, MPI_COMM_WORLD);
-                MPI_Recv(&last_vector[i], 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+/**
+ * Rows row0..row1-1 and columns col0..col1-1 of the block (ghost cells
+ * included) covered by tile (r, c) of the active map
+ * */
+void tile_bounds(const decomposition* d, int r, int c, int* row0, int* row1, int* col0, int* col1){
+    int g = d->ghost;
 
-            } else if (current_id == num_procs-1){ //case last process
-                MPI_Recv(&first_vector[i], 1, MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&scattered_matrix[i][sendcounts[current_id]-1], 1, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+    *row0 = g + r*TILE;
+    *row1 = ((r+1)*TILE < d->nrows) ? g + (r+1)*TILE : g + d->nrows;
+    *col0 = g + c*TILE;
+    *col1 = ((c+1)*TILE < d->ncols) ? g + (c+1)*TILE : g + d->ncols;
+}
 
-                MPI_Recv(&last_vector[i], 1, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&scattered_matrix[i][0], 1, MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD);
-            } else { //case default process
-                MPI_Recv(&first_vector[i], 1, MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&scattered_matrix[i][sendcounts[current_id]-1], 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD);
+/**
+ * Computes the cells of the tiles of the rows of tiles first..last-1 that
+ * only see cells of the block, skipping the tiles that can not change, and
+ * records which of them changed
+ * */
+void step_tiles(const rule_table* rule, const decomposition* d, const char* block, char* result,
+                active_map* active, int generation, int first, int last){
+    int r, c, changed, g = d->ghost, row0, row1, col0, col1;
 
-                MPI_Recv(&last_vector[i], 1, MPI_CHAR, current_id+1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(&scattered_matrix[i][0], 1, MPI_CHAR, current_id-1, 0, MPI_COMM_WORLD);
+    for(r=first; r<last; r++){
+        for(c=0; c<active->cols; c++){
+            changed = 0;
+            if (active_tile_needed(active, generation, r, c)){
+                tile_bounds(d, r, c, &row0, &row1, &col0, &col1);
+                if (row0 < g+1) row0 = g+1;
+                if (row1 > d->nrows+g-1) row1 = d->nrows+g-1;
+                if (col0 < g+1) col0 = g+1;
+                if (col1 > d->ncols+g-1) col1 = d->ncols+g-1;
+                changed = step_region(rule, d, block, result, row0, row1, col0, col1);
             }
+            active_tile_set(active, generation, r, c, changed);
         }
+    }
+}
 
-        partial_input[9] = '\0';
-        for(i=0; i<tam; i++){
-            for(j=0; j<sendcounts[current_id]; j++){
-                if(j==0){ //case first column
-                    partial_input[0] = first_vector[module(i-1, tam)];
-                    partial_input[3] = first_vector[i];
-                    partial_input[6] = first_vector[module(i+1, tam)];
-                } else{ 
-                    partial_input[0] = scattered_matrix[module(i-1, tam)][module(j-1, tam)];
-                    partial_input[3] = scattered_matrix[module(i, tam)][module(j-1,tam)];
-                    partial_input[6] = scattered_matrix[module(i+1, tam)][module(j-1, tam)];
-                }
-
-                if(j==sendcounts[current_id]-1){ //case last column
-                    partial_input[2] = last_vector[module(i-1, tam)];
-                    partial_input[5] = last_vector[i];
-                    partial_input[8] = last_vector[module(i+1, tam)];
-                } else {
-                    partial_input[2] = scattered_matrix[module(i-1, tam)][module(j+1, tam)];
-                    partial_input[5] = scattered_matrix[module(i, tam)][module(j+1, tam)];
-                    partial_input[8] = scattered_matrix[module(i+1, tam)][module(j+1, tam)];
-                }
-
-                partial_input[1] = scattered_matrix[module(i-1, tam)][module(j, tam)];
-                partial_input[4] = scattered_matrix[module(i, tam)][module(j, tam)];
-                partial_input[7] = scattered_matrix[module(i+1, tam)][module(j, tam)];
-
-                scattered_result[i][j] = *transform(partial_input, transformation_function);
-            }
+/**
+ * Computes the cells of the block next to the ghost cells that belong to
+ * the rows of tiles first..last-1. They are always computed, since the
+ * changes of the ghost cells are not tracked, and their changes are
+ * recorded in the border flags of their tiles
+ * */
+void step_ring(const rule_table* rule, const decomposition* d, const char* block, char* result,
+               active_map* active, int generation, int first, int last){
+    int r, c, g = d->ghost, row0, row1, col0, col1;
+
+    for(r=first; r<last; r++){
+        for(c=0; c<active->cols; c++){
+            if (r != 0 && r != active->rows - 1 && c != 0 && c != active->cols - 1) continue;
+            tile_bounds(d, r, c, &row0, &row1, &col0, &col1);
+            active_border_set(active, generation, r, c,
+                              step_frame(rule, d, block, result, row0, row1, col0, col1,
+                                         g+1, d->nrows+g-1, g+1, d->ncols+g-1));
         }
+    }
+}
+
+/**
+ * Computes the share of worker (out of the num_workers threads of the
+ * process) of generation step, counted from the last halo exchange, of the
+ * block into result. With a ghost border of width g, generation step is
+ * valid in the block plus g-1-step cells of the border: the border cells
+ * are computed redundantly by the neighbor processes, so that g generations
+ * fit between two exchanges. In the first generation the halo messages have
+ * to be started: the cells that do not touch the ghost border are computed
+ * while they are in flight, and the rest once they have arrived. Only
+ * worker 0 calls MPI, so it also computes that border on its own. Inside
+ * the block, the tiles of the active map that can not change are skipped.
+ * The time of the computation and of the wait for the halo goes to trace,
+ * as generation number (the one being computed, counted for the whole run),
+ * and the seconds of computation alone are added to busy, the load of the
+ * worker (see rebalance)
+ * */
+void step_block(const rule_table* rule, const decomposition* d, const char* block, char* result,
+                active_map* active, int generation, int step, MPI_Request* requests,
+                int worker, int num_workers, trace_log* trace, int number, double* busy){
+    int g = d->ghost, first, last;
+    int row0 = step + 1, row1 = d->nrows + 2*g - 1 - step;
+    int col0 = step + 1, col1 = d->ncols + 2*g - 1 - step;
+    double since = trace_now(trace), computing = bench_now();
+
+    if (step > 0){
+        workers_split(row1 - row0, 1, worker, num_workers, &first, &last);
+        step_frame(rule, d, block, result, row0 + first, row0 + last, col0, col1,
+                   g, d->nrows+g, g, d->ncols+g);
+        workers_split(active->rows, 1, worker, num_workers, &first, &last);
+        step_ring(rule, d, block, result, active, generation, first, last);
+        step_tiles(rule, d, block, result, active, generation, first, last);
+        trace_mark(trace, worker, TRACE_COMPUTE, number, &since);
+        *busy += bench_now() - computing;
+        return;
+    }
 
+    if (worker == 0) MPI_Startall(NUM_HALO_REQUESTS, requests);
+    workers_split(active->rows, 1, worker, num_workers, &first, &last);
+    step_tiles(rule, d, block, result, active, generation, first, last);
+    trace_mark(trace, worker, TRACE_COMPUTE, number, &since);
+    *busy += bench_now() - computing;
+    if (worker != 0) return;
 
-        for(i=0; i<tam; i++)
-            MPI_Gatherv(scattered_result[i], sendcounts[current_id],  MPI_CHAR,  result_matrix[i],  sendcounts,
-                            displacements,  MPI_CHAR,  0,  MPI_COMM_WORLD);    
-        
-        //print result matrix (for debugging purposes)
-        if(current_id == 0){
-            printf("---> IT %d\nRESULT MATRIX:\n", num_iterations);
-            for(i=0; i<tam; i++){
-                printf("%s\n", result_matrix[i]);
+    MPI_Waitall(NUM_HALO_REQUESTS, requests, MPI_STATUSES_IGNORE);
+    trace_mark(trace, worker, TRACE_HALO, number, &since);
+    computing = bench_now();
+    step_frame(rule, d, block, result, row0, row1, col0, col1, g, d->nrows+g, g, d->ncols+g);
+    step_ring(rule, d, block, result, active, generation, 0, active->rows);
+    trace_mark(trace, worker, TRACE_COMPUTE, number, &since);
+    *busy += bench_now() - computing;
+}
+
+/**
+ * Allocates grid for a block of nrows x ncols cells with a ghost border
+ * ghost cells wide, stored one bit per cell for the bit-sliced kernel.
+ * The grid is a band (see bitsliced_band_create) whose stored rows and
+ * bits are the rows and columns of the block, ghost cells included: the
+ * ghost cells of the band itself are the outermost ones of the block, so
+ * they are never computed right, and they do not have to be, since each
+ * generation is only valid one cell further from the edge than the one
+ * before. Returns 0 on success and -1 if there is not enough memory
+ * */
+int block_grid_create(bitsliced_grid* grid, int nrows, int ncols, int ghost){
+    return bitsliced_band_create(grid, ncols + 2*ghost - 2, nrows + 2*ghost - 2);
+}
+
+/**
+ * Copies the cells of rows row0..row1-1 and columns col0..col1-1 of block
+ * (positions inside the block, ghost cells included) into grid
+ * */
+void block_grid_pack(bitsliced_grid* grid, const decomposition* d, const char* block,
+                     int row0, int row1, int col0, int col1){
+    //row i and column j of the block are row i-1 and column j-1 of the band
+    bitsliced_set_cells(grid, row0 - 1, row1 - 1, col0 - 1, block + (size_t)row0 * d->stride + col0, d->stride,
+                        col1 - col0);
+}
+
+/**
+ * Copies the cells of rows row0..row1-1 and columns col0..col1-1 of grid
+ * into block, as '0' or '1'
+ * */
+void block_grid_unpack(const bitsliced_grid* grid, const decomposition* d, char* block,
+                       int row0, int row1, int col0, int col1){
+    bitsliced_get_cells(grid, row0 - 1, row1 - 1, col0 - 1, block + (size_t)row0 * d->stride + col0, d->stride,
+                        col1 - col0);
+}
+
+/**
+ * Computes the words first_word..last_word-1 of the rows row0..row1-1 of
+ * the block (ghost cells included) of the next generation of in into out.
+ * Returns 1 if any of those words is different from what out held before
+ * */
+int step_grid(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+              int row0, int row1, int first_word, int last_word){
+    //row r of the block is row r-1 of the band
+    if (row0 >= row1 || first_word >= last_word) return 0;
+    return bitsliced_step_tile(brule, in, out, row0 - 1, row1 - 1, first_word, last_word);
+}
+
+/**
+ * Computes the words first_word..last_word-1 of the rows row0..row1-1 that
+ * are outside the rectangle of rows inner_row0..inner_row1-1 and words
+ * inner_first..inner_last-1. Returns 1 if any of them changed, like
+ * step_frame
+ * */
+int step_grid_frame(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+                    int row0, int row1, int first_word, int last_word,
+                    int inner_row0, int inner_row1, int inner_first, int inner_last){
+    if (inner_row0 < row0) inner_row0 = row0;
+    if (inner_row0 > row1) inner_row0 = row1;
+    if (inner_row1 > row1) inner_row1 = row1;
+    if (inner_row1 < inner_row0) inner_row1 = inner_row0;
+    if (inner_first < first_word) inner_first = first_word;
+    if (inner_first > last_word) inner_first = last_word;
+    if (inner_last > last_word) inner_last = last_word;
+    if (inner_last < inner_first) inner_last = inner_first;
+
+    return step_grid(brule, in, out, row0, inner_row0, first_word, last_word)
+         | step_grid(brule, in, out, inner_row1, row1, first_word, last_word)
+         | step_grid(brule, in, out, inner_row0, inner_row1, first_word, inner_first)
+         | step_grid(brule, in, out, inner_row0, inner_row1, inner_last, last_word);
+}
+
+/**
+ * Rows row0..row1-1 of the block and words first_word..last_word-1 of grid
+ * covered by tile (r, c) of the active map with the bit-sliced kernel: the
+ * rows of the tiles are those of the block, like in tile_bounds, and their
+ * words all the words of the grid, ghost cells included
+ * */
+void grid_tile_bounds(const decomposition* d, const bitsliced_grid* grid, int r, int c,
+                      int* row0, int* row1, int* first_word, int* last_word){
+    int g = d->ghost, words = bitsliced_cell_words(grid);
+
+    *row0 = g + r*TILE;
+    *row1 = ((r+1)*TILE < d->nrows) ? g + (r+1)*TILE : g + d->nrows;
+    *first_word = c*TILE_WORDS;
+    *last_word = ((c+1)*TILE_WORDS < words) ? (c+1)*TILE_WORDS : words;
+}
+
+/**
+ * block_grid_unpack of the columns col0..col1-1 of the rows of the block,
+ * only in the rows of tiles of active where they changed to reach the
+ * given generation: block already holds the others from two generations
+ * before. active is NULL to copy all of them
+ * */
+void block_grid_unpack_changed(const bitsliced_grid* grid, const decomposition* d, char* block,
+                               const active_map* active, int generation, int col0, int col1){
+    int r, c, g = d->ghost, row0, row1, first_word, last_word, changed;
+
+    if (!active){
+        block_grid_unpack(grid, d, block, g, d->nrows + g, col0, col1);
+        return;
+    }
+    for(r=0; r<active->rows; r++){
+        changed = 0;
+        for(c=col0 / WORD_BITS / TILE_WORDS; c<=(col1 - 1) / WORD_BITS / TILE_WORDS && !changed; c++)
+            changed = active_tile_changed(active, generation, r, c);
+        if (!changed) continue;
+        grid_tile_bounds(d, grid, r, 0, &row0, &row1, &first_word, &last_word);
+        block_grid_unpack(grid, d, block, row0, row1, col0, col1);
+    }
+}
+
+/**
+ * Creates the active map of a block of nrows x ncols cells: tiles of
+ * TILE x TILE cells, or of TILE rows and TILE_WORDS words of grid with the
+ * bit-sliced kernel (grid is NULL otherwise).
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int block_active_create(active_map* active, int nrows, int ncols, const bitsliced_grid* grid){
+    int cols = grid ? (bitsliced_cell_words(grid) + TILE_WORDS - 1) / TILE_WORDS : (ncols + TILE - 1) / TILE;
+
+    return active_map_create(active, (nrows + TILE - 1) / TILE, cols);
+}
+
+/**
+ * step_tiles with the bit-sliced kernel: computes the words of the tiles of
+ * the rows of tiles first..last-1 that neither hold nor touch any ghost
+ * cell, which are words inner_first..inner_last-1 of the rows that only
+ * see rows of the block, skipping the tiles that can not change, and
+ * records which of them changed
+ * */
+void step_grid_tiles(const bitsliced_rule* brule, const decomposition* d, const bitsliced_grid* in,
+                     bitsliced_grid* out, active_map* active, int generation, int first, int last,
+                     int inner_first, int inner_last){
+    int r, c, changed, g = d->ghost, row0, row1, first_word, last_word;
+
+    for(r=first; r<last; r++){
+        for(c=0; c<active->cols; c++){
+            changed = 0;
+            if (active_tile_needed(active, generation, r, c)){
+                grid_tile_bounds(d, in, r, c, &row0, &row1, &first_word, &last_word);
+                if (row0 < g+1) row0 = g+1;
+                if (row1 > d->nrows+g-1) row1 = d->nrows+g-1;
+                if (first_word < inner_first) first_word = inner_first;
+                if (last_word > inner_last) last_word = inner_last;
+                changed = step_grid(brule, in, out, row0, row1, first_word, last_word);
             }
+            active_tile_set(active, generation, r, c, changed);
         }
+    }
+}
+
+/**
+ * Returns 1 if any cell of rows row0..row1-1 and columns col0..col1-1 of
+ * the block is different in a than in b
+ * */
+int grid_cells_changed(const bitsliced_grid* a, const bitsliced_grid* b, int row0, int row1, int col0, int col1){
+    if (row0 >= row1 || col0 >= col1) return 0;
+    return bitsliced_cells_differ(a, b, row0 - 1, row1 - 1, col0 - 1, col1 - col0);
+}
+
+/**
+ * Returns 1 if any ghost cell of the block in rows row0-1..row1 and words
+ * first_word-1..last_word is different in a than in b
+ * */
+int grid_ghost_changed(const decomposition* d, const bitsliced_grid* a, const bitsliced_grid* b,
+                       int row0, int row1, int first_word, int last_word){
+    int g = d->ghost, rows = d->nrows + 2*g, cols = d->ncols + 2*g, col0, col1, inner0, inner1;
+
+    row0 = (row0 > 0) ? row0 - 1 : 0;
+    row1 = (row1 < rows) ? row1 + 1 : rows;
+    col0 = (first_word > 0) ? (first_word - 1) * WORD_BITS : 0;
+    col1 = ((last_word + 1) * WORD_BITS < cols) ? (last_word + 1) * WORD_BITS : cols;
+    inner0 = (row0 > g) ? row0 : g;
+    inner1 = (row1 < d->nrows + g) ? row1 : d->nrows + g;
+    return grid_cells_changed(a, b, row0, (row1 < g) ? row1 : g, col0, col1)
+        || grid_cells_changed(a, b, (row0 > d->nrows + g) ? row0 : d->nrows + g, row1, col0, col1)
+        || grid_cells_changed(a, b, inner0, inner1, col0, (col1 < g) ? col1 : g)
+        || grid_cells_changed(a, b, inner0, inner1, (col0 > d->ncols + g) ? col0 : d->ncols + g, col1);
+}
+
+/**
+ * Returns 1 if tile (r, c) of the active map holds or touches ghost cells,
+ * so that step_grid_tiles leaves part of it out. inner_first and inner_last
+ * are whole tiles
+ * */
+int grid_ring_tile(const active_map* active, int r, int c, int inner_first, int inner_last){
+    return r == 0 || r == active->rows - 1 || c < inner_first / TILE_WORDS || c >= inner_last / TILE_WORDS;
+}
+
+/**
+ * step_ring with the bit-sliced kernel: computes the words of the tiles of
+ * the rows of tiles first..last-1 that step_grid_tiles leaves out, which
+ * hold or touch ghost cells, and records their changes in the border flags
+ * of their tiles. previous is out when it still holds the ghost cells of
+ * the generation before in, and then the tiles whose ghost cells stayed
+ * the same are skipped like the others; it is NULL to compute them all
+ * */
+void step_grid_ring(const bitsliced_rule* brule, const decomposition* d, const bitsliced_grid* in,
+                    bitsliced_grid* out, const bitsliced_grid* previous, active_map* active, int generation,
+                    int first, int last, int inner_first, int inner_last){
+    int r, c, changed, g = d->ghost, row0, row1, first_word, last_word;
 
-        //output becomes new input for next iteration
-        if(current_id == 0){
-            for(i=0; i<tam; i++){
-                for(j=0; j<tam; j++){
-                    matrix[i][j] = result_matrix[i][j];
-                }
+    //before computing any tile, since that writes over the ghost cells in out
+    for(r=first; r<last && previous; r++){
+        for(c=0; c<active->cols; c++){
+            if (!grid_ring_tile(active, r, c, inner_first, inner_last)) continue;
+            grid_tile_bounds(d, in, r, c, &row0, &row1, &first_word, &last_word);
+            active_halo_set(active, r, c, grid_ghost_changed(d, in, previous, row0, row1, first_word, last_word));
+        }
+    }
+    for(r=first; r<last; r++){
+        for(c=0; c<active->cols; c++){
+            if (!grid_ring_tile(active, r, c, inner_first, inner_last)) continue;
+            changed = 0;
+            if (!previous || active_halo_needed(active, r, c) || active_tile_needed(active, generation, r, c)){
+                grid_tile_bounds(d, in, r, c, &row0, &row1, &first_word, &last_word);
+                changed = step_grid_frame(brule, in, out, row0, row1, first_word, last_word,
+                                          g+1, d->nrows+g-1, inner_first, inner_last);
             }
+            active_border_set(active, generation, r, c, changed);
+        }
+    }
+}
+
+/**
+ * step_block for outer-totalistic rules, with the blocks stored one bit
+ * per cell in grids and generation step computed from grids[current] into
+ * grids[1-current], a whole word of 64 cells at a time. The halo still
+ * travels in the character buffer block: in the first generation worker 0
+ * copies there the cells the neighbors need, and the ghost cells it gets
+ * back into grids[current]. Meanwhile the other workers compute the words
+ * that neither hold nor touch any ghost cell, which worker 0 never
+ * writes; it computes the rest once the halo has arrived. Those words are
+ * the tiles of the active map that can be skipped, as in step_block. With
+ * a single ghost cell, out still holds the ghost cells of the generation
+ * before once the halo arrives, so the tiles that hold or touch ghost cells
+ * are skipped too while those stay the same. Deeper ghost cells are
+ * computed between two exchanges, and then those tiles and the ghost rows
+ * are always computed
+ * */
+void step_block_bits(const bitsliced_rule* brule, const decomposition* d, bitsliced_grid* grids, char* block,
+                     active_map* active, int generation, int current, int step, MPI_Request* requests,
+                     int worker, int num_workers, trace_log* trace, int number, double* busy){
+    const bitsliced_grid* in = &grids[current];
+    bitsliced_grid* out = &grids[1 - current];
+    int g = d->ghost, rows = d->nrows + 2*g, cols = d->ncols + 2*g, words = bitsliced_cell_words(in);
+    int first, last, inner_first, inner_last;
+    double since = trace_now(trace), computing = bench_now();
+
+    //whole tiles of words whose neighbor words hold no ghost cell either
+    inner_first = ((g + WORD_BITS - 1) / WORD_BITS + 1 + TILE_WORDS - 1) / TILE_WORDS * TILE_WORDS;
+    inner_last = ((d->ncols + g) / WORD_BITS - 1) / TILE_WORDS * TILE_WORDS;
+    if (inner_first > words) inner_first = words;
+    if (inner_last < inner_first) inner_last = inner_first;
+
+    if (step > 0){
+        //the ghost rows that are still valid, outside the active map
+        workers_split(g - 1 - step, 1, worker, num_workers, &first, &last);
+        step_grid(brule, in, out, step + 1 + first, step + 1 + last, 0, words);
+        step_grid(brule, in, out, d->nrows + g + first, d->nrows + g + last, 0, words);
+        workers_split(active->rows, 1, worker, num_workers, &first, &last);
+        step_grid_ring(brule, d, in, out, NULL, active, generation, first, last, inner_first, inner_last);
+        step_grid_tiles(brule, d, in, out, active, generation, first, last, inner_first, inner_last);
+        trace_mark(trace, worker, TRACE_COMPUTE, number, &since);
+        *busy += bench_now() - computing;
+        return;
+    }
+
+    if (worker == 0){
+        block_grid_unpack(in, d, block, g, 2*g, g, d->ncols + g);
+        block_grid_unpack(in, d, block, d->nrows, d->nrows + g, g, d->ncols + g);
+        block_grid_unpack_changed(in, d, block, g == 1 ? active : NULL, generation, g, 2*g);
+        block_grid_unpack_changed(in, d, block, g == 1 ? active : NULL, generation, d->ncols, d->ncols + g);
+        MPI_Startall(NUM_HALO_REQUESTS, requests);
+    }
+    workers_split(active->rows, 1, worker, num_workers, &first, &last);
+    step_grid_tiles(brule, d, in, out, active, generation, first, last, inner_first, inner_last);
+    trace_mark(trace, worker, TRACE_COMPUTE, number, &since);
+    *busy += bench_now() - computing;
+    if (worker != 0) return;
+
+    MPI_Waitall(NUM_HALO_REQUESTS, requests, MPI_STATUSES_IGNORE);
+    trace_mark(trace, worker, TRACE_HALO, number, &since);
+    computing = bench_now();
+    block_grid_pack(&grids[current], d, block, 0, g, 0, cols);
+    block_grid_pack(&grids[current], d, block, d->nrows + g, rows, 0, cols);
+    block_grid_pack(&grids[current], d, block, g, d->nrows + g, 0, g);
+    block_grid_pack(&grids[current], d, block, g, d->nrows + g, d->ncols + g, cols);
+    step_grid(brule, in, out, 1, g, 0, words);
+    step_grid(brule, in, out, d->nrows + g, rows - 1, 0, words);
+    step_grid_ring(brule, d, in, out, g == 1 ? out : NULL, active, generation, 0, active->rows, inner_first,
+                   inner_last);
+    trace_mark(trace, worker, TRACE_COMPUTE, number, &since);
+    *busy += bench_now() - computing;
+}
+
+/**
+ * Gathers the tam x tam matrix held in the blocks into a frame of output,
+ * which is written while the next generations are computed. output is
+ * only given in rank 0, the other processes pass NULL. The wait for a free
+ * frame (when the printing thread falls behind) and the gather are timed
+ * as the given generation
+ * */
+void queue_matrix(const decomposition* d, output_pipeline* output, char* block, int tam, const char* title,
+                  trace_log* trace, int generation){
+    double since = trace_now(trace);
+    char* matrix = output ? output_frame_begin(output, tam, tam, title) : NULL;
+
+    if (output) trace_mark(trace, 0, TRACE_PRINT, generation, &since);
+    transfer_blocks(d, matrix, block, tam, 1);
+    if (output) output_frame_end(output);
+    trace_mark(trace, 0, TRACE_GATHER, generation, &since);
+}
+
+/**
+ * Seconds a worker spent computing since the blocks last moved, each window
+ * between two comparisons of the loads weighing half as much as the next
+ * one, on a cache line of its own
+ * */
+typedef struct {
+    double seconds;
+    char padding[64];
+} worker_load;
+
+/**
+ * State shared by the threads of a process: generation g is computed
+ * from buffers[g%2] into buffers[1-g%2], or from grids[g%2] into
+ * grids[1-g%2] with the bit-sliced kernel, in which case the buffers only
+ * get the cells when they are printed or saved (see simulation_block). The
+ * blocks of the processes may change size between two halo exchanges (see
+ * rebalance)
+ * */
+typedef struct {
+    const rule_table* rule;
+    const bitsliced_rule* brule;  //NULL if the rule is looked up in the table
+    decomposition* d;
+    active_map active;
+    char* buffers[2];
+    bitsliced_grid grids[2];      //the blocks, with the bit-sliced kernel
+    int unpacked;                 //generation copied from the grids into the buffers
+    output_pipeline* output;      //in rank 0, only if the matrix is printed
+    int tam;
+    int num_iterations;
+    int resumed;                  //iterations computed before the checkpoint the run resumed from
+    int current_id;
+    int output_every;
+    int snapshot_every;
+    int checkpoint_every;
+    double checkpoint_seconds;
+    double last_checkpoint;       //MPI_Wtime of the last checkpoint, in rank 0
+    state_output checkpoint;
+    uint64_t first_generation;    //generation of the initial configuration
+    trace_log* trace;
+    worker_load* loads;           //one per worker
+    int num_workers;
+    int balance_every;            //0 if the blocks never change
+    int balanced;                 //generation the last window of the loads started at
+    int settled;                  //first generation whose time counts in the loads (see rebalance)
+    double move_seconds;          //seconds the last move of the blocks took, 0 before the first one
+} simulation;
+
+void simulation_step(void* state, int worker, int num_workers, int generation){
+    simulation* sim = (simulation*) state;
+    int current = generation % 2;
+    double ignored = 0;
+    double* busy = (generation < sim->settled) ? &ignored : &sim->loads[worker].seconds;
+
+    if (sim->brule){
+        step_block_bits(sim->brule, sim->d, sim->grids, sim->buffers[current], &sim->active, generation, current,
+                        generation % sim->d->ghost, sim->d->requests[current], worker, num_workers,
+                        sim->trace, sim->resumed + generation + 1, busy);
+        return;
+    }
+    step_block(sim->rule, sim->d, sim->buffers[current], sim->buffers[1 - current], &sim->active,
+               generation, generation % sim->d->ghost, sim->d->requests[current], worker, num_workers,
+               sim->trace, sim->resumed + generation + 1, busy);
+}
+
+/**
+ * Character buffer holding the block after the given number of
+ * generations, copied from the grid first with the bit-sliced kernel
+ * */
+char* simulation_block(simulation* sim, int generation){
+    decomposition* d = sim->d;
+    int current = generation % 2;
+
+    if (sim->brule && sim->unpacked != generation){
+        block_grid_unpack(&sim->grids[current], d, sim->buffers[current], d->ghost, d->nrows + d->ghost,
+                          d->ghost, d->ncols + d->ghost);
+        sim->unpacked = generation;
+    }
+    return sim->buffers[current];
+}
+
+/**
+ * Moves the cells of both buffers from the blocks of old to the blocks of
+ * d, the same grid of processes with other row and column counts: every
+ * process sends each of the others the part of its old block that falls in
+ * their new one, all at once. When the boundaries move a little only the
+ * neighbors exchange cells. The ghost borders are not moved, the next halo
+ * exchange fills them. work holds 4*(dims[0]+dims[1]+num_procs) ints and
+ * types 2*num_procs datatypes
+ * */
+void migrate_blocks(const decomposition* old, char* old_buffers[2], const decomposition* d, char* buffers[2],
+                    int* work, MPI_Datatype* types){
+    int rows = d->dims[0], cols = d->dims[1], num_procs = rows * cols, g = d->ghost, q, i, coords[2];
+    int *row_send = work, *row_send_displs = row_send + rows, *row_recv = row_send_displs + rows;
+    int *row_recv_displs = row_recv + rows, *col_send = row_recv_displs + rows;
+    int *col_send_displs = col_send + cols, *col_recv = col_send_displs + cols;
+    int *col_recv_displs = col_recv + cols, *send_counts = col_recv_displs + cols;
+    int *recv_counts = send_counts + num_procs, *displs = recv_counts + num_procs;
+    int sizes[2], subsizes[2], starts[2];
+    MPI_Datatype *send_types = types, *recv_types = types + num_procs;
+
+    balance_overlaps(old->row_counts, old->row_displs, d->row_counts, d->row_displs, rows, d->coords[0],
+                     row_send, row_send_displs, row_recv, row_recv_displs);
+    balance_overlaps(old->col_counts, old->col_displs, d->col_counts, d->col_displs, cols, d->coords[1],
+                     col_send, col_send_displs, col_recv, col_recv_displs);
+
+    //process q gets the rows and columns of its new block that this one had, and the other way round
+    for(q=0; q<num_procs; q++){
+        MPI_Cart_coords(d->cart, q, 2, coords);
+        displs[q] = 0;
+        send_types[q] = recv_types[q] = MPI_CHAR;
+        send_counts[q] = (row_send[coords[0]] > 0 && col_send[coords[1]] > 0);
+        recv_counts[q] = (row_recv[coords[0]] > 0 && col_recv[coords[1]] > 0);
+        if (send_counts[q]){
+            sizes[0] = old->nrows + 2*g;
+            sizes[1] = old->stride;
+            subsizes[0] = row_send[coords[0]];
+            subsizes[1] = col_send[coords[1]];
+            starts[0] = g + row_send_displs[coords[0]];
+            starts[1] = g + col_send_displs[coords[1]];
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &send_types[q]);
+            MPI_Type_commit(&send_types[q]);
+        }
+        if (recv_counts[q]){
+            sizes[0] = d->nrows + 2*g;
+            sizes[1] = d->stride;
+            subsizes[0] = row_recv[coords[0]];
+            subsizes[1] = col_recv[coords[1]];
+            starts[0] = g + row_recv_displs[coords[0]];
+            starts[1] = g + col_recv_displs[coords[1]];
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &recv_types[q]);
+            MPI_Type_commit(&recv_types[q]);
         }
-        num_iterations--;
     }
+    for(i=0; i<2; i++)
+        MPI_Alltoallw(old_buffers[i], send_counts, displs, send_types, buffers[i], recv_counts, displs,
+                      recv_types, d->cart);
+    for(q=0; q<num_procs; q++){
+        if (send_counts[q]) MPI_Type_free(&send_types[q]);
+        if (recv_counts[q]) MPI_Type_free(&recv_types[q]);
+    }
+}
+
+/**
+ * Dynamic load balancing, called by worker 0 between two halo exchanges:
+ * every process tells the others the time its workers spent computing
+ * since the blocks last moved (every window half as much as the next one,
+ * so that one noisy window does not move them), and if the slowest one
+ * took BALANCE_THRESHOLD times the mean and evening them out saves more
+ * than the last move took (see balance_worth), the boundaries between the
+ * rows and between the columns of processes move so that they all take the
+ * same time (see balance_split, the load of a row of processes being the
+ * sum of theirs). Both buffers move to the new blocks, since the tiles that
+ * are skipped rely on the generation before, and the active map starts
+ * again with all its tiles changed: the two generations after a move
+ * compute every tile, so they are left out of the loads, which start again.
+ * With the bit-sliced kernel the block after the given number of
+ * generations moves in its buffer, and the grids are made again from it.
+ * A checkpoint in flight is finished first. imbalance gets the measured
+ * one. Returns 1 if the blocks moved, 0 if they did not and -1 if there was
+ * not enough memory (on every process), in which case nothing changes
+ * */
+int rebalance(simulation* sim, int generation, double* imbalance){
+    decomposition *d = sim->d, old;
+    int rows = d->dims[0], cols = d->dims[1], num_procs = rows * cols, q, i, coords[2], status = 0, moved;
+    int *counts[4], *work = NULL;
+    double busy = 0, slowest = 0, start, *loads;
+    char* buffers[2] = {NULL, NULL};
+    MPI_Datatype* types = NULL;
+    active_map active = {.rows = 0};
+    bitsliced_grid grids[2] = {{0, 0, 0, NULL}, {0, 0, 0, NULL}};
+
+    for(i=0; i<sim->num_workers; i++){
+        busy += sim->loads[i].seconds;
+        sim->loads[i].seconds /= 2;
+    }
+    //new row counts and displacements, and column counts and displacements
+    loads = (double*) calloc (sizeof(double), num_procs + rows + cols);
+    for(i=0; i<4; i++){
+        counts[i] = (int*) calloc (sizeof(int), (i < 2) ? rows : cols);
+        if (!counts[i]) status = -1;
+    }
+    if (!loads) status = -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, d->cart);
+    if (status != 0){
+        free(loads);
+        for(i=0; i<4; i++) free(counts[i]);
+        return -1;
+    }
+
+    //rows and columns of processes are as slow as the sum of their processes
+    MPI_Allgather(&busy, 1, MPI_DOUBLE, loads, 1, MPI_DOUBLE, d->cart);
+    for(q=0; q<num_procs; q++){
+        MPI_Cart_coords(d->cart, q, 2, coords);
+        loads[num_procs + coords[0]] += loads[q];
+        loads[num_procs + rows + coords[1]] += loads[q];
+    }
+    for(q=0; q<num_procs; q++)
+        if (loads[q] > slowest) slowest = loads[q];
+    *imbalance = balance_imbalance(loads, num_procs);
+    moved = balance_split(sim->tam, rows, d->ghost, loads + num_procs, d->row_counts, d->row_displs,
+                          counts[0], counts[1]);
+    moved |= balance_split(sim->tam, cols, d->ghost, loads + num_procs + rows, d->col_counts, d->col_displs,
+                           counts[2], counts[3]);
+    free(loads);
+    //the loads add up the seconds of the workers of a process
+    if (!balance_worth(*imbalance, slowest / sim->num_workers, sim->move_seconds) || !moved){
+        for(i=0; i<4; i++) free(counts[i]);
+        return 0;
+    }
+
+    //everything that the new blocks need is allocated before anything changes
+    start = MPI_Wtime();
+    old = *d;
+    d->row_counts = counts[0];
+    d->row_displs = counts[1];
+    d->col_counts = counts[2];
+    d->col_displs = counts[3];
+    for(i=0; i<2; i++){
+        buffers[i] = (char*) calloc (sizeof(char), (size_t)(d->row_counts[d->coords[0]] + 2*d->ghost)
+                                                   * (d->col_counts[d->coords[1]] + 2*d->ghost));
+        if (!buffers[i]) status = -1;
+    }
+    work = (int*) calloc (sizeof(int), 4 * (size_t)(rows + cols + num_procs));
+    types = (MPI_Datatype*) calloc (sizeof(MPI_Datatype), 2 * (size_t)num_procs);
+    for(i=0; i<2 && sim->brule; i++)
+        if (block_grid_create(&grids[i], d->row_counts[d->coords[0]], d->col_counts[d->coords[1]], d->ghost) != 0)
+            status = -1;
+    if (!work || !types || status != 0
+        || block_active_create(&active, d->row_counts[d->coords[0]], d->col_counts[d->coords[1]],
+                               sim->brule ? &grids[0] : NULL) != 0)
+        status = -1;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, d->cart);
+    if (status != 0){
+        *d = old;
+        active_map_destroy(&active);
+        bitsliced_grid_destroy(&grids[0]);
+        bitsliced_grid_destroy(&grids[1]);
+        free(buffers[0]);
+        free(buffers[1]);
+        free(work);
+        free(types);
+        for(i=0; i<4; i++) free(counts[i]);
+        return -1;
+    }
+
+    //the checkpoint in flight and the halo requests belong to the old blocks
+    state_output_progress(&sim->checkpoint, &old, 1);
+    state_output_destroy(&sim->checkpoint, &old);
+    for(i=0; i<2; i++)
+        for(q=0; q<NUM_HALO_REQUESTS; q++) MPI_Request_free(&d->requests[i][q]);
+
+    //the tiles that are skipped rely on the generation before in the grids too
+    simulation_block(sim, generation);
+    if (sim->brule)
+        block_grid_unpack(&sim->grids[1 - generation % 2], &old, sim->buffers[1 - generation % 2], old.ghost,
+                          old.nrows + old.ghost, old.ghost, old.ncols + old.ghost);
+    decomposition_layout(d);
+    migrate_blocks(&old, sim->buffers, d, buffers, work, types);
+    for(i=0; i<2; i++){
+        free(sim->buffers[i]);
+        sim->buffers[i] = buffers[i];
+        bitsliced_grid_destroy(&sim->grids[i]);
+        sim->grids[i] = grids[i];
+        if (sim->brule)
+            block_grid_pack(&sim->grids[i], d, sim->buffers[i], d->ghost, d->nrows + d->ghost,
+                            d->ghost, d->ncols + d->ghost);
+    }
+    halo_requests_init(d, sim->buffers);
+    active_map_destroy(&sim->active);
+    sim->active = active;
+
+    free(old.row_counts);
+    free(old.row_displs);
+    free(old.col_counts);
+    free(old.col_displs);
+    free(work);
+    free(types);
+    sim->settled = generation + 2;
+    for(i=0; i<sim->num_workers; i++) sim->loads[i].seconds = 0;
+    sim->move_seconds = MPI_Wtime() - start;
+    MPI_Allreduce(MPI_IN_PLACE, &sim->move_seconds, 1, MPI_DOUBLE, MPI_MAX, d->cart);
+
+    if (state_output_create(&sim->checkpoint, d, sim->tam) != 0){
+        if (sim->current_id == 0) fprintf(stderr, "Not enough memory for the checkpoints, no more are written\n");
+        sim->checkpoint_every = 0;
+        sim->checkpoint_seconds = 0;
+    }
+    return 1;
+}
+
+/**
+ * Gathers the matrix after the given number of generations to print it,
+ * and/or writes it collectively to a snapshot file. Checkpoints are written
+ * in the background: the one in flight moves forward here, and a new one
+ * starts when it is due, after the previous one has finished. Every
+ * balance_every generations the blocks may change size, when the halo is
+ * about to be exchanged (timed as scatter)
+ * */
+void simulation_publish(void* state, int generation){
+    simulation* sim = (simulation*) state;
+    int iteration = sim->resumed + generation, due = 0, moved;
+    char path[MAX_CHAR], title[OUTPUT_TITLE];
+    double since, imbalance;
+
+    if (sim->balance_every > 0 && generation % sim->d->ghost == 0
+        && generation - sim->balanced >= sim->balance_every){
+        since = trace_now(sim->trace);
+        moved = rebalance(sim, generation, &imbalance);
+        if (moved < 0 && sim->current_id == 0) fprintf(stderr, "Not enough memory to move the blocks\n");
+        if (moved > 0 && sim->trace->enabled && sim->current_id == 0)
+            fprintf(stderr, "BALANCE generation=%d imbalance=%.3f\n", iteration, imbalance);
+        //after a move the next window starts when the loads count again
+        sim->balanced = (moved > 0) ? sim->settled : generation;
+        trace_mark(sim->trace, 0, TRACE_SCATTER, iteration, &since);
+    }
+
+    if (sim->output_every > 0 && iteration % sim->output_every == 0){
+        snprintf(title, sizeof title, "---> IT %d\nRESULT MATRIX:\n", sim->num_iterations - iteration + 1);
+        queue_matrix(sim->d, sim->output, simulation_block(sim, generation), sim->tam, title, sim->trace,
+                     iteration);
+    }
+    since = trace_now(sim->trace);
+    if (sim->snapshot_every > 0 && iteration % sim->snapshot_every == 0){
+        snprintf(path, sizeof path, "snapshot_%llu.state",
+                 (unsigned long long)(sim->first_generation + generation));
+        write_state_snapshot(sim->d, simulation_block(sim, generation), sim->tam, path,
+                             sim->first_generation + generation, sim->rule);
+        trace_mark(sim->trace, 0, TRACE_IO, iteration, &since);
+    }
+
+    if (sim->checkpoint_every == 0 && sim->checkpoint_seconds == 0) return;
+    state_output_progress(&sim->checkpoint, sim->d, 0);
+    if (sim->checkpoint_every > 0 && iteration % sim->checkpoint_every == 0) due = 1;
+    if (sim->checkpoint_seconds > 0){
+        //only rank 0 looks at the clock, so that all the processes agree
+        if (sim->current_id == 0 && MPI_Wtime() - sim->last_checkpoint >= sim->checkpoint_seconds) due = 1;
+        MPI_Bcast(&due, 1, MPI_INT, 0, sim->d->cart);
+    }
+    if (due){
+        state_output_progress(&sim->checkpoint, sim->d, 1);
+        state_output_start(&sim->checkpoint, sim->d, simulation_block(sim, generation), CHECKPOINT_TMP,
+                           CHECKPOINT, CHECKPOINT_PREVIOUS, sim->first_generation + generation, sim->rule);
+        sim->last_checkpoint = MPI_Wtime();
+    }
+    trace_mark(sim->trace, 0, TRACE_IO, iteration, &since);
+}
 
-    /*
-    double timedif = (double)(clock() - start)/CLOCKS_PER_SEC;
-    if(current_id == 0)
-        fprintf(results, "%d %d %f\n", tam*tam, num_procs, timedif);
-    */
-   
+/**
+ * Greatest common divisor, 0 being divisible by anything
+ * */
+int gcd(int a, int b){
+    return (b == 0) ? a : gcd(b, a % b);
+}
+
+/**
+ * Reads the tam x tam matrix of a text configuration, whose size line has
+ * already been read, into matrix. Returns 0 on success and -1 otherwise
+ * */
+int read_text_matrix(FILE* initial_configuration, char* matrix, int tam){
+    int i, j;
+    char char_act;
 
     for(i=0; i<tam; i++){
-        free(matrix[i]);
-        free(result_matrix[i]);
-        free(scattered_matrix[i]);
-        free(scattered_result[i]);
+        for(j=0; j<tam; j++){
+            do{
+                char_act = fgetc(initial_configuration);
+            } while (char_act != '0' && char_act != '1' && char_act != EOF);
+            
+            if (char_act == EOF){
+                fprintf(stderr, "Matrix contains non-boolean value\n");
+                return -1;
+            }
+            matrix[(size_t)i*tam + j] = char_act;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decodes the block of the calling process from the RLE pattern, whose
+ * header has already been read: the rows above the block are parsed
+ * without being expanded, and the runs of its rows are clipped to its
+ * columns. Returns 0 on success and -1 otherwise
+ * */
+int read_rle_block(const decomposition* d, rle_reader* reader, char* block){
+    int i;
+
+    if (rle_skip_rows(reader, d->row_displs[d->coords[0]]) != 0) return -1;
+    for(i=0; i<d->nrows; i++){
+        if (rle_read_row(reader, d->col_displs[d->coords[1]], d->ncols,
+                         block + (size_t)(d->ghost + i) * d->stride + d->ghost) != 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * Generates the block of the calling process, row by row, without the
+ * rest of the matrix
+ * */
+void generate_block(const decomposition* d, const generator* gen, char* block){
+    int i;
+
+    for(i=0; i<d->nrows; i++)
+        generator_fill(gen, d->row_displs[d->coords[0]] + i, d->col_displs[d->coords[1]], d->ncols,
+                       block + (size_t)(d->ghost + i) * d->stride + d->ghost);
+}
+
+/**
+ * Fills the blocks with the latest valid checkpoint, trying the previous
+ * one if the last is missing or damaged. On success stored gets its rule
+ * and generation its generation. Returns 0 on success and -1 otherwise
+ * */
+int restart(const decomposition* d, int tam, char* block, rule_table* stored, uint64_t* generation){
+    const char* paths[2] = {CHECKPOINT, CHECKPOINT_PREVIOUS};
+    int i, current_id;
+
+    MPI_Comm_rank(d->cart, &current_id);
+    for(i=0; i<2; i++){
+        if (read_checkpoint(d, paths[i], tam, block, stored, generation) == 0){
+            if (current_id == 0) fprintf(stderr, "Resuming from %s, generation %llu\n", paths[i],
+                                         (unsigned long long)*generation);
+            return 0;
+        }
+    }
+    if (current_id == 0) fprintf(stderr, "No valid checkpoint, starting from the initial configuration\n");
+    return -1;
+}
+
+
+int main(int argc, char *argv[]) {
+    char* matrix = NULL;
+    char *buffers[2] = {NULL, NULL};
+    worker_load* loads = NULL;
+    FILE * initial_configuration = NULL;
+    FILE * transformation_function = NULL;
+    int num_iterations=-1, tam = -1, output_every = 1, snapshot_every = 0, checkpoint_every = 0;
+    int ghost = 1, num_workers = 1, provided, resume = 0, restarted = 0, printing = 0, bench = 0;
+    int current_id, num_procs, option, status = 0, binary = 0, pattern = 0, profile = 0, balance_every = 0;
+    int from_file;
+    double checkpoint_seconds = 0, start, elapsed, setup, since;
+    size_t block_size;
+    char size[MAX_CHAR], engine[MAX_CHAR];
+    const char* trace_prefix = NULL;
+    rule_table rule, stored = {0, 0, NULL};
+    bitsliced_rule brule;
+    output_pipeline output;
+    output_format format = OUTPUT_TEXT;
+    rle_reader reader;
+    generator gen;
+    state_header header;
+    uint64_t generation = 0, checksum;
+    MPI_File state_file;
+    simulation sim;
+    worker_job job;
+    trace_log trace;
+    decomposition d = {.row_type = MPI_DATATYPE_NULL, .col_type = MPI_DATATYPE_NULL,
+                       .corner_type = MPI_DATATYPE_NULL, .block_type = MPI_DATATYPE_NULL};
+
+
+    //Argument check
+    while((option = getopt(argc, argv, "o:f:s:c:T:Rk:L:t:BPJ:")) != -1){
+        if (option == 'o') output_every = atoi(optarg);
+        else if (option == 'f') status = output_format_parse(optarg, &format);
+        else if (option == 's') snapshot_every = atoi(optarg);
+        else if (option == 'c') checkpoint_every = atoi(optarg);
+        else if (option == 'T') checkpoint_seconds = atof(optarg);
+        else if (option == 'R') resume = 1;
+        else if (option == 'k') ghost = atoi(optarg);
+        else if (option == 'L') balance_every = atoi(optarg);
+        else if (option == 't') num_workers = atoi(optarg);
+        else if (option == 'B') bench = 1;
+        else if (option == 'P') profile = 1;
+        else if (option == 'J'){
+            profile = 1;
+            trace_prefix = optarg;
+        }
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 3 || output_every < 0 || snapshot_every < 0 || checkpoint_every < 0
+        || checkpoint_seconds < 0 || ghost < 1 || num_workers < 1 || balance_every < 0){
+        fprintf(stderr, "Invalid arguments. Try ./Cellular2D-Parallel [-o output_every] [-f format] "
+                        "[-s snapshot_every] [-c checkpoint_every] [-T checkpoint_seconds] [-R] [-k ghost_depth] [-L balance_every] [-t threads] [-B] [-P] [-J trace] "
+                        "initial_configuration transformation_function num_iterations\n"
+                        "  -o N  print the matrix every N generations (default 1, 0 = never)\n"
+                        "  -f F  format of the printed matrix: text (default) or rle\n"
+                        "  -s N  write the matrix to snapshot_<generation>.state every N generations "
+                        "(default 0 = never)\n"
+                        "  -c N  write a checkpoint to " CHECKPOINT " every N generations (default 0 = never)\n"
+                        "  -T S  write a checkpoint every S seconds (default 0 = never)\n"
+                        "  -R    resume from the latest valid checkpoint, with any number of processes\n"
+                        "  -k K  exchange K rows/columns of ghost cells every K generations (default 1)\n"
+                        "  -L N  measure the time every process spends computing every N generations, and\n"
+                        "        move the boundaries of the blocks if the slowest one takes %d%% longer\n"
+                        "        than the mean (default 0 = never)\n"
+                        "  -t N  threads per process, only the main one calls MPI (default 1)\n"
+                        "  -B    report the wall time of the generations on stderr (see benchmark.sh)\n"
+                        "  -P    report on stderr the time of every phase (scatter, halo, compute, gather,\n"
+                        "        print, io) in the fastest, mean and slowest process\n"
+                        "  -J F  like -P, and write the phases of every generation of rank R to F_R.json,\n"
+                        "        a trace for chrome://tracing or Perfetto\n"
+                        "The initial configuration can be a text file, an RLE pattern or a binary state file,\n"
+                        "or be generated by every process for its own block with random:N[:density[:seed]],\n"
+                        "seed:N or tile:N:rows (see generator.h)\n",
+                (int) (BALANCE_THRESHOLD * 100 + 0.5) - 100);
+        return EXIT_FAILURE;
+    }
+
+    num_iterations = atoi(argv[optind+2]);
+    if (num_iterations<1){
+        fprintf(stderr, "Non-valid number of iterations\n");
+        return EXIT_FAILURE;
+    }
+    from_file = generator_parse(&gen, argv[optind], 2);
+    if (from_file < 0) return EXIT_FAILURE;
+    
+    //the threads of a process share its block; all the messages go through the main one
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &current_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    if (num_workers > 1 && provided < MPI_THREAD_FUNNELED){
+        if (current_id == 0) fprintf(stderr, "The MPI library does not support threads, using 1 per process\n");
+        num_workers = 1;
+    }
+    //the reading of the configuration is timed from the same moment in every process
+    if (profile) MPI_Barrier(MPI_COMM_WORLD);
+    setup = MPI_Wtime();
+
+    if (from_file) initial_configuration = fopen (argv[optind], "r");
+    transformation_function = fopen(argv[optind+1], "r");
+    if ((from_file && !initial_configuration) || !transformation_function){
+        fprintf(stderr, "Unable to read specified files\n");
+        generator_destroy(&gen);
+        if (initial_configuration) fclose(initial_configuration);
+        if (transformation_function) fclose(transformation_function);
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    //the transformation function is read only once, as a lookup table
+    if (rule_table_load(&rule, transformation_function, RULE_2D_INPUTS) != 0){
+        generator_destroy(&gen);
+        if (initial_configuration) fclose(initial_configuration);
+        fclose(transformation_function);
+        MPI_Finalize();
+        return EXIT_FAILURE;
     }
-    free(matrix);
-    free(result_matrix);
-    free(scattered_matrix);
-    free(scattered_result);
-    free(sendcounts);
-    free(displacements);
-    free(first_vector);
-    free(last_vector);
     fclose(transformation_function);
-    fclose(initial_configuration);
+
+    /**
+     * every process reads its own block of a binary state file with
+     * MPI-IO, and decodes its own block of an RLE pattern (placed at the
+     * top left corner of a square as large as its longest side); a text
+     * configuration is read by rank 0 and sent to the others, and a
+     * generated one is made by every process for its own block
+     * */
+    if (!from_file) tam = gen.tam;
+    else if ((binary = state_is_binary(initial_configuration))){
+        if (state_open_all(argv[optind], &state_file, &header, NULL) != 0){
+            rule_table_destroy(&rule);
+            fclose(initial_configuration);
+            MPI_Finalize();
+            return EXIT_FAILURE;
+        }
+        if (current_id == 0 && header.rule_id != 0 && header.rule_id != state_rule_id(&rule))
+            fprintf(stderr, "Warning: %s was saved with another transformation function\n", argv[optind]);
+        tam = (header.rows == header.cols && header.cols <= INT_MAX) ? (int) header.cols : -1;
+    } else if ((pattern = rle_is_rle(initial_configuration))){
+        tam = -1;
+        if (rle_reader_open(&reader, initial_configuration, argv[optind]) == 0)
+            tam = (reader.width > INT_MAX || reader.height > INT_MAX) ? -1
+                  : (int) ((reader.width > reader.height) ? reader.width : reader.height);
+    } else {
+        fgets(size, MAX_CHAR, initial_configuration);
+        tam = atoi(size);
+    }
+    if (tam<1){
+        fprintf(stderr, "Matrix size not valid\n");
+        if (binary) MPI_File_close(&state_file);
+        rule_table_destroy(&rule);
+        generator_destroy(&gen);
+        if (initial_configuration) fclose(initial_configuration);
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    //every process gets a block of the matrix, with a border of ghost cells
+    if (decomposition_create(&d, tam, num_procs, ghost) != 0){
+        if (current_id == 0) fprintf(stderr, "Matrix too small for %d processes with ghost depth %d\n",
+                                     num_procs, ghost);
+        status = -1;
+    } else {
+        block_size = (size_t)(d.nrows + 2*d.ghost) * d.stride;
+        buffers[0] = (char*) calloc (sizeof(char), block_size);
+        buffers[1] = (char*) calloc (sizeof(char), block_size);
+        loads = (worker_load*) calloc (sizeof(worker_load), num_workers);
+        //tiles of the block that did not change lately are not computed again
+        if (!buffers[0] || !buffers[1] || !loads
+            || block_active_create(&sim.active, d.nrows, d.ncols, NULL) != 0){
+            fprintf(stderr, "Not enough memory for the block\n");
+            status = -1;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (status != 0){
+        if (binary) MPI_File_close(&state_file);
+        rule_table_destroy(&rule);
+        generator_destroy(&gen);
+        if (initial_configuration) fclose(initial_configuration);
+        free(buffers[0]);
+        free(buffers[1]);
+        free(loads);
+        decomposition_destroy(&d);
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    halo_requests_init(&d, buffers);
+
+    //a checkpoint brings its own rule, which replaces the given one
+    if (resume && restart(&d, tam, buffers[0], &stored, &generation) == 0){
+        restarted = 1;
+        if (current_id == 0 && stored.num_inputs == rule.num_inputs
+            && memcmp(stored.outputs, rule.outputs, rule.num_entries) != 0)
+            fprintf(stderr, "Warning: the checkpoint was saved with another transformation function\n");
+        rule_table_destroy(&rule);
+        rule = stored;
+    }
+
+    //---------------------boss process: reads input matrix from file
+    //(the whole matrix is only kept in rank 0 while a text file is read)
+    if(current_id == 0 && from_file && !binary && !pattern && !restarted){
+        matrix = (char *) calloc ((size_t)tam*tam, sizeof(char));
+        if (!matrix){
+            fprintf(stderr, "Not enough memory for the matrix\n");
+            status = -1;
+        } else status = read_text_matrix(initial_configuration, matrix, tam);
+    }
+
+    //rank 0 prints the matrix from a thread of its own, while the generations go on
+    if (current_id == 0 && output_every > 0){
+        if (output_open(&output, stdout, format, "01", OUTPUT_FRAMES, (size_t)tam * tam) == 0) printing = 1;
+        else {
+            fprintf(stderr, "Not enough memory for the output queue\n");
+            status = -1;
+        }
+    }
+    if (binary && !restarted){
+        if (read_state_block(&d, state_file, &header, buffers[0], &checksum) != 0) status = -1;
+        MPI_Allreduce(MPI_IN_PLACE, &checksum, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (status != 0){
+            if (current_id == 0) fprintf(stderr, "%s: could not be read\n", argv[optind]);
+        } else if (header.checksum != 0 && state_checksum_fold(checksum) != header.checksum){
+            if (current_id == 0) fprintf(stderr, "%s: checksum mismatch\n", argv[optind]);
+            status = -1;
+        }
+    }
+    if (pattern && !restarted && read_rle_block(&d, &reader, buffers[0]) != 0) status = -1;
+    if (!from_file && !restarted) generate_block(&d, &gen, buffers[0]);
+    if (binary) MPI_File_close(&state_file);
+    generator_destroy(&gen);
+    if (initial_configuration) fclose(initial_configuration);
+    //----------------------------------------------------------------
+
+    /**
+     * outer-totalistic rules (like the Game of Life) are computed with the
+     * bit-sliced kernel, 64 cells per word, on a copy of the block stored one
+     * bit per cell. Any other rule is looked up cell by cell in the table
+     * */
+    sim.brule = NULL;
+    sim.grids[0] = sim.grids[1] = (bitsliced_grid){0, 0, 0, NULL};
+    if (bitsliced_rule_init(&brule, &rule) == 0){
+        sim.brule = &brule;
+        //the tiles of the active map are made of words instead
+        active_map_destroy(&sim.active);
+        if (block_grid_create(&sim.grids[0], d.nrows, d.ncols, ghost) != 0
+            || block_grid_create(&sim.grids[1], d.nrows, d.ncols, ghost) != 0
+            || block_active_create(&sim.active, d.nrows, d.ncols, &sim.grids[0]) != 0){
+            fprintf(stderr, "Not enough memory for the bit-sliced grids\n");
+            status = -1;
+        }
+    }
+
+    //every process stops if the matrix could not be read
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (state_output_create(&sim.checkpoint, &d, tam) != 0 && status == 0){
+        if (current_id == 0) fprintf(stderr, "Not enough memory for the checkpoints\n");
+        status = -1;
+    }
+    if (status != 0){
+        if (printing) output_close(&output);
+        state_output_destroy(&sim.checkpoint, &d);
+        active_map_destroy(&sim.active);
+        bitsliced_grid_destroy(&sim.grids[0]);
+        bitsliced_grid_destroy(&sim.grids[1]);
+        rule_table_destroy(&rule);
+        free(matrix);
+        free(buffers[0]);
+        free(buffers[1]);
+        free(loads);
+        decomposition_destroy(&d);
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    /**
+     * the blocks stay in their processes for the whole run: only the halos
+     * travel every generation, and the matrix is gathered just to print it
+     * */
+    if (from_file && !binary && !pattern && !restarted) transfer_blocks(&d, matrix, buffers[0], tam, 0);
+    free(matrix);
+    if (sim.brule) block_grid_pack(&sim.grids[0], &d, buffers[0], ghost, d.nrows + ghost, ghost, d.ncols + ghost);
+    sim.unpacked = 0;
+    trace_open(&trace, profile, trace_prefix, num_workers, setup, MPI_COMM_WORLD);
+    trace_add(&trace, 0, TRACE_SCATTER, 0, setup, trace_now(&trace));
+
+    //print initial input (for debugging purposes)
+    if (output_every > 0 && !restarted)
+        queue_matrix(&d, printing ? &output : NULL, buffers[0], tam, "MOTHER MATRIX:\n", &trace, 0);
+
+    /**
+     * generations are counted from the initial configuration, also when
+     * resuming: the run ends and prints at the same generations as the
+     * one that wrote the checkpoint
+     * */
+    sim.first_generation = binary ? header.generation : 0;
+    sim.resumed = 0;
+    if (restarted){
+        if (generation < sim.first_generation) sim.resumed = 0;
+        else if (generation > sim.first_generation + num_iterations) sim.resumed = num_iterations;
+        else sim.resumed = (int)(generation - sim.first_generation);
+        sim.first_generation = generation;
+    }
+    sim.rule = &rule;
+    sim.d = &d;
+    sim.buffers[0] = buffers[0];
+    sim.buffers[1] = buffers[1];
+    sim.output = printing ? &output : NULL;
+    sim.tam = tam;
+    sim.num_iterations = num_iterations;
+    sim.current_id = current_id;
+    sim.output_every = output_every;
+    sim.snapshot_every = snapshot_every;
+    sim.checkpoint_every = checkpoint_every;
+    sim.checkpoint_seconds = checkpoint_seconds;
+    sim.last_checkpoint = MPI_Wtime();
+    sim.trace = &trace;
+    sim.loads = loads;
+    sim.num_workers = num_workers;
+    sim.balance_every = balance_every;
+    sim.balanced = 0;
+    sim.settled = 0;
+    sim.move_seconds = 0;
+    job.num_workers = num_workers;
+    job.num_generations = num_iterations - sim.resumed;
+    //publish on every generation of the original count that has something to do
+    job.publish_every = gcd(gcd(gcd(output_every, snapshot_every), checkpoint_every), sim.resumed);
+    //a checkpoint in flight moves forward at least once per halo exchange
+    if (checkpoint_every > 0 || checkpoint_seconds > 0) job.publish_every = gcd(job.publish_every, ghost);
+    //the blocks can only change size when the halo is about to be exchanged
+    if (balance_every > 0) job.publish_every = gcd(job.publish_every, gcd(balance_every, ghost));
+    job.step = simulation_step;
+    job.publish = simulation_publish;
+    job.state = &sim;
+    MPI_Barrier(MPI_COMM_WORLD);
+    start = MPI_Wtime();
+    workers_run(&job);
+    since = trace_now(&trace);
+    state_output_progress(&sim.checkpoint, &d, 1);
+    trace_mark(&trace, 0, TRACE_IO, num_iterations, &since);
+    if (printing && output_close(&output) != 0) fprintf(stderr, "The output could not be written\n");
+    if (printing) trace_mark(&trace, 0, TRACE_PRINT, num_iterations, &since);
+
+    //the run takes as long as its slowest process
+    elapsed = MPI_Wtime() - start;
+    MPI_Reduce(current_id == 0 ? MPI_IN_PLACE : &elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    snprintf(engine, sizeof engine, "Cellular2D-Parallel/%s", sim.brule ? "bitsliced" : "table");
+    if (bench && current_id == 0)
+        bench_report(engine, (unsigned long long)tam * tam, num_iterations - sim.resumed,
+                     num_procs, num_workers, elapsed);
+    trace_close(&trace, num_iterations - sim.resumed, MPI_COMM_WORLD);
+
+    //the buffers of the blocks are replaced when they change size
+    free(sim.buffers[0]);
+    free(sim.buffers[1]);
+    free(loads);
+    bitsliced_grid_destroy(&sim.grids[0]);
+    bitsliced_grid_destroy(&sim.grids[1]);
+    state_output_destroy(&sim.checkpoint, &d);
+    active_map_destroy(&sim.active);
+    rule_table_destroy(&rule);
+    decomposition_destroy(&d);
     MPI_Finalize();  
 
     return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,132 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+#include "active.h"
+
+/**
+ * Creates a map of rows x cols tiles, all of them marked as changed so that
+ * the first generation is computed everywhere, whichever generation that
+ * is (a map can be made again when the block changes size).
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int active_map_create(active_map* map, int rows, int cols){
+    size_t tiles = (size_t)rows * cols;
+
+    map->rows = rows;
+    map->cols = cols;
+    map->changed[0] = (unsigned char*) malloc (tiles);
+    map->changed[1] = (unsigned char*) malloc (tiles);
+    map->border[0] = (unsigned char*) calloc (sizeof(unsigned char), tiles);
+    map->border[1] = (unsigned char*) calloc (sizeof(unsigned char), tiles);
+    map->halo = (unsigned char*) malloc (tiles);
+    if (!map->changed[0] || !map->changed[1] || !map->border[0] || !map->border[1] ||
+        !map->halo){
+        active_map_destroy(map);
+        return -1;
+    }
+    memset(map->changed[0], 1, tiles);
+    memset(map->changed[1], 1, tiles);
+    memset(map->halo, 3, tiles);
+    return 0;
+}
+
+void active_map_destroy(active_map* map){
+    if (map->changed[0]) free(map->changed[0]);
+    if (map->changed[1]) free(map->changed[1]);
+    if (map->border[0]) free(map->border[0]);
+    if (map->border[1]) free(map->border[1]);
+    if (map->halo) free(map->halo);
+    map->changed[0] = map->changed[1] = NULL;
+    map->border[0] = map->border[1] = NULL;
+    map->halo = NULL;
+}
+
+/**
+ * Returns 1 if the cells of tile (r, c) that only see cells of the block
+ * have to be computed in the step that goes from the given generation to
+ * the next one, and 0 if they are going to be the same as in the
+ * generation before
+ * */
+int active_tile_needed(const active_map* map, int generation, int r, int c){
+    const unsigned char* changed = map->changed[generation % 2];
+    const unsigned char* border = map->border[generation % 2];
+    int row, col;
+    size_t tile;
+
+    for(row=(r > 0 ? r-1 : 0); row<=r+1 && row<map->rows; row++){
+        for(col=(c > 0 ? c-1 : 0); col<=c+1 && col<map->cols; col++){
+            tile = (size_t)row * map->cols + col;
+            if (changed[tile] || border[tile]) return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Records whether tile (r, c) of the generation after the given one is
+ * different from the generation before it. The first generation computed
+ * has nothing to be compared with, so all its tiles count as changed
+ * */
+void active_tile_set(active_map* map, int generation, int r, int c, int changed){
+    map->changed[1 - generation % 2][(size_t)r * map->cols + c] = (unsigned char) (changed || generation == 0);
+}
+
+/**
+ * Records whether the cells of tile (r, c) next to the ghost cells
+ * changed, like active_tile_set
+ * */
+void active_border_set(active_map* map, int generation, int r, int c, int changed){
+    map->border[1 - generation % 2][(size_t)r * map->cols + c] = (unsigned char) (changed || generation == 0);
+}
+
+/**
+ * Records whether the ghost cells around tile (r, c) are different from
+ * the generation before, once per step. The cells of the tile next to them
+ * can only be skipped once the ghost cells stayed the same for two
+ * generations, which is what the cells they hold in the other buffer were
+ * computed from. The ghost cells of the generation before are unknown when
+ * the map is made, so a new map waits for one more generation
+ * */
+void active_halo_set(active_map* map, int r, int c, int changed){
+    unsigned char* halo = map->halo + (size_t)r * map->cols + c;
+
+    if (changed) *halo = 2;
+    else if (*halo > 0) (*halo)--;
+}
+
+/**
+ * Returns 1 if the cells of tile (r, c) next to the ghost cells have to be
+ * computed in this step because of the ghost cells
+ * */
+int active_halo_needed(const active_map* map, int r, int c){
+    return map->halo[(size_t)r * map->cols + c] > 0;
+}
+
+/**
+ * Returns 1 if any cell of tile (r, c) of the given generation, those next
+ * to the ghost cells included, is different from two generations before
+ * */
+int active_tile_changed(const active_map* map, int generation, int r, int c){
+    size_t tile = (size_t)r * map->cols + c;
+
+    return map->changed[generation % 2][tile] || map->border[generation % 2][tile];
+}
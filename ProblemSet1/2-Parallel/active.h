@@ -0,0 +1,55 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef ACTIVE_H
+#define ACTIVE_H
+
+/**
+ * Grid of rows x cols tiles of a block that remembers which tiles are
+ * different from what they were two generations before. If neither a tile
+ * nor any of its neighbors inside the block changed, the cells of the tile
+ * that only see cells of the block are going to be what they were the
+ * generation before, which is already in the buffer they are written to.
+ * Still lifes and period 2 oscillators, which make most of the ash of the
+ * Game of Life, are skipped that way. changed[g%2] tells the tiles that
+ * changed to reach generation g, and the step that computes generation g+1
+ * fills changed[1-g%2]. The cells next to the ghost cells are computed
+ * apart, maybe by another thread, so their changes are kept in border.
+ * Those cells also see the ghost cells, and halo counts how many more steps
+ * each tile has to be computed because its ghost cells changed.
+ * Several threads can fill the flags of different tiles at the same time
+ * */
+typedef struct {
+    int rows, cols;
+    unsigned char* changed[2];
+    unsigned char* border[2];
+    unsigned char* halo;
+} active_map;
+
+int active_map_create(active_map* map, int rows, int cols);
+void active_map_destroy(active_map* map);
+int active_tile_needed(const active_map* map, int generation, int r, int c);
+void active_tile_set(active_map* map, int generation, int r, int c, int changed);
+void active_border_set(active_map* map, int generation, int r, int c, int changed);
+int active_tile_changed(const active_map* map, int generation, int r, int c);
+void active_halo_set(active_map* map, int r, int c, int changed);
+int active_halo_needed(const active_map* map, int r, int c);
+
+#endif
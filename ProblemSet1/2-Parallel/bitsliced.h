@@ -0,0 +1,95 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef BITSLICED_H
+#define BITSLICED_H
+
+#include <stdint.h>
+#include "functions.h"
+
+#define WORD_BITS 64
+
+/**
+ * Outer-totalistic rule prepared for the bit-sliced kernel. Each term
+ * matches one neighbor count n: count_masks[b] is all ones if bit b of n
+ * is 1, and birth/survive are all ones if a 0/1 center cell with n
+ * neighbors becomes 1. Counts that never produce a 1 have no term
+ * */
+typedef struct {
+    uint64_t count_masks[4];
+    uint64_t birth;
+    uint64_t survive;
+} bitsliced_term;
+
+typedef struct {
+    int num_terms;
+    bitsliced_term terms[9];
+} bitsliced_rule;
+
+/**
+ * tam x tam torus stored one bit per cell. Every stored row has a ghost
+ * cell on each side (bit 0 holds the last cell of the row and bit tam+1
+ * the first one) and there is a ghost row above and below, so the kernel
+ * never has to compute a module. Row r of the matrix is stored row r+1,
+ * and its bits start at word 1: words 0 and row_words-1.. are zero pads
+ * that make the unaligned neighbor loads of the kernel safe. A band
+ * (bitsliced_band_create) stores its rows the same way, but holds only a
+ * range of rows of the matrix, without ghost rows
+ * */
+typedef struct {
+    int tam;
+    int data_words;  //words holding the tam+2 bits of a row
+    int row_words;   //distance between consecutive stored rows
+    uint64_t* words;
+} bitsliced_grid;
+
+int bitsliced_rule_init(bitsliced_rule* brule, const rule_table* table);
+
+int bitsliced_grid_create(bitsliced_grid* grid, int tam);
+int bitsliced_band_create(bitsliced_grid* grid, int tam, int rows);
+size_t bitsliced_row_bytes(int tam);
+void bitsliced_grid_destroy(bitsliced_grid* grid);
+void bitsliced_grid_set_row(bitsliced_grid* grid, int row, const char* cells);
+void bitsliced_grid_set_packed_row(bitsliced_grid* grid, int row, const uint64_t* packed);
+void bitsliced_grid_get_row(const bitsliced_grid* grid, int row, char* cells);
+void bitsliced_grid_get_packed_row(const bitsliced_grid* grid, int row, uint64_t* packed);
+void bitsliced_copy_rows(bitsliced_grid* dst, int dst_row, const bitsliced_grid* src, int src_row, int rows);
+void bitsliced_copy_cells(bitsliced_grid* dst, int dst_row, int dst_col, const bitsliced_grid* src, int src_row,
+                          int src_col, int count);
+void bitsliced_set_cells(bitsliced_grid* grid, int first_row, int last_row, int col, const char* cells,
+                         size_t stride, int count);
+void bitsliced_get_cells(const bitsliced_grid* grid, int first_row, int last_row, int col, char* cells,
+                         size_t stride, int count);
+int bitsliced_cells_differ(const bitsliced_grid* a, const bitsliced_grid* b, int first_row, int last_row, int col,
+                           int count);
+void bitsliced_refresh_cols(bitsliced_grid* grid, int first_row, int last_row);
+void bitsliced_refresh_rows(bitsliced_grid* grid, int first_row, int last_row);
+void bitsliced_refresh_border(bitsliced_grid* grid);
+void bitsliced_refresh_tile(bitsliced_grid* grid, int first_row, int last_row, int first_word, int last_word);
+
+void bitsliced_step_rows(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+                         int first_row, int last_row);
+void bitsliced_step(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out);
+int bitsliced_cell_words(const bitsliced_grid* grid);
+int bitsliced_step_tile(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+                        int first_row, int last_row, int first_word, int last_word);
+const char* bitsliced_kernel_name(void);
+
+#endif
@@ -19,8 +19,10 @@
  * */
 
 #include "functions.h"
+#include "state.h"
 
 #define N_GENERATIONS 9
+#define MAX_CHAR 1024
 
 void generate_gameoflife(){
     FILE* generate;
@@ -85,3 +87,146 @@ void generate_nxn(int n){
     fclose(file);
     free(line);
 }
+
+/**
+ * Same random n x n configuration as generate_nxn, written straight into
+ * the binary state file nxnconfig.state so that it can be loaded without
+ * being parsed
+ * */
+void generate_nxn_state(int n){
+    state_writer w;
+    int i, j;
+    char *line = (char*) calloc (sizeof(char), n);
+    if (!line || state_writer_open(&w, "nxnconfig.state", n, n, 0, NULL) != 0){
+        free(line);
+        return;
+    }
+    srand(time(NULL));
+    for(i=0; i<n; i++){
+        for(j=0; j<n; j++){
+            line[j] = rand()%2 + '0';
+        }
+        if (state_writer_put_row(&w, line) != 0) break;
+    }
+    state_writer_close(&w);
+    free(line);
+}
+
+
+/**
+ * Reads the whole transformation function file once and stores it in
+ * table. Every line must be "<num_inputs binary digits> <0|1>" and every
+ * possible neighborhood must appear, so that the engines never have to
+ * deal with missing entries inside their loops.
+ * Returns 0 on success and -1 if the file is not a complete function
+ * */
+int rule_table_load(rule_table* table, FILE* funct, int num_inputs){
+    char line[MAX_CHAR];
+    char *function_input = NULL, *function_output = NULL;
+    char* defined = NULL;
+    int i, index, line_number = 0;
+
+    table->num_inputs = num_inputs;
+    table->num_entries = 1 << num_inputs;
+    table->outputs = (char*) calloc (sizeof(char), table->num_entries);
+    defined = (char*) calloc (sizeof(char), table->num_entries);
+    if (!table->outputs || !defined){
+        fprintf(stderr, "Not enough memory for the transformation function\n");
+        free(defined);
+        rule_table_destroy(table);
+        return -1;
+    }
+
+    rewind(funct);
+    while(fgets(line, sizeof line, funct) != NULL){
+        line_number++;
+        function_input = strtok(line, " \t\r\n");
+        if (!function_input) continue; //blank line
+        function_output = strtok(NULL, " \t\r\n");
+
+        if ((int)strlen(function_input) != num_inputs || !function_output
+                || (function_output[0] != '0' && function_output[0] != '1')
+                || function_output[1] != '\0'){
+            fprintf(stderr, "Transformation function: line %d is not a valid "
+                            "entry for a %d cell neighborhood\n", line_number, num_inputs);
+            free(defined);
+            rule_table_destroy(table);
+            return -1;
+        }
+
+        index = 0;
+        for(i=0; i<num_inputs; i++){
+            if (function_input[i] != '0' && function_input[i] != '1'){
+                fprintf(stderr, "Transformation function: line %d contains non-boolean value\n",
+                                line_number);
+                free(defined);
+                rule_table_destroy(table);
+                return -1;
+            }
+            index = (index << 1) | CELL_BIT(function_input[i]);
+        }
+
+        if (defined[index] && table->outputs[index] != function_output[0]){
+            fprintf(stderr, "Transformation function: line %d contradicts a previous entry "
+                            "for %s\n", line_number, function_input);
+            free(defined);
+            rule_table_destroy(table);
+            return -1;
+        }
+        table->outputs[index] = function_output[0];
+        defined[index] = 1;
+    }
+
+    for(index=0; index<table->num_entries; index++){
+        if (!defined[index]){
+            fprintf(stderr, "Transformation function: missing entry for ");
+            for(i=num_inputs-1; i>=0; i--) fputc('0' + ((index >> i) & 1), stderr);
+            fprintf(stderr, "\n");
+            free(defined);
+            rule_table_destroy(table);
+            return -1;
+        }
+    }
+
+    free(defined);
+    return 0;
+}
+
+/**
+ * Frees the memory of a table filled in by rule_table_load
+ * */
+void rule_table_destroy(rule_table* table){
+    if (table->outputs) free(table->outputs);
+    table->outputs = NULL;
+}
+
+/**
+ * Checks whether a 2D table is outer-totalistic, i.e. the output only
+ * depends on the center cell and on how many of its 8 neighbors are 1
+ * (like the Game of Life). If it is, bit n of birth (survive) is set when
+ * a 0 (1) center cell with n neighbors in state 1 becomes 1.
+ * Returns 1 if the table is outer-totalistic and 0 otherwise
+ * */
+int rule_table_outer_totalistic(const rule_table* table, int* birth, int* survive){
+    int index, k, count, center, seen[2] = {0, 0}, result[2] = {0, 0};
+
+    if (table->num_inputs != RULE_2D_INPUTS) return 0;
+
+    for(index=0; index<table->num_entries; index++){
+        center = (index >> RULE_2D_CENTER) & 1;
+        count = 0;
+        for(k=0; k<RULE_2D_INPUTS; k++)
+            if (k != RULE_2D_CENTER) count += (index >> k) & 1;
+
+        if (seen[center] & (1 << count)){
+            if (((result[center] >> count) & 1) != CELL_BIT(table->outputs[index])) return 0;
+        } else {
+            seen[center] |= 1 << count;
+            result[center] |= CELL_BIT(table->outputs[index]) << count;
+        }
+    }
+
+    *birth = result[0];
+    *survive = result[1];
+    return 1;
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "functions.h"
+
+#define STATE_MAGIC "CASTATE1"      //first 8 bytes of a state file
+#define STATE_BYTE_ORDER 0x01020304u //as stored by the machine that wrote the file
+#define STATE_ALIGN 64              //the rows start at a multiple of 64 bytes
+#define STATE_WORD_BITS 64
+#define STATE_MAX_RULE_INPUTS 9     //largest neighborhood whose rule can be stored
+#define STATE_RULE_WORDS(inputs) (((1 << (inputs)) + STATE_WORD_BITS - 1) / STATE_WORD_BITS)
+
+/**
+ * Header of a binary state file. It is followed by the rows of the matrix,
+ * one bit per cell (cell j of a row is bit j%64 of word j/64), each row
+ * padded with zeros to row_words 64-bit words. The words are stored in the
+ * byte order of the machine that wrote them, so that they can be used in
+ * place; byte_order tells a file written by a machine of the other kind.
+ * The transformation function can be stored right after the header, one
+ * bit per entry of its table, so that a checkpoint is enough to resume
+ * */
+typedef struct {
+    char magic[8];
+    uint32_t header_size;  //offset of the first row, a multiple of STATE_ALIGN
+    uint32_t byte_order;
+    uint64_t rows, cols;
+    uint64_t generation;   //generations computed before the state was saved
+    uint64_t rule_id;      //state_rule_id of the transformation function, 0 if unknown
+    uint64_t row_words;
+    uint32_t rule_inputs;  //cells of the neighborhood of the stored rule, 0 if there is none
+    uint32_t checksum;     //state_checksum_fold of the rows, 0 if it was not computed
+} state_header;
+
+//words of the largest header plus rule, padding included
+#define STATE_MAX_HEADER_WORDS ((sizeof(state_header) + STATE_ALIGN) / sizeof(uint64_t) \
+                                + STATE_RULE_WORDS(STATE_MAX_RULE_INPUTS))
+
+/**
+ * State file mapped in memory: the rows are read straight from the page
+ * cache, without parsing or copying the whole file first
+ * */
+typedef struct {
+    state_header header;
+    const uint64_t* rows;
+    void* map;
+    size_t map_size;
+} state_file;
+
+/**
+ * Writes a state file one row at a time, so that the whole matrix never
+ * has to be in memory
+ * */
+typedef struct {
+    FILE* file;
+    state_header header;
+    uint64_t* row;          //the row being packed
+    uint64_t rows_written;
+    uint64_t checksum;      //sum of state_words_checksum of the rows written
+} state_writer;
+
+void state_header_init(state_header* header, uint64_t rows, uint64_t cols, uint64_t generation,
+                       uint64_t rule_id);
+void state_header_set_rule(state_header* header, const rule_table* table, uint64_t* bits);
+int state_check_header(const state_header* header, uint64_t file_size, const char* name);
+int state_rule_load(const state_header* header, const uint64_t* bits, rule_table* table);
+int state_is_binary(FILE* f);
+int state_map(state_file* state, FILE* f, const char* name);
+void state_unmap(state_file* state);
+void state_prefetch_rows(const state_file* state, uint64_t first_row, uint64_t num_rows);
+void state_release_rows(const state_file* state, uint64_t first_row, uint64_t num_rows);
+void state_get_cells(const state_file* state, uint64_t row, uint64_t first_col, uint64_t num_cols,
+                     char* cells);
+void state_unpack_cells(const uint64_t* words, uint64_t first_col, uint64_t num_cols, char* cells);
+void state_pack_cells(const char* cells, uint64_t num_cols, uint64_t* words);
+uint64_t state_rule_id(const rule_table* table);
+uint64_t state_words_checksum(const uint64_t* words, uint64_t first_index, uint64_t count);
+uint32_t state_checksum_fold(uint64_t sum);
+
+int state_writer_open(state_writer* w, const char* path, uint64_t rows, uint64_t cols,
+                      uint64_t generation, const rule_table* rule);
+int state_writer_put_row(state_writer* w, const char* cells);
+int state_writer_put_words(state_writer* w, const uint64_t* words);
+int state_writer_close(state_writer* w);
+
+/**
+ * First word of row of a mapped state
+ * */
+static inline const uint64_t* state_row(const state_file* state, uint64_t row){
+    return state->rows + row * state->header.row_words;
+}
+
+#endif
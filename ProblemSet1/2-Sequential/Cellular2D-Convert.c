@@ -0,0 +1,333 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include "functions.h"
+#include "state.h"
+#include "rle.h"
+
+#define MAX_CHAR 1024
+
+/**
+ * Layouts of a configuration: text (the size on the first line and then
+ * the '0'/'1' cells, like initial_configuration.txt or the files written
+ * by generate_nxn), an RLE pattern and a binary state file. A random
+ * configuration is only read, never written
+ * */
+enum {FORMAT_TEXT, FORMAT_RLE, FORMAT_STATE, FORMAT_RANDOM};
+
+/**
+ * Configuration read one row at a time, whatever its layout. An RLE
+ * pattern is placed at the top left corner of a square as large as its
+ * longest side, as the simulators do
+ * */
+typedef struct {
+    int format;
+    FILE* file;
+    int tam;
+    state_file state;
+    rle_reader rle;
+    uint64_t generation;
+    double density;         //of live cells, in a random configuration
+    uint64_t seed;          //state of its generator
+} source;
+
+/**
+ * Configuration written one row at a time
+ * */
+typedef struct {
+    int format;
+    FILE* file;
+    const char* name;
+    state_writer state;
+    rle_writer rle;
+} sink;
+
+/**
+ * Reads the size of the configuration open in file. Returns 0 on success
+ * and -1 otherwise
+ * */
+int source_open(source* in, FILE* file, const char* name){
+    char size[MAX_CHAR];
+
+    in->file = file;
+    in->tam = -1;
+    in->generation = 0;
+    in->state.map = NULL;
+    if (state_is_binary(file)){
+        in->format = FORMAT_STATE;
+        if (state_map(&in->state, file, name) != 0) return -1;
+        if (in->state.header.rows == in->state.header.cols && in->state.header.cols <= INT_MAX)
+            in->tam = (int) in->state.header.cols;
+        in->generation = in->state.header.generation;
+    } else if (rle_is_rle(file)){
+        in->format = FORMAT_RLE;
+        if (rle_reader_open(&in->rle, file, name) == 0 && in->rle.width <= INT_MAX && in->rle.height <= INT_MAX)
+            in->tam = (int) ((in->rle.width > in->rle.height) ? in->rle.width : in->rle.height);
+    } else {
+        in->format = FORMAT_TEXT;
+        if (fgets(size, MAX_CHAR, file)) in->tam = atoi(size);
+    }
+    if (in->tam < 1){
+        fprintf(stderr, "%s: not valid size of the matrix\n", name);
+        state_unmap(&in->state);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Starts a random tam x tam configuration, like the ones of generate_nxn
+ * but with a given density of live cells. The same seed gives the same
+ * configuration on every machine, so that benchmarks can be repeated
+ * */
+void source_open_random(source* in, int tam, double density, uint64_t seed){
+    in->format = FORMAT_RANDOM;
+    in->file = NULL;
+    in->tam = tam;
+    in->generation = 0;
+    in->state.map = NULL;
+    in->density = density;
+    in->seed = seed;
+}
+
+/**
+ * Next number of the splitmix64 generator of the source
+ * */
+static uint64_t next_random(source* in){
+    uint64_t z = (in->seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Reads row i of the configuration into cells, as '0' or '1'; the rows
+ * are read in order. Returns 0 on success and -1 otherwise
+ * */
+int source_get_row(source* in, int i, char* cells){
+    int j, char_act;
+
+    if (in->format == FORMAT_STATE){
+        state_get_cells(&in->state, i, 0, in->tam, cells);
+        return 0;
+    }
+    if (in->format == FORMAT_RLE) return rle_read_row(&in->rle, 0, in->tam, cells);
+    if (in->format == FORMAT_RANDOM){
+        //the 53 high bits make a uniform number in [0, 1)
+        for(j=0; j<in->tam; j++) cells[j] = ((next_random(in) >> 11) * 0x1.0p-53 < in->density) ? '1' : '0';
+        return 0;
+    }
+    for(j=0; j<in->tam; j++){
+        do{
+            char_act = fgetc(in->file);
+        } while (char_act != '0' && char_act != '1' && char_act != EOF);
+
+        if (char_act == EOF){
+            fprintf(stderr, "Initial configuration contains non-boolean value\n");
+            return -1;
+        }
+        cells[j] = char_act;
+    }
+    return 0;
+}
+
+void source_close(source* in){
+    state_unmap(&in->state);
+}
+
+/**
+ * Creates the tam x tam configuration name in the given format. Returns 0
+ * on success and -1 otherwise
+ * */
+int sink_open(sink* out, int format, const char* name, int tam, uint64_t generation, const rule_table* rule){
+    out->format = format;
+    out->name = name;
+    if (format == FORMAT_STATE) return state_writer_open(&out->state, name, tam, tam, generation, rule);
+
+    out->file = fopen(name, "w");
+    if (!out->file){
+        fprintf(stderr, "%s could not be created\n", name);
+        return -1;
+    }
+    if (format == FORMAT_RLE) rle_writer_open(&out->rle, out->file, tam, tam);
+    else fprintf(out->file, "%d\n", tam);
+    return 0;
+}
+
+int sink_put_row(sink* out, const char* cells, int tam){
+    if (out->format == FORMAT_STATE) return state_writer_put_row(&out->state, cells);
+    if (out->format == FORMAT_RLE) rle_writer_put_row(&out->rle, cells);
+    else {
+        fwrite(cells, sizeof(char), tam, out->file);
+        fputc('\n', out->file);
+    }
+    return 0;
+}
+
+/**
+ * Completes the configuration. Returns 0 on success and -1 if some write
+ * failed
+ * */
+int sink_close(sink* out){
+    int status = 0;
+
+    if (out->format == FORMAT_STATE) return state_writer_close(&out->state);
+    if (out->format == FORMAT_RLE) status = rle_writer_close(&out->rle);
+    if (ferror(out->file) || fclose(out->file) != 0 || status != 0){
+        fprintf(stderr, "Could not write %s\n", out->name);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Format of the file name given its extension, or the default one if it
+ * has none of them
+ * */
+int format_of(const char* name, int fallback){
+    const char* extension = strrchr(name, '.');
+
+    if (!extension) return fallback;
+    if (strcmp(extension, ".rle") == 0) return FORMAT_RLE;
+    if (strcmp(extension, ".state") == 0) return FORMAT_STATE;
+    if (strcmp(extension, ".txt") == 0) return FORMAT_TEXT;
+    return fallback;
+}
+
+/**
+ * Copies the configuration in, already open, into output, row by row, so
+ * that the whole matrix never has to be in memory, and closes in.
+ * Returns 0 on success and -1 otherwise
+ * */
+int convert(source* in, const char* output, int generation_given, uint64_t generation,
+            const rule_table* rule){
+    sink out;
+    char* cells;
+    int i, status = 0;
+
+    if (!generation_given) generation = in->generation;
+    cells = (char*) calloc (sizeof(char), in->tam);
+    if (!cells){
+        fprintf(stderr, "Not enough memory for a row of size %d\n", in->tam);
+        source_close(in);
+        return -1;
+    }
+    //a state file becomes text, and anything else a state file, unless the extension tells
+    if (sink_open(&out, format_of(output, (in->format == FORMAT_STATE) ? FORMAT_TEXT : FORMAT_STATE),
+                  output, in->tam, generation, rule) != 0){
+        free(cells);
+        source_close(in);
+        return -1;
+    }
+
+    for(i=0; i<in->tam && status == 0; i++){
+        status = source_get_row(in, i, cells);
+        if (status == 0) status = sink_put_row(&out, cells, in->tam);
+    }
+
+    if (sink_close(&out) != 0) status = -1;
+    free(cells);
+    source_close(in);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    FILE * input = NULL;
+    FILE * transformation_function = NULL;
+    unsigned long long generation = 0, seed = 1;
+    int option, status = 0, generation_given = 0, random_size = 0;
+    double density = 0.5;
+    const char* rule_file = NULL;
+    rule_table rule = {0, 0, NULL};
+    source in;
+
+    //Argument check
+    while((option = getopt(argc, argv, "r:g:n:p:S:")) != -1){
+        if (option == 'r') rule_file = optarg;
+        else if (option == 'g'){
+            generation = strtoull(optarg, NULL, 10);
+            generation_given = 1;
+        }
+        else if (option == 'n') random_size = atoi(optarg);
+        else if (option == 'p') density = atof(optarg);
+        else if (option == 'S') seed = strtoull(optarg, NULL, 10);
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != (random_size > 0 ? 1 : 2) || random_size < 0 || density < 0 || density > 1){
+        fprintf(stderr, "Incorrect arguments: try ./Cellular2D-Convert [-r transformation_function] "
+                        "[-g generation] input output\n"
+                        "                  or ./Cellular2D-Convert [-r transformation_function] "
+                        "-n size [-p density] [-S seed] output\n"
+                        "The input can be a text configuration, an RLE pattern or a binary state file.\n"
+                        "The output is an RLE pattern if its name ends with .rle, a text configuration\n"
+                        "if it ends with .txt and a binary state file if it ends with .state; otherwise\n"
+                        "a binary state file becomes a text configuration and anything else a state file\n"
+                        "  -r F  store in the state file the transformation function it is run with\n"
+                        "  -g N  record in the state file the generation it holds (default that of the\n"
+                        "        input, or 0)\n"
+                        "  -n N  write a random N x N configuration instead of converting an input\n"
+                        "  -p D  density of live cells of the random configuration (default 0.5)\n"
+                        "  -S S  seed of the random configuration (default 1)\n");
+        return EXIT_FAILURE;
+    }
+
+    if (random_size > 0) source_open_random(&in, random_size, density, seed);
+    else {
+        input = fopen(argv[optind], "rb");
+        if (!input){
+            fprintf(stderr, "%s does not exist or could not be opened\n", argv[optind]);
+            return EXIT_FAILURE;
+        }
+        if (source_open(&in, input, argv[optind]) != 0){
+            fclose(input);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (rule_file){
+        transformation_function = fopen(rule_file, "r");
+        if (!transformation_function){
+            fprintf(stderr, "%s does not exist or could not be opened\n", rule_file);
+            source_close(&in);
+            if (input) fclose(input);
+            return EXIT_FAILURE;
+        }
+        status = rule_table_load(&rule, transformation_function, RULE_2D_INPUTS);
+        fclose(transformation_function);
+        if (status != 0){
+            source_close(&in);
+            if (input) fclose(input);
+            return EXIT_FAILURE;
+        }
+    }
+
+    status = convert(&in, argv[argc-1], generation_given, generation, rule.outputs ? &rule : NULL);
+
+    rule_table_destroy(&rule);
+    if (input) fclose(input);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "functions.h"
+#include "hashlife.h"
+#include "state.h"
+#include "rle.h"
+#include "bench.h"
+
+#define MAX_CHAR 1024
+#define DEFAULT_CACHE_MB 1024
+
+/**
+ * Function used to free all the memory allocations (if any)
+ * and close the files used (if any)
+ * */
+void program_destroy(int sz, char** mat, FILE* f1, FILE* f2){
+    int i;
+    if(mat){ for(i=0; i<sz; i++) free(mat[i]); free(mat);}
+    if(f1) fclose(f1);
+    if(f2) fclose(f2);
+}
+
+/**
+ * Prints the tam x tam matrix, one row per line
+ * */
+void print_matrix(char** matrix, int tam){
+    int i;
+    for(i=0; i<tam; i++){
+        fwrite(matrix[i], sizeof(char), tam, stdout);
+        putchar('\n');
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char** matrix = NULL;
+    FILE * initial_configuration = NULL;
+    FILE * transformation_function = NULL;
+    int i, j, tam = -1, option, status = 0, bench = 0;
+    double start;
+    unsigned long long num_iterations = 0, generation = 0, output_every = 1, chunk;
+    long cache_mb = DEFAULT_CACHE_MB;
+    char size[MAX_CHAR];
+    char char_act, *end;
+    rule_table rule;
+    hashlife h;
+    state_file state = {.map = NULL};
+    int binary, pattern = 0;
+    rle_reader reader;
+
+    //Argument check
+    while((option = getopt(argc, argv, "o:m:B")) != -1){
+        if (option == 'o') output_every = strtoull(optarg, NULL, 10);
+        else if (option == 'm') cache_mb = atol(optarg);
+        else if (option == 'B') bench = 1;
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 3 || cache_mb < 1){
+        fprintf(stderr, "Incorrect arguments: try ./Cellular2D-Hashlife [-o output_every] [-m cache_mb] [-B] "
+                        "initial_configuration transformation_function num_iterations\n"
+                        "  -o N  print the matrix every N generations (default 1, 0 = never)\n"
+                        "  -m M  memory for the node cache in MB (default %d)\n"
+                        "  -B    report the wall time of the generations on stderr (see benchmark.sh)\n"
+                        "The initial configuration can be a text file, an RLE pattern or a binary state file\n", DEFAULT_CACHE_MB);
+        return EXIT_FAILURE;
+    }
+
+    num_iterations = strtoull(argv[optind+2], &end, 10);
+    if (*end != '\0' || argv[optind+2][0] == '-' || num_iterations < 1
+        || (num_iterations >> (HASHLIFE_MAX_JUMP + 1))){
+        fprintf(stderr, "The number of iterations must be between 1 and 2^%d - 1\n", HASHLIFE_MAX_JUMP + 1);
+        return EXIT_FAILURE;
+    }
+
+    initial_configuration = fopen (argv[optind], "r");
+    transformation_function = fopen(argv[optind+1], "r");
+    if (!initial_configuration || !transformation_function){
+        fprintf(stderr, "Files do not exist or could not be opened\n");
+        program_destroy(tam, matrix, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    //any 3x3 rule works: the torus is tiled over the plane, so there is no empty background
+    if (rule_table_load(&rule, transformation_function, RULE_2D_INPUTS) != 0){
+        program_destroy(tam, matrix, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    /**
+     * a binary state file is mapped, a text configuration is read cell by
+     * cell and an RLE pattern run by run, at the top left corner of a
+     * square as large as its longest side
+     * */
+    binary = state_is_binary(initial_configuration);
+    if (binary){
+        if (state_map(&state, initial_configuration, argv[optind]) != 0){
+            rule_table_destroy(&rule);
+            program_destroy(0, matrix, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+        if (state.header.rule_id != 0 && state.header.rule_id != state_rule_id(&rule))
+            fprintf(stderr, "Warning: %s was saved with another transformation function\n", argv[optind]);
+        tam = (state.header.rows == state.header.cols && state.header.cols < (1 << 28))
+              ? (int) state.header.cols : -1;
+    } else if ((pattern = rle_is_rle(initial_configuration))){
+        tam = -1;
+        if (rle_reader_open(&reader, initial_configuration, argv[optind]) == 0
+            && reader.width < (1 << 28) && reader.height < (1 << 28))
+            tam = (int) ((reader.width > reader.height) ? reader.width : reader.height);
+    } else {
+        fgets(size, MAX_CHAR, initial_configuration);
+        tam = atoi(size);
+    }
+    if (tam<1 || tam >= (1 << 28)){
+        fprintf(stderr, "Not valid size of the matrix\n");
+        state_unmap(&state);
+        rule_table_destroy(&rule);
+        program_destroy(0, matrix, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    //memory allocation for the matrix
+    matrix = (char **) calloc (sizeof(char*), tam);
+    for (i=0; matrix && i<tam; i++){
+        matrix[i] = (char *) calloc (tam, sizeof(char));
+        if (!matrix[i]) status = -1;
+    }
+    if (!matrix || status != 0 || hashlife_create(&h, &rule, (size_t)cache_mb << 20) != 0){
+        fprintf(stderr, "Not enough memory for a matrix of size %d\n", tam);
+        state_unmap(&state);
+        rule_table_destroy(&rule);
+        program_destroy(matrix ? tam : 0, matrix, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    //read input matrix from file
+    for(i=0; i<tam && binary; i++) state_get_cells(&state, i, 0, tam, matrix[i]);
+    state_unmap(&state);
+    for(i=0; i<tam && pattern; i++){
+        if (rle_read_row(&reader, 0, tam, matrix[i]) != 0){
+            hashlife_destroy(&h);
+            rule_table_destroy(&rule);
+            program_destroy(tam, matrix, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+    }
+    for(i=0; i<tam && !binary && !pattern; i++){
+        for(j=0; j<tam; j++){
+            do{
+                char_act = fgetc(initial_configuration);
+            } while (char_act != '0' && char_act != '1' && char_act != EOF);
+
+            if (char_act == EOF){
+                fprintf(stderr, "Initial configuration contains non-boolean value\n");
+                hashlife_destroy(&h);
+                rule_table_destroy(&rule);
+                program_destroy(tam, matrix, transformation_function, initial_configuration);
+                return EXIT_FAILURE;
+            }
+            matrix[i][j] = char_act;
+        }
+    }
+
+    //print initial input (for debugging purposes)
+    if (output_every > 0){
+        printf("MOTHER MATRIX:\n");
+        print_matrix(matrix, tam);
+    }
+
+    /**
+     * the matrix is advanced straight from one printed generation to the
+     * next: a jump costs about the same whatever its length
+     * */
+    start = bench_now();
+    while(generation < num_iterations){
+        chunk = (output_every > 0) ? output_every : num_iterations;
+        if (chunk > num_iterations - generation) chunk = num_iterations - generation;
+        if (hashlife_advance(&h, matrix, tam, chunk) != 0){
+            fprintf(stderr, "Not enough memory for the node cache\n");
+            status = -1;
+            break;
+        }
+        generation += chunk;
+
+        //print result matrix (for debugging purposes)
+        if (output_every > 0 && generation % output_every == 0){
+            printf("---> IT %llu\nRESULT MATRIX:\n", num_iterations - generation + 1);
+            print_matrix(matrix, tam);
+        }
+    }
+
+    if (bench && status == 0)
+        bench_report("Cellular2D-Hashlife", (unsigned long long)tam * tam, num_iterations, 1, 1, bench_now() - start);
+
+    //free resources
+    hashlife_destroy(&h);
+    rule_table_destroy(&rule);
+    program_destroy(tam, matrix, transformation_function, initial_configuration);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
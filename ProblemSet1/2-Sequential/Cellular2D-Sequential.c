@@ -18,175 +18,715 @@
  *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  * */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include "functions.h"
+#include "bitsliced.h"
+#include "padded.h"
+#include "workers.h"
+#include "active.h"
+#include "state.h"
+#include "output.h"
+#include "rle.h"
+#include "bench.h"
+#include "dataflow.h"
 
 #define MAX_CHAR 1024
+#define TILE_ROWS 64  //rows of a tile of the active map
+#define TILE_COLS 64  //columns of a tile, looking up the table
+#define TILE_WORDS 16  //words of a tile, with the bit-sliced kernel
+#define OUTPUT_FRAMES 4 //frames that can wait to be written
+#define BAND_BYTES (256*1024)  //bytes of a buffer of temporal tiling, so that the two of a worker fit in L2
+
+/**
+ * State shared by the workers: generation g is computed from matrices[g%2]
+ * (grids[g%2] with the bit-sliced kernel) into the other one. Only the
+ * tiles of the active map that may change are computed. With temporal
+ * tiling every step of the workers is a pass of several generations
+ * instead (see simulation_step_bands), and pass p goes from matrices[p%2]
+ * into the other one. With the dataflow scheduler every step is a segment
+ * of generations up to the next one printed, which the tiles go through
+ * each at its own pace (see simulation_step_dataflow)
+ * */
+typedef struct {
+    const padded_rule* prule;
+    const bitsliced_rule* brule;  //NULL if the rule is looked up in the table
+    padded_grid* matrices;
+    bitsliced_grid* grids;
+    active_map active;
+    int tile_cols;                //columns (words with the bit-sliced kernel) of a tile
+    int cols;                     //columns (words) covered by the tiles
+    int tam;
+    int num_iterations;
+    int output_every;
+    output_pipeline* output;
+    int depth;                    //generations of a pass of temporal tiling, 1 = no temporal tiling
+    int band_rows;
+    int band_cols;                //columns of a tile of a band, tam = whole rows
+    int generation;               //generation the current pass starts at, or the current segment ends at
+    padded_grid* pbands;          //two bands per worker, looking up the table
+    bitsliced_grid* bbands;       //two bands per worker, with the bit-sliced kernel
+    dataflow* flow;               //NULL if every generation ends with a barrier
+} simulation;
 
 /**
  * Function used to free all the memory allocations (if any)
  * and close the files used (if any)
  * */
-void program_destroy(int sz, char** mat1, char** mat2, FILE* f1, FILE* f2){
-    int i;
-    if(mat1){ for(i=0; i<sz; i++) free(mat1[i]); free(mat1);}
-    if(mat2){ for(i=0; i<sz; i++) free(mat2[i]); free(mat2);}
+void program_destroy(padded_grid* matrices, FILE* f1, FILE* f2){
+    padded_grid_destroy(&matrices[0]);
+    padded_grid_destroy(&matrices[1]);
     if(f1) fclose(f1);
     if(f2) fclose(f2);
 }
 
-/**Function that receives an input string and the transformation_function
- * file and returns the output according to the file. In case of error
- * returns the string "E"
+/**
+ * Computes tile (r, c) of the next generation, unless it repeats the
+ * generation before. Its rows are row0..row1-1 and its columns (words
+ * with the bit-sliced kernel) col0..col1-1
+ * */
+void step_tile(simulation* sim, int generation, int r, int c, int row0, int row1, int col0, int col1){
+    int changed = 0, current = generation % 2;
+
+    if (active_tile_needed(&sim->active, generation, r, c)){
+        if (sim->brule)
+            changed = bitsliced_step_tile(sim->brule, &sim->grids[current], &sim->grids[1 - current],
+                                          row0, row1, col0, col1);
+        else
+            changed = padded_step_tile(sim->prule, &sim->matrices[current], &sim->matrices[1 - current],
+                                       row0, row1, col0, col1);
+    }
+    active_tile_set(&sim->active, generation, r, c, changed);
+}
+
+/**
+ * Computes the rows of tiles of the next generation that belong to the
+ * worker, skipping the tiles that repeat the generation before. The
+ * worker also refreshes the ghost cells of its rows, which stand for the
+ * wrap of the torus in both kernels
+ * */
+void simulation_step(void* state, int worker, int num_workers, int generation){
+    simulation* sim = (simulation*) state;
+    int first, last, r, c, row0, row1, col0, col1, current = generation % 2;
+
+    workers_split(sim->active.rows, 1, worker, num_workers, &first, &last);
+    for(r=first; r<last; r++){
+        row0 = r * TILE_ROWS;
+        row1 = (row0 + TILE_ROWS < sim->tam) ? row0 + TILE_ROWS : sim->tam;
+        for(c=0; c<sim->active.cols; c++){
+            col0 = c * sim->tile_cols;
+            col1 = (col0 + sim->tile_cols < sim->cols) ? col0 + sim->tile_cols : sim->cols;
+            step_tile(sim, generation, r, c, row0, row1, col0, col1);
+        }
+    }
+
+    first = (first * TILE_ROWS < sim->tam) ? first * TILE_ROWS : sim->tam;
+    last = (last * TILE_ROWS < sim->tam) ? last * TILE_ROWS : sim->tam;
+    if (sim->brule) bitsliced_refresh_rows(&sim->grids[1 - current], first, last);
+    else padded_refresh_rows(&sim->matrices[1 - current], first, last);
+}
+
+/**
+ * Task of the dataflow scheduler: computes tile (r, c) of the next
+ * generation like simulation_step, and refreshes the ghost cells that
+ * depend on it. The scheduler only runs it once the 8 neighbors have
+ * reached its generation (and the first tile of the row the next one, if
+ * it is in the last column), so the active map needs no change: the
+ * changes of the neighbors it reads are those of this generation, which
+ * nobody overwrites until this tile is done
+ * */
+void simulation_tile(void* state, int worker, int r, int c, int generation){
+    simulation* sim = (simulation*) state;
+    int row0 = r * TILE_ROWS, col0 = c * sim->tile_cols, current = generation % 2;
+    int row1 = (row0 + TILE_ROWS < sim->tam) ? row0 + TILE_ROWS : sim->tam;
+    int col1 = (col0 + sim->tile_cols < sim->cols) ? col0 + sim->tile_cols : sim->cols;
+
+    (void) worker;
+    step_tile(sim, generation, r, c, row0, row1, col0, col1);
+    //a skipped tile still refreshes the ghost cells, which may stand for cells of other tiles
+    if (sim->brule) bitsliced_refresh_tile(&sim->grids[1 - current], row0, row1, col0, col1);
+    else padded_refresh_tile(&sim->matrices[1 - current], row0, row1, col0, col1);
+}
+
+/**
+ * Dataflow scheduler: the workers compute the tiles of the torus until
+ * all of them reach the end of the segment, with no barrier between the
+ * generations in between, and steal tiles from each other when they run
+ * out of them
+ * */
+void simulation_step_dataflow(void* state, int worker, int num_workers, int segment){
+    simulation* sim = (simulation*) state;
+
+    (void) num_workers;
+    (void) segment;
+    dataflow_run(sim->flow, worker);
+}
+
+/**
+ * Generation at which a segment of the dataflow scheduler that starts at
+ * the given generation ends: the next one printed or the last one
+ * */
+int segment_end(const simulation* sim, int generation){
+    int printed;
+
+    if (sim->output_every > 0){
+        printed = (generation / sim->output_every + 1) * sim->output_every;
+        if (printed < sim->num_iterations) return printed;
+    }
+    return sim->num_iterations;
+}
+
+/**
+ * Generation at which a pass of temporal tiling that starts at the given
+ * generation ends: depth generations later, unless a matrix is printed
+ * before. The matrices printed are a generation and the one before it,
+ * so the pass stops at the one before and the next pass only computes
+ * the printed generation
+ * */
+int pass_end(const simulation* sim, int generation){
+    int end = (sim->num_iterations - generation < sim->depth) ? sim->num_iterations : generation + sim->depth;
+    int printed;
+
+    if (sim->output_every > 0){
+        printed = (generation / sim->output_every + 1) * sim->output_every;
+        if (printed <= sim->num_iterations){
+            if (generation == printed - 1) end = printed;
+            else if (end > printed - 1) end = printed - 1;
+        }
+    }
+    return end;
+}
+
+/**
+ * Row (or column) of the torus at the given distance (maybe negative or
+ * past the end) from row 0
+ * */
+static inline int wrap_row(int row, int tam){
+    return ((row % tam) + tam) % tam;
+}
+
+/**
+ * Copies rows rows of the matrix, from row first on (wrapping around the
+ * torus), into a band from its row 0 on
  * */
-char transform(char* input, FILE * funct){
-    char line[MAX_CHAR];
-    char function_input[MAX_CHAR] = "", function_output[MAX_CHAR] = ""; 
-    rewind(funct);
-    while(fgets(line, sizeof line, funct)!= NULL){ 
-      strcpy(function_input, strtok(line, " "));
-      strcpy(function_output, strtok(NULL, " "));
-      if (strcmp(function_input, input) == 0){
-          return *function_output;
-      }
+void load_band(const simulation* sim, int matrix, int band, int first, int rows){
+    int i, row, count;
+
+    for(i=0; i<rows; i+=count){
+        row = wrap_row(first + i, sim->tam);
+        count = (rows - i < sim->tam - row) ? rows - i : sim->tam - row;
+        if (sim->brule) bitsliced_copy_rows(&sim->bbands[band], i, &sim->grids[matrix], row, count);
+        else padded_copy_rows(&sim->pbands[band], i, &sim->matrices[matrix], row, count);
+    }
+}
+
+/**
+ * Copies cols columns of rows rows of the matrix, from row first_row and
+ * column first_col on (both wrapping around the torus), into a band from
+ * its row 0 and column 0 on. The ghost cells of the band are not used
+ * */
+void load_tile(const simulation* sim, int matrix, int band, int first_row, int first_col, int rows, int cols){
+    int i, j, row, col, count;
+
+    for(i=0; i<rows; i++){
+        row = wrap_row(first_row + i, sim->tam);
+        for(j=0; j<cols; j+=count){
+            col = wrap_row(first_col + j, sim->tam);
+            count = (cols - j < sim->tam - col) ? cols - j : sim->tam - col;
+            if (sim->brule) bitsliced_copy_cells(&sim->bbands[band], i, j, &sim->grids[matrix], row, col, count);
+            else padded_copy_cells(&sim->pbands[band], i, j, &sim->matrices[matrix], row, col, count);
+        }
     }
-    return 'E';
 }
 
 /**
- * Returns the module of the given numbers. Contrary to the
- * operator %, returns the module of negative numbers too
+ * Computes the rows first_row..last_row-1 and the columns
+ * first_col..last_col-1 of the next generation of band in into band out
  * */
-int module(int num1, int num2){
-    if (num1>=0) return num1%num2;
-    else return num2+num1;
+static void step_band(const simulation* sim, int in, int out, int first_row, int last_row,
+                      int first_col, int last_col){
+    if (sim->brule)
+        //column c is bit c+1 of the words of the row
+        bitsliced_step_tile(sim->brule, &sim->bbands[in], &sim->bbands[out], first_row, last_row,
+                            (first_col + 1) / WORD_BITS, last_col / WORD_BITS + 1);
+    else padded_step_tile(sim->prule, &sim->pbands[in], &sim->pbands[out], first_row, last_row, first_col, last_col);
 }
 
+/**
+ * Temporal tiling: computes the pass of the workers (see pass_end) one
+ * band of rows at a time, so that the matrix goes through the memory once
+ * per pass instead of once per generation. A band is loaded with as many
+ * rows as generations above and below it, and advanced generation by
+ * generation in two buffers that stay in the cache: each generation is
+ * valid on one row less on each side (the extra rows are computed by the
+ * neighbor bands too), and after the last one the band itself is copied
+ * into the other matrix. If whole rows do not fit in the buffers, every
+ * band goes tile by tile of band_cols columns, loaded with as many columns
+ * as generations on each side too, so each generation is valid on one
+ * column less on each side as well. The tiles of the active map are not
+ * skipped
+ * */
+void simulation_step_bands(void* state, int worker, int num_workers, int pass){
+    simulation* sim = (simulation*) state;
+    int current = pass % 2, generations = pass_end(sim, sim->generation) - sim->generation;
+    int num_bands = (sim->tam + sim->band_rows - 1) / sim->band_rows;
+    int first, last, b, g, i, row0, col0, rows, cols, height, width, in, out;
+
+    workers_split(num_bands, 1, worker, num_workers, &first, &last);
+    for(b=first; b<last; b++){
+        row0 = b * sim->band_rows;
+        rows = (row0 + sim->band_rows < sim->tam) ? sim->band_rows : sim->tam - row0;
+        height = rows + 2*generations;
+
+        //whole rows wrap around through their ghost cells
+        if (sim->band_cols >= sim->tam){
+            load_band(sim, current, 2*worker, row0 - generations, height);
+
+            //generation g is valid from row g to row height-g-1 of the band
+            for(g=1; g<=generations; g++){
+                in = 2*worker + (g-1) % 2;
+                out = 2*worker + g % 2;
+                if (sim->brule){
+                    bitsliced_step_rows(sim->brule, &sim->bbands[in], &sim->bbands[out], g, height - g);
+                    bitsliced_refresh_cols(&sim->bbands[out], g, height - g);
+                } else {
+                    padded_step_tile(sim->prule, &sim->pbands[in], &sim->pbands[out], g, height - g, 0, sim->tam);
+                    padded_refresh_cols(&sim->pbands[out], g, height - g);
+                }
+            }
+
+            out = 2*worker + generations % 2;
+            if (sim->brule) bitsliced_copy_rows(&sim->grids[1 - current], row0, &sim->bbands[out], generations, rows);
+            else padded_copy_rows(&sim->matrices[1 - current], row0, &sim->pbands[out], generations, rows);
+            continue;
+        }
+
+        for(col0=0; col0<sim->tam; col0+=sim->band_cols){
+            cols = (col0 + sim->band_cols < sim->tam) ? sim->band_cols : sim->tam - col0;
+            width = cols + 2*generations;
+            load_tile(sim, current, 2*worker, row0 - generations, col0 - generations, height, width);
+
+            //generation g is valid from row g to row height-g-1, and from column g to column width-g-1
+            for(g=1; g<=generations; g++)
+                step_band(sim, 2*worker + (g-1) % 2, 2*worker + g % 2, g, height - g, g, width - g);
 
-int main(int argc, char const *argv[]) {
-    char** matrix = NULL;
-    char** result_matrix = NULL;
+            out = 2*worker + generations % 2;
+            for(i=0; i<rows; i++){
+                if (sim->brule)
+                    bitsliced_copy_cells(&sim->grids[1 - current], row0 + i, col0, &sim->bbands[out],
+                                         generations + i, generations, cols);
+                else padded_copy_cells(&sim->matrices[1 - current], row0 + i, col0, &sim->pbands[out],
+                                       generations + i, generations, cols);
+            }
+        }
+    }
+
+    first = (first * sim->band_rows < sim->tam) ? first * sim->band_rows : sim->tam;
+    last = (last * sim->band_rows < sim->tam) ? last * sim->band_rows : sim->tam;
+    if (sim->brule) bitsliced_refresh_rows(&sim->grids[1 - current], first, last);
+    else padded_refresh_rows(&sim->matrices[1 - current], first, last);
+}
+
+/**
+ * Bytes of a stored row of a buffer of temporal tiling of cols columns
+ * */
+static size_t band_row_bytes(const simulation* sim, int cols){
+    return sim->brule ? bitsliced_row_bytes(cols) : padded_row_bytes(cols);
+}
+
+/**
+ * Allocates the two bands of every worker for temporal tiling, choosing
+ * the columns of a tile if band_cols is 0 and the rows of a band if
+ * band_rows is 0, so that a buffer takes about BAND_BYTES: whole rows if
+ * they are not wider than a square buffer, and otherwise tiles about as
+ * tall as wide. Warns if a buffer does not fit in BAND_BYTES anyway.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int bands_create(simulation* sim, int num_workers, int band_rows, int band_cols){
+    int i, side, num_tiles, width, status = 0;
+    long cells = (long) BAND_BYTES * (sim->brule ? 8 : 1);
+    size_t bytes;
+
+    //side of a square buffer of BAND_BYTES
+    for(side=1; (long)(side + 1) * (side + 1) <= cells; side++);
+
+    //the extra rows and columns are computed twice, so a tile has at least 4 times as many of them
+    if (band_cols == 0 && sim->tam > side){
+        band_cols = side - 2*sim->depth;
+        if (band_cols < 4*sim->depth) band_cols = 4*sim->depth;
+        //tiles of the same width instead of a narrow one at the end
+        num_tiles = (sim->tam + band_cols - 1) / band_cols;
+        band_cols = (sim->tam + num_tiles - 1) / num_tiles;
+    }
+    if (band_cols == 0 || band_cols > sim->tam) band_cols = sim->tam;
+    if (band_cols < 4*sim->depth && band_cols < sim->tam) band_cols = 4*sim->depth;
+    sim->band_cols = (band_cols < sim->tam) ? band_cols : sim->tam;
+    width = (sim->band_cols < sim->tam) ? sim->band_cols + 2*sim->depth : sim->tam;
+
+    if (band_rows == 0) band_rows = (int) (BAND_BYTES / band_row_bytes(sim, width)) - 2*sim->depth - 2;
+    if (band_rows < 4*sim->depth) band_rows = 4*sim->depth;
+    sim->band_rows = (band_rows < sim->tam) ? band_rows : sim->tam;
+
+    bytes = band_row_bytes(sim, width) * (sim->band_rows + 2*sim->depth + 2);
+    if (bytes > BAND_BYTES)
+        fprintf(stderr, "Warning: a band of %d x %d cells with %d generations takes %zu KB, more than the %d KB "
+                        "that stay in the cache (try -b and -w)\n",
+                sim->band_rows, sim->band_cols, sim->depth, bytes / 1024, BAND_BYTES / 1024);
+
+    sim->pbands = NULL;
+    sim->bbands = NULL;
+    if (sim->brule) sim->bbands = (bitsliced_grid*) calloc (sizeof(bitsliced_grid), 2*num_workers);
+    else sim->pbands = (padded_grid*) calloc (sizeof(padded_grid), 2*num_workers);
+    if (!sim->bbands && !sim->pbands) return -1;
+    for(i=0; i<2*num_workers && status == 0; i++){
+        if (sim->brule) status = bitsliced_band_create(&sim->bbands[i], width, sim->band_rows + 2*sim->depth);
+        else status = padded_band_create(&sim->pbands[i], width, sim->band_rows + 2*sim->depth);
+    }
+    return status;
+}
+
+void bands_destroy(simulation* sim, int num_workers){
+    int i;
+
+    for(i=0; i<2*num_workers; i++){
+        if (sim->bbands) bitsliced_grid_destroy(&sim->bbands[i]);
+        if (sim->pbands) padded_grid_destroy(&sim->pbands[i]);
+    }
+    free(sim->bbands);
+    free(sim->pbands);
+}
+
+/**
+ * Queues the matrix of the given generation as a frame of the output
+ * */
+void queue_matrix(simulation* sim, int generation, const char* title){
+    char* cells = output_frame_begin(sim->output, sim->tam, sim->tam, title);
+    int i;
+
+    for(i=0; i<sim->tam; i++){
+        if (sim->brule) bitsliced_grid_get_row(&sim->grids[generation % 2], i, cells + (size_t)i * sim->tam);
+        else memcpy(cells + (size_t)i * sim->tam, padded_grid_row(&sim->matrices[generation % 2], i), sim->tam);
+    }
+    output_frame_end(sim->output);
+}
+
+/**
+ * Queues the input and output matrices of the last generation computed,
+ * which are written while the next generations are computed. With
+ * temporal tiling it is called after every pass, which ends at the
+ * generation printed or at another one. With the dataflow scheduler it is
+ * called after every segment, and starts the next one
+ * */
+void simulation_publish(void* state, int generation){
+    simulation* sim = (simulation*) state;
+    char title[OUTPUT_TITLE];
+    int printed = generation;
+
+    //generation counts the passes, but the last one also went from [(generation-1)%2] to [generation%2]
+    if (sim->depth > 1){
+        printed = sim->generation = pass_end(sim, sim->generation);
+        if (sim->output_every == 0 || printed % sim->output_every != 0) return;
+    }
+
+    //generation counts the segments, but the matrices are in [printed%2] as with a barrier
+    if (sim->flow) printed = generation = sim->generation;
+
+    //print input and output matrices (for debugging purposes)
+    if (sim->output_every > 0 && printed % sim->output_every == 0){
+        snprintf(title, sizeof title, "----->IT %d\nINPUT MATRIX:\n", sim->num_iterations - printed + 1);
+        queue_matrix(sim, generation - 1, title);
+        queue_matrix(sim, generation, "OUTPUT MATRIX:\n");
+    }
+
+    //the next segment starts once the matrices are queued
+    if (sim->flow && printed < sim->num_iterations){
+        sim->generation = segment_end(sim, printed);
+        dataflow_start(sim->flow, sim->generation);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    padded_grid matrices[2] = {{0, 0, NULL}, {0, 0, NULL}};
     FILE * initial_configuration = NULL;
     FILE * transformation_function = NULL;
     int i, j, num_iterations=-1, tam = -1;
-    char size[MAX_CHAR];
-    char char_act;
-    char partial_input[9];
-    char partial_output; 
+    char size[MAX_CHAR], engine[MAX_CHAR];
+    char char_act, *row;
+    rule_table rule;
+    padded_rule prule;
+    bitsliced_rule brule;
+    bitsliced_grid grids[2] = {{0, 0, 0, NULL}, {0, 0, 0, NULL}};
+    int use_bitsliced = 0, binary, pattern = 0;
+    rle_reader reader;
+    state_file state = {.map = NULL};
+    simulation sim;
+    worker_job job;
+    output_pipeline output;
+    output_format format = OUTPUT_TEXT;
+    int num_workers = workers_default_count(), output_every = 1, option, status = 0, bench = 0;
+    int depth = 1, band_rows = 0, band_cols = 0, generation, use_dataflow = 0;
+    dataflow flow = {.queues = NULL};
+    double start;
     
 	//Argument check
-    if (argc != 4){
-        fprintf(stderr, "Incorrect number of arguments: try ./Cellular2DSequential "
-                        "initial_configuration transformation_function num_iterations\n");
+    while((option = getopt(argc, argv, "t:o:f:k:b:w:dB")) != -1){
+        if (option == 't') num_workers = atoi(optarg);
+        else if (option == 'o') output_every = atoi(optarg);
+        else if (option == 'f') status = output_format_parse(optarg, &format);
+        else if (option == 'k') depth = atoi(optarg);
+        else if (option == 'b') band_rows = atoi(optarg);
+        else if (option == 'w') band_cols = atoi(optarg);
+        else if (option == 'd') use_dataflow = 1;
+        else if (option == 'B') bench = 1;
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 3 || num_workers < 1 || output_every < 0 || depth < 1 || band_rows < 0
+        || band_cols < 0 || (use_dataflow && depth > 1)){
+        fprintf(stderr, "Incorrect number of arguments: try ./Cellular2DSequential [-t threads] [-o output_every] "
+                        "[-f format] [-k generations] [-b band_rows] [-w band_cols] [-d] [-B] "
+                        "initial_configuration transformation_function num_iterations\n"
+                        "  -t N  number of threads (default: one per processor)\n"
+                        "  -o N  print the matrices every N generations (default 1, 0 = never)\n"
+                        "  -f F  format of the printed matrices: text (default) or rle\n"
+                        "  -k N  temporal tiling: compute up to N generations of a band of rows while it is\n"
+                        "        in the cache (default 1 = off)\n"
+                        "  -b N  rows of a band with -k (default: as many as fit in %d KB)\n"
+                        "  -w N  columns of a tile of a band with -k (default: whole rows if they fit,\n"
+                        "        or tiles about as tall as wide)\n"
+                        "  -d    dataflow scheduler: every tile goes to the next generation as soon as its\n"
+                        "        neighbors are there, with no barrier in between (not with -k)\n"
+                        "  -B    report the wall time of the generations on stderr (see benchmark.sh)\n"
+                        "The initial configuration can be a text file, an RLE pattern or a binary state file\n",
+                BAND_BYTES / 1024);
         return EXIT_FAILURE;
     }
 
-    num_iterations = atoi(argv[3]);
+    num_iterations = atoi(argv[optind+2]);
     if (num_iterations<0){
         fprintf(stderr, "The number of iterations must be > 0\n");
         return EXIT_FAILURE;
     }
     
-    initial_configuration = fopen (argv[1], "r");
-    transformation_function = fopen(argv[2], "r");
+    initial_configuration = fopen (argv[optind], "r");
+    transformation_function = fopen(argv[optind+1], "r");
 
     if (!initial_configuration || !transformation_function){
         fprintf(stderr, "Files do not exist or could not be opened\n");
-        program_destroy(tam, matrix, result_matrix, transformation_function, initial_configuration);
+        program_destroy(matrices, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
+
+    //the transformation function is read only once, as a lookup table
+    if (rule_table_load(&rule, transformation_function, RULE_2D_INPUTS) != 0){
+        program_destroy(matrices, transformation_function, initial_configuration);
         return EXIT_FAILURE;
     }
 
-    fgets(size, MAX_CHAR, initial_configuration);
-    tam = atoi(size);
+    /**
+     * a binary state file is mapped and its packed rows are used in place,
+     * a text configuration is read cell by cell and an RLE pattern run by
+     * run, at the top left corner of a square as large as its longest side
+     * */
+    binary = state_is_binary(initial_configuration);
+    if (binary){
+        if (state_map(&state, initial_configuration, argv[optind]) != 0){
+            rule_table_destroy(&rule);
+            program_destroy(matrices, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+        if (state.header.rule_id != 0 && state.header.rule_id != state_rule_id(&rule))
+            fprintf(stderr, "Warning: %s was saved with another transformation function\n", argv[optind]);
+        tam = (state.header.rows == state.header.cols && state.header.cols <= INT_MAX)
+              ? (int) state.header.cols : -1;
+    } else if ((pattern = rle_is_rle(initial_configuration))){
+        tam = -1;
+        if (rle_reader_open(&reader, initial_configuration, argv[optind]) == 0)
+            tam = (reader.width > INT_MAX || reader.height > INT_MAX) ? -1
+                  : (int) ((reader.width > reader.height) ? reader.width : reader.height);
+    } else {
+        fgets(size, MAX_CHAR, initial_configuration);
+        tam = atoi(size);
+    }
     if (tam<1){
         fprintf(stderr, "Not valid size of the matrix\n");
-        program_destroy(tam, matrix, result_matrix, transformation_function, initial_configuration);
+        state_unmap(&state);
+        rule_table_destroy(&rule);
+        program_destroy(matrices, transformation_function, initial_configuration);
         return EXIT_FAILURE;
     }
 
-    //memory allocation for input matrix
-    matrix = (char **) calloc (sizeof(char*), tam);
-    for (i=0;i<tam;i++)
-        matrix[i] = (char *) calloc (tam, sizeof(char));
+    /**
+     * memory allocation for input matrix, a single buffer with a ghost
+     * border (see padded.h); the output one is only needed if the rule is
+     * looked up in the table
+     * */
+    if (padded_grid_create(&matrices[0], tam) != 0){
+        fprintf(stderr, "Not enough memory for the matrix\n");
+        state_unmap(&state);
+        rule_table_destroy(&rule);
+        program_destroy(matrices, transformation_function, initial_configuration);
+        return EXIT_FAILURE;
+    }
 
-    
-    //read input matrix from file
-    for(i=0; i<tam; i++){
+    //read input matrix from file (a state file is unpacked below)
+    for(i=0; i<tam && pattern; i++){
+        if (rle_read_row(&reader, 0, tam, padded_grid_row(&matrices[0], i)) != 0){
+            rule_table_destroy(&rule);
+            program_destroy(matrices, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+    }
+    for(i=0; i<tam && !binary && !pattern; i++){
+        row = padded_grid_row(&matrices[0], i);
         for(j=0; j<tam; j++){
             do{
                 char_act = fgetc(initial_configuration);
             } while (char_act != '0' && char_act != '1' && char_act != EOF);
             
             if(char_act != EOF){
-                matrix[i][j] = char_act;
+                row[j] = char_act;
             }
 
-            if (matrix[i][j] != '0' && matrix[i][j] != '1'){
+            if (row[j] != '0' && row[j] != '1'){
                 fprintf(stderr, "Initial configuration contains non-boolean value\n");
-                program_destroy(tam, matrix, result_matrix, transformation_function, initial_configuration);
+                rule_table_destroy(&rule);
+                program_destroy(matrices, transformation_function, initial_configuration);
                 return EXIT_FAILURE;
             }
         }
     }
     
-    //memory allocation for output matrix
-    result_matrix = (char **) calloc (tam, sizeof(char*));
-    for (i=0;i<tam;i++)
-        result_matrix[i] = (char *) calloc (tam, sizeof(char));
-    
     /**
-     * insert in each cell of result_matrix the result of the function of each cell and its
-     * 8 surrounding cells
+     * outer-totalistic rules (like the Game of Life) are computed with the
+     * bit-sliced kernel, 64 cells per word. Any other rule is looked up cell
+     * by cell in the table
      * */
-    partial_input[9] = '\0';
-    while(num_iterations>0){
-        for(i=0; i<tam; i++){        
-            for(j=0; j<tam; j++){
-                partial_input[0] = matrix[module(i-1, tam)][module(j-1, tam)];
-                partial_input[1] = matrix[module(i-1, tam)][module(j, tam)];
-                partial_input[2] = matrix[module(i-1, tam)][module(j+1, tam)];
-
-                partial_input[3] = matrix[module(i, tam)][module(j-1, tam)];
-                partial_input[4] = matrix[module(i, tam)][module(j, tam)];
-                partial_input[5] = matrix[module(i, tam)][module(j+1, tam)];
-
-                partial_input[6] = matrix[module(i+1, tam)][module(j-1, tam)];
-                partial_input[7] = matrix[module(i+1, tam)][module(j, tam)];
-                partial_input[8] = matrix[module(i+1, tam)][module(j+1, tam)];
-
-                result_matrix[i][j] = transform(partial_input, transformation_function);
-            }
+    if (bitsliced_rule_init(&brule, &rule) == 0){
+        if (bitsliced_grid_create(&grids[0], tam) != 0 || bitsliced_grid_create(&grids[1], tam) != 0){
+            fprintf(stderr, "Not enough memory for the bit-sliced grids\n");
+            bitsliced_grid_destroy(&grids[0]);
+            bitsliced_grid_destroy(&grids[1]);
+            state_unmap(&state);
+            rule_table_destroy(&rule);
+            program_destroy(matrices, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
         }
+        for(i=0; i<tam; i++){
+            if (binary) bitsliced_grid_set_packed_row(&grids[0], i, state_row(&state, i));
+            else bitsliced_grid_set_row(&grids[0], i, padded_grid_row(&matrices[0], i));
+        }
+        bitsliced_refresh_border(&grids[0]);
+        use_bitsliced = 1;
+        padded_grid_destroy(&matrices[0]);
+    } else {
+        if (padded_grid_create(&matrices[1], tam) != 0){
+            fprintf(stderr, "Not enough memory for the matrix\n");
+            state_unmap(&state);
+            rule_table_destroy(&rule);
+            program_destroy(matrices, transformation_function, initial_configuration);
+            return EXIT_FAILURE;
+        }
+        for(i=0; i<tam && binary; i++) state_get_cells(&state, i, 0, tam, padded_grid_row(&matrices[0], i));
+        padded_refresh_border(&matrices[0]);
+        padded_rule_init(&prule, &rule);
+    }
+    state_unmap(&state);
 
-        //print input matrix (for debugging purposes)
-        printf("----->IT %d\nINPUT MATRIX:\n", num_iterations);
-        for (i=0; i<tam; i++){
-            for(j=0; j<tam; j++) printf("%c", matrix[i][j]);
-	printf("\n");
+    /**
+     * the generations are computed by a team of threads, each of them
+     * owning a range of rows of the matrix
+     * */
+    sim.prule = &prule;
+    sim.brule = use_bitsliced ? &brule : NULL;
+    sim.matrices = matrices;
+    sim.grids = grids;
+    sim.tile_cols = use_bitsliced ? TILE_WORDS : TILE_COLS;
+    sim.cols = use_bitsliced ? bitsliced_cell_words(&grids[0]) : tam;
+    sim.tam = tam;
+    sim.num_iterations = num_iterations;
+    sim.output = &output;
+    sim.output_every = output_every;
+    sim.depth = depth;
+    sim.generation = 0;
+    sim.flow = NULL;
+    job.num_workers = num_workers;
+    job.num_generations = num_iterations;
+    job.publish_every = output_every;
+    job.step = simulation_step;
+    job.publish = simulation_publish;
+    job.state = &sim;
+
+    //with temporal tiling the workers count passes, and the generation is followed after every one of them
+    if (depth > 1){
+        if (bands_create(&sim, num_workers, band_rows, band_cols) != 0){
+            fprintf(stderr, "Not enough memory for the bands\n");
+            status = -1;
         }
-	
-        
-        //print output matrix (for debugging purposes)
-        printf("OUTPUT MATRIX:\n");
-        for (i=0; i<tam; i++){
-            for(j=0; j<tam; j++) printf("%c", result_matrix[i][j]);
-	printf("\n");
+        for(job.num_generations=0, generation=0; generation<num_iterations; job.num_generations++)
+            generation = pass_end(&sim, generation);
+        job.publish_every = 1;
+        job.step = simulation_step_bands;
+    }
+
+    /**
+     * the matrix is split in tiles, and a tile is only computed if it or
+     * one of its neighbors changed in the last two generations
+     * */
+    if (active_map_create(&sim.active, (tam + TILE_ROWS - 1) / TILE_ROWS,
+                          (sim.cols + sim.tile_cols - 1) / sim.tile_cols) != 0){
+        fprintf(stderr, "Not enough memory for the active map\n");
+        status = -1;
+    }
+
+    //with the dataflow scheduler the workers count segments, which end at the generations printed
+    if (status == 0 && use_dataflow){
+        if (dataflow_create(&flow, sim.active.rows, sim.active.cols, num_workers, simulation_tile, &sim) != 0){
+            fprintf(stderr, "Not enough memory for the dataflow scheduler\n");
+            status = -1;
+        } else {
+            for(job.num_generations=0, generation=0; generation<num_iterations; job.num_generations++)
+                generation = segment_end(&sim, generation);
+            job.publish_every = 1;
+            job.step = simulation_step_dataflow;
+            sim.flow = &flow;
+            sim.generation = segment_end(&sim, 0);
+            dataflow_start(&flow, sim.generation);
         }
+    }
 
-        //output matrix becomes the new input matrix for next iteration
-        for(i=0; i<tam; i++){
-            for(j=0; j<tam; j++){
-                matrix[i][j] = result_matrix[i][j];
-            }
+    //the matrices are printed by a thread of their own, while the workers go on
+    if (status == 0 && output_every > 0
+        && output_open(&output, stdout, format, "01", OUTPUT_FRAMES, (size_t)tam * tam) != 0){
+        fprintf(stderr, "Not enough memory for the output queue\n");
+        status = -1;
+    }
+    if (status == 0){
+        start = bench_now();
+        workers_run(&job);
+        if (output_every > 0 && output_close(&output) != 0){
+            fprintf(stderr, "The output could not be written\n");
+            status = -1;
         }
-        num_iterations--;
+        snprintf(engine, sizeof engine, "Cellular2D-Sequential/%s%s", use_bitsliced ? "bitsliced" : "table",
+                 (depth > 1) ? "-temporal" : use_dataflow ? "-dataflow" : "");
+        if (bench) bench_report(engine, (unsigned long long)tam * tam, num_iterations, 1, num_workers, bench_now() - start);
     }
+    if (depth > 1) bands_destroy(&sim, num_workers);
+    dataflow_destroy(&flow);
 
     //free resouces
-    program_destroy(tam, matrix, result_matrix, transformation_function, initial_configuration);
+    active_map_destroy(&sim.active);
+    bitsliced_grid_destroy(&grids[0]);
+    bitsliced_grid_destroy(&grids[1]);
+    rule_table_destroy(&rule);
+    program_destroy(matrices, transformation_function, initial_configuration);
 
-    return EXIT_SUCCESS;
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 
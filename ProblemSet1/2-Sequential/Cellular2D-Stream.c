@@ -0,0 +1,303 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include "functions.h"
+#include "bitsliced.h"
+#include "state.h"
+#include "bench.h"
+
+#define DEFAULT_BAND_ROWS 1024  //rows written per band
+#define DEFAULT_PASS_GENERATIONS 8  //generations computed per pass over the file
+#define TMP_SUFFIX ".tmp"
+
+/**
+ * Out-of-core simulation: the matrix stays in binary state files and only
+ * a band of rows is in memory at a time. Every pass reads the state file
+ * from the first row to the last and writes the state some generations
+ * later into a new one, so that both files are accessed sequentially.
+ * To compute g generations of a band, it is loaded with g more rows above
+ * and below it (wrapping around the torus, like the deep ghost cells of
+ * the parallel engine): each generation is valid on one row less on each
+ * side, and after g of them the band itself is complete
+ * */
+typedef struct {
+    const rule_table* rule;
+    const bitsliced_rule* brule;  //NULL if the rule is looked up in the table
+    int tam;
+    int band_rows;
+    bitsliced_grid windows[2];    //band with its extra rows, as input and output of a generation
+    uint64_t* packed;             //row being written
+} stream;
+
+/**
+ * Reads bit of a stored row
+ * */
+static inline int get_bit(const uint64_t* words, int bit){
+    return (words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+/**
+ * Computes the rows first_row..last_row-1 of the band in into out by
+ * looking up every cell and its 8 surrounding cells in the transformation
+ * function. The ghost cells of out have to be refreshed afterwards, as
+ * with the bit-sliced kernel
+ * */
+void step_band_table(const rule_table* rule, const bitsliced_grid* in, bitsliced_grid* out,
+                     int first_row, int last_row){
+    const uint64_t *up, *cur, *down;
+    uint64_t* dst;
+    int r, j, index;
+
+    for(r=first_row+1; r<=last_row; r++){
+        up = in->words + (size_t)(r-1) * in->row_words + 1;
+        cur = up + in->row_words;
+        down = cur + in->row_words;
+        dst = out->words + (size_t)r * out->row_words + 1;
+        memset(dst, 0, sizeof(uint64_t) * out->data_words);
+        //cell j is stored bit j+1, so its neighbors are the bits j..j+2
+        for(j=0; j<in->tam; j++){
+            index = get_bit(up, j) << 8   | get_bit(up, j+1) << 7   | get_bit(up, j+2) << 6
+                  | get_bit(cur, j) << 5  | get_bit(cur, j+1) << 4  | get_bit(cur, j+2) << 3
+                  | get_bit(down, j) << 2 | get_bit(down, j+1) << 1 | get_bit(down, j+2);
+            dst[(j+1) / WORD_BITS] |= (uint64_t)CELL_BIT(rule->outputs[index]) << ((j+1) % WORD_BITS);
+        }
+    }
+}
+
+/**
+ * Allocates the bands for bands of band_rows rows computed generations
+ * generations at a time. Returns 0 on success and -1 if there is not
+ * enough memory
+ * */
+int stream_create(stream* s, const rule_table* rule, const bitsliced_rule* brule, int tam, int band_rows,
+                  int generations){
+    s->rule = rule;
+    s->brule = brule;
+    s->tam = tam;
+    s->band_rows = band_rows;
+    s->windows[0].words = s->windows[1].words = NULL;
+    s->packed = (uint64_t*) calloc (sizeof(uint64_t), (tam + WORD_BITS - 1) / WORD_BITS);
+    if (!s->packed || bitsliced_band_create(&s->windows[0], tam, band_rows + 2*generations) != 0
+        || bitsliced_band_create(&s->windows[1], tam, band_rows + 2*generations) != 0){
+        bitsliced_grid_destroy(&s->windows[0]);
+        bitsliced_grid_destroy(&s->windows[1]);
+        free(s->packed);
+        return -1;
+    }
+    return 0;
+}
+
+void stream_destroy(stream* s){
+    bitsliced_grid_destroy(&s->windows[0]);
+    bitsliced_grid_destroy(&s->windows[1]);
+    free(s->packed);
+}
+
+/**
+ * Row of the torus at the given distance (maybe negative or past the end)
+ * from row 0
+ * */
+static inline uint64_t wrap_row(long long row, int tam){
+    return (uint64_t)(((row % tam) + tam) % tam);
+}
+
+/**
+ * Computes generations generations of the mapped state in and writes the
+ * result into the state file path, band by band. The rows of the next band
+ * are read ahead while a band is computed, and the ones already used are
+ * let go, so the pages of the input do not pile up in memory.
+ * Returns 0 on success and -1 otherwise
+ * */
+int stream_pass(stream* s, const state_file* in, const char* path, int generations){
+    state_writer w;
+    bitsliced_grid* window;
+    int first, rows, height, i, g, status = 0;
+
+    if (state_writer_open(&w, path, s->tam, s->tam, in->header.generation + generations, s->rule) != 0)
+        return -1;
+
+    for(first=0; first<s->tam && status == 0; first+=s->band_rows){
+        rows = (first + s->band_rows < s->tam) ? s->band_rows : s->tam - first;
+        height = rows + 2*generations;
+        //the rows of the next band that are not in this one
+        state_prefetch_rows(in, first + rows + generations, s->band_rows);
+
+        for(i=0; i<height; i++)
+            bitsliced_grid_set_packed_row(&s->windows[0], i,
+                                          state_row(in, wrap_row((long long)first - generations + i, s->tam)));
+        bitsliced_refresh_cols(&s->windows[0], 0, height);
+
+        //generation g is valid from row g to row height-g-1 of the window
+        for(g=1; g<=generations; g++){
+            if (s->brule)
+                bitsliced_step_rows(s->brule, &s->windows[(g-1) % 2], &s->windows[g % 2], g, height - g);
+            else
+                step_band_table(s->rule, &s->windows[(g-1) % 2], &s->windows[g % 2], g, height - g);
+            bitsliced_refresh_cols(&s->windows[g % 2], g, height - g);
+        }
+
+        window = &s->windows[generations % 2];
+        for(i=0; i<rows && status == 0; i++){
+            bitsliced_grid_get_packed_row(window, generations + i, s->packed);
+            status = state_writer_put_words(&w, s->packed);
+        }
+        if (first >= generations) state_release_rows(in, first - generations, rows);
+    }
+
+    if (state_writer_close(&w) != 0) status = -1;
+    return status;
+}
+
+/**
+ * Maps the state file path, which must hold a square matrix. Returns its
+ * file on success and NULL otherwise
+ * */
+FILE* open_state(const char* path, state_file* state){
+    FILE* f = fopen(path, "rb");
+
+    if (!f){
+        fprintf(stderr, "%s does not exist or could not be opened\n", path);
+        return NULL;
+    }
+    if (!state_is_binary(f)){
+        fprintf(stderr, "%s is not a binary state file (see Cellular2D-Convert)\n", path);
+        fclose(f);
+        return NULL;
+    }
+    if (state_map(state, f, path) != 0){
+        fclose(f);
+        return NULL;
+    }
+    if (state->header.rows != state->header.cols || state->header.cols > INT_MAX){
+        fprintf(stderr, "%s: not valid size of the matrix\n", path);
+        state_unmap(state);
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+int main(int argc, char *argv[]) {
+    FILE * input = NULL;
+    FILE * transformation_function = NULL;
+    int num_iterations, done, generations, tam, option, status = 0, bench = 0;
+    int band_rows = DEFAULT_BAND_ROWS, pass_generations = DEFAULT_PASS_GENERATIONS;
+    char tmp_path[FILENAME_MAX];
+    double start;
+    rule_table rule;
+    bitsliced_rule brule;
+    state_file state;
+    stream s;
+
+    //Argument check
+    while((option = getopt(argc, argv, "b:k:B")) != -1){
+        if (option == 'b') band_rows = atoi(optarg);
+        else if (option == 'k') pass_generations = atoi(optarg);
+        else if (option == 'B') bench = 1;
+        else status = -1;
+    }
+    if (status != 0 || argc - optind != 4 || band_rows < 1 || pass_generations < 1){
+        fprintf(stderr, "Incorrect arguments: try ./Cellular2D-Stream [-b band_rows] [-k generations] [-B] "
+                        "initial_state transformation_function num_iterations final_state\n"
+                        "The matrix is kept in binary state files (see Cellular2D-Convert) and streamed\n"
+                        "through memory a band of rows at a time, so it does not have to fit in memory\n"
+                        "  -b N  rows of a band (default %d)\n"
+                        "  -k N  generations computed in every pass over the file (default %d)\n"
+                        "  -B    report the wall time of the passes on stderr (see benchmark.sh)\n",
+                        DEFAULT_BAND_ROWS, DEFAULT_PASS_GENERATIONS);
+        return EXIT_FAILURE;
+    }
+
+    num_iterations = atoi(argv[optind+2]);
+    if (num_iterations < 1){
+        fprintf(stderr, "The number of iterations must be > 0\n");
+        return EXIT_FAILURE;
+    }
+    if (snprintf(tmp_path, sizeof tmp_path, "%s" TMP_SUFFIX, argv[optind+3]) >= (int) sizeof tmp_path){
+        fprintf(stderr, "%s: name too long\n", argv[optind+3]);
+        return EXIT_FAILURE;
+    }
+
+    transformation_function = fopen(argv[optind+1], "r");
+    if (!transformation_function){
+        fprintf(stderr, "%s does not exist or could not be opened\n", argv[optind+1]);
+        return EXIT_FAILURE;
+    }
+    status = rule_table_load(&rule, transformation_function, RULE_2D_INPUTS);
+    fclose(transformation_function);
+    if (status != 0) return EXIT_FAILURE;
+
+    input = open_state(argv[optind], &state);
+    if (!input){
+        rule_table_destroy(&rule);
+        return EXIT_FAILURE;
+    }
+    if (state.header.rule_id != 0 && state.header.rule_id != state_rule_id(&rule))
+        fprintf(stderr, "Warning: %s was saved with another transformation function\n", argv[optind]);
+    tam = (int) state.header.cols;
+
+    //outer-totalistic rules are computed with the bit-sliced kernel, any other one with the table
+    if (band_rows > tam) band_rows = tam;
+    if (pass_generations > num_iterations) pass_generations = num_iterations;
+    if (stream_create(&s, &rule, (bitsliced_rule_init(&brule, &rule) == 0) ? &brule : NULL,
+                      tam, band_rows, pass_generations) != 0){
+        fprintf(stderr, "Not enough memory for bands of %d rows\n", band_rows);
+        state_unmap(&state);
+        fclose(input);
+        rule_table_destroy(&rule);
+        return EXIT_FAILURE;
+    }
+
+    /**
+     * every pass writes a temporary file that then replaces the final one,
+     * which is the input of the next pass
+     * */
+    start = bench_now();
+    for(done=0; done<num_iterations && status == 0; done+=generations){
+        generations = (num_iterations - done < pass_generations) ? num_iterations - done : pass_generations;
+        status = stream_pass(&s, &state, tmp_path, generations);
+        state_unmap(&state);
+        fclose(input);
+        input = NULL;
+        if (status == 0 && rename(tmp_path, argv[optind+3]) != 0){
+            fprintf(stderr, "%s could not be renamed to %s\n", tmp_path, argv[optind+3]);
+            status = -1;
+        }
+        if (status == 0 && done + generations < num_iterations){
+            input = open_state(argv[optind+3], &state);
+            if (!input) status = -1;
+        }
+    }
+    if (status != 0) remove(tmp_path);
+    else if (bench)
+        bench_report(s.brule ? "Cellular2D-Stream/bitsliced" : "Cellular2D-Stream/table",
+                     (unsigned long long)tam * tam, num_iterations, 1, 1, bench_now() - start);
+
+    stream_destroy(&s);
+    rule_table_destroy(&rule);
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+#include "active.h"
+
+/**
+ * Creates a map of rows x cols tiles, all of them marked as changed so that
+ * the first generation is computed everywhere.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int active_map_create(active_map* map, int rows, int cols){
+    size_t tiles = (size_t)rows * cols;
+
+    map->rows = rows;
+    map->cols = cols;
+    map->changed[0] = (unsigned char*) malloc (tiles);
+    map->changed[1] = (unsigned char*) calloc (sizeof(unsigned char), tiles);
+    if (!map->changed[0] || !map->changed[1]){
+        active_map_destroy(map);
+        return -1;
+    }
+    memset(map->changed[0], 1, tiles);
+    return 0;
+}
+
+void active_map_destroy(active_map* map){
+    if (map->changed[0]) free(map->changed[0]);
+    if (map->changed[1]) free(map->changed[1]);
+    map->changed[0] = map->changed[1] = NULL;
+}
+
+/**
+ * Returns 1 if tile (r, c) has to be computed in the step that goes from
+ * the given generation to the next one, and 0 if it is going to be the
+ * same as in the generation before
+ * */
+int active_tile_needed(const active_map* map, int generation, int r, int c){
+    const unsigned char* changed = map->changed[generation % 2];
+    int dr, dc, row, col;
+
+    for(dr=-1; dr<=1; dr++){
+        row = (r + dr + map->rows) % map->rows;
+        for(dc=-1; dc<=1; dc++){
+            col = (c + dc + map->cols) % map->cols;
+            if (changed[(size_t)row * map->cols + col]) return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Records whether tile (r, c) of the generation after the given one is
+ * different from the generation before it. The first generation computed
+ * has nothing to be compared with, so all its tiles count as changed
+ * */
+void active_tile_set(active_map* map, int generation, int r, int c, int changed){
+    map->changed[1 - generation % 2][(size_t)r * map->cols + c] = (unsigned char) (changed || generation == 0);
+}
@@ -0,0 +1,45 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef ACTIVE_H
+#define ACTIVE_H
+
+/**
+ * Grid of rows x cols tiles that remembers which tiles are different from
+ * what they were two generations before. If neither a tile nor any of its
+ * 8 neighbors (the map is a torus too) changed, the tile is going to be
+ * what it was the generation before, which is already in the buffer it is
+ * written to. Still lifes and period 2 oscillators, which make most of the
+ * ash of the Game of Life, are skipped that way. changed[g%2] tells the
+ * tiles that changed to reach generation g, and the step that computes
+ * generation g+1 fills changed[1-g%2]. Several threads can fill the flags
+ * of different tiles at the same time
+ * */
+typedef struct {
+    int rows, cols;
+    unsigned char* changed[2];
+} active_map;
+
+int active_map_create(active_map* map, int rows, int cols);
+void active_map_destroy(active_map* map);
+int active_tile_needed(const active_map* map, int generation, int r, int c);
+void active_tile_set(active_map* map, int generation, int r, int c, int changed);
+
+#endif
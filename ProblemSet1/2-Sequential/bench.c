@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+#include "bench.h"
+
+/**
+ * Wall clock time in seconds, from a monotonic clock: unlike clock(),
+ * which adds up the processor time of the process, it also counts the
+ * time spent waiting and is not changed by adjustments of the date. The
+ * MPI engines use MPI_Wtime instead
+ * */
+double bench_now(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+/**
+ * Writes to stderr the result of a run of generations generations of a
+ * lattice of cells cells that took seconds seconds, as the single line
+ * that benchmark.sh collects:
+ *   BENCH engine=E cells=C generations=G processes=P threads=T seconds=S cell_updates_per_second=U
+ * */
+void bench_report(const char* engine, unsigned long long cells, unsigned long long generations,
+                  int processes, int threads, double seconds){
+    fprintf(stderr, "BENCH engine=%s cells=%llu generations=%llu processes=%d threads=%d seconds=%.6f "
+                    "cell_updates_per_second=%.6e\n", engine, cells, generations, processes, threads, seconds,
+            (seconds > 0) ? (double) cells * (double) generations / seconds : 0.0);
+}
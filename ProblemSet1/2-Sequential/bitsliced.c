@@ -0,0 +1,505 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include "bitsliced.h"
+
+#define BITSLICED_ALIGN 64
+
+/**
+ * Bits of diff, the changes in word w of a stored row, that belong to
+ * cells of the matrix and not to ghost cells or padding
+ * */
+static inline uint64_t cell_changes(const bitsliced_grid* grid, int w, uint64_t diff){
+    int last_cell = grid->tam / WORD_BITS + 1;
+
+    if (w == 1) diff &= ~(uint64_t)1;
+    if (w == last_cell) diff &= ((uint64_t)2 << (grid->tam % WORD_BITS)) - 1;
+    return (w <= last_cell) ? diff : 0;
+}
+
+/**
+ * Scalar copy of the kernel, valid for every machine
+ * */
+#define KERNEL_VEC uint64_t
+#define KERNEL_LANES 1
+#define KERNEL_TARGET
+#define KERNEL_CHUNK step_chunk_scalar
+#define KERNEL_ROWS step_rows_scalar
+#include "bitsliced_kernel.h"
+#undef KERNEL_VEC
+#undef KERNEL_LANES
+#undef KERNEL_TARGET
+#undef KERNEL_CHUNK
+#undef KERNEL_ROWS
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITSLICED_X86
+
+/**
+ * SSE2 copy: 128 cells per operation
+ * */
+typedef uint64_t vec_sse2 __attribute__((vector_size(16)));
+#define KERNEL_VEC vec_sse2
+#define KERNEL_LANES 2
+#define KERNEL_TARGET __attribute__((target("sse2")))
+#define KERNEL_CHUNK step_chunk_sse2
+#define KERNEL_ROWS step_rows_sse2
+#include "bitsliced_kernel.h"
+#undef KERNEL_VEC
+#undef KERNEL_LANES
+#undef KERNEL_TARGET
+#undef KERNEL_CHUNK
+#undef KERNEL_ROWS
+
+/**
+ * AVX2 copy: 256 cells per operation
+ * */
+typedef uint64_t vec_avx2 __attribute__((vector_size(32)));
+#define KERNEL_VEC vec_avx2
+#define KERNEL_LANES 4
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#define KERNEL_CHUNK step_chunk_avx2
+#define KERNEL_ROWS step_rows_avx2
+#include "bitsliced_kernel.h"
+#undef KERNEL_VEC
+#undef KERNEL_LANES
+#undef KERNEL_TARGET
+#undef KERNEL_CHUNK
+#undef KERNEL_ROWS
+#endif
+
+typedef uint64_t (*step_rows_function)(const bitsliced_rule*, const bitsliced_grid*, bitsliced_grid*,
+                                       int, int, int, int);
+
+static step_rows_function step_rows = NULL;
+static const char* step_rows_name = NULL;
+
+/**
+ * Picks the widest copy of the kernel supported by the processor
+ * running the program. Only done once
+ * */
+static void select_kernel(void){
+    if (step_rows) return;
+#ifdef BITSLICED_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")){
+        step_rows = step_rows_avx2;
+        step_rows_name = "avx2";
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")){
+        step_rows = step_rows_sse2;
+        step_rows_name = "sse2";
+        return;
+    }
+#endif
+    step_rows = step_rows_scalar;
+    step_rows_name = "scalar";
+}
+
+/**
+ * Name of the instruction set used by the kernel ("avx2", "sse2" or "scalar")
+ * */
+const char* bitsliced_kernel_name(void){
+    select_kernel();
+    return step_rows_name;
+}
+
+/**
+ * Builds the terms of the kernel from a 2D lookup table (and picks the
+ * kernel, so that threads stepping the grid later only read the choice).
+ * Returns 0 on success and -1 if the table is not outer-totalistic
+ * */
+int bitsliced_rule_init(bitsliced_rule* brule, const rule_table* table){
+    int birth, survive, n, b;
+    bitsliced_term* term;
+
+    if (!rule_table_outer_totalistic(table, &birth, &survive)) return -1;
+    select_kernel();
+
+    brule->num_terms = 0;
+    for(n=0; n<=8; n++){
+        if (!((birth | survive) & (1 << n))) continue;
+        term = &brule->terms[brule->num_terms++];
+        for(b=0; b<4; b++)
+            term->count_masks[b] = ((n >> b) & 1) ? ~(uint64_t)0 : 0;
+        term->birth = ((birth >> n) & 1) ? ~(uint64_t)0 : 0;
+        term->survive = ((survive >> n) & 1) ? ~(uint64_t)0 : 0;
+    }
+    return 0;
+}
+
+/**
+ * Allocates a tam x tam grid with all cells 0.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int bitsliced_grid_create(bitsliced_grid* grid, int tam){
+    return bitsliced_band_create(grid, tam, tam);
+}
+
+/**
+ * Bytes of a stored row of a grid (or band) of tam columns: the words of
+ * its cells and ghost cells, and a pad word on each side, rounded so that
+ * every row starts on a cache line
+ * */
+size_t bitsliced_row_bytes(int tam){
+    int words = (tam + 2 + WORD_BITS - 1) / WORD_BITS + 2;
+
+    return sizeof(uint64_t) * ((words + 7) / 8 * 8);
+}
+
+/**
+ * Allocates a band of rows rows of a tam x tam grid, with all cells 0.
+ * Only the ghost cells of its rows are kept (see bitsliced_refresh_cols):
+ * the rows above and below the band are not part of it.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int bitsliced_band_create(bitsliced_grid* grid, int tam, int rows){
+    size_t bytes;
+
+    grid->tam = tam;
+    grid->data_words = (tam + 2 + WORD_BITS - 1) / WORD_BITS;
+    grid->row_words = (int) (bitsliced_row_bytes(tam) / sizeof(uint64_t));
+
+    bytes = sizeof(uint64_t) * (size_t)grid->row_words * (rows + 2);
+    grid->words = (uint64_t*) aligned_alloc(BITSLICED_ALIGN, bytes);
+    if (!grid->words) return -1;
+    memset(grid->words, 0, bytes);
+    return 0;
+}
+
+void bitsliced_grid_destroy(bitsliced_grid* grid){
+    if (grid->words) free(grid->words);
+    grid->words = NULL;
+}
+
+/**
+ * Stores the tam '0'/'1' characters of cells as row of the matrix.
+ * The ghost cells are only updated by bitsliced_refresh_border
+ * */
+void bitsliced_grid_set_row(bitsliced_grid* grid, int row, const char* cells){
+    uint64_t* words = grid->words + (size_t)(row + 1) * grid->row_words + 1;
+    int j, bit;
+
+    memset(words, 0, sizeof(uint64_t) * grid->data_words);
+    for(j=0; j<grid->tam; j++){
+        bit = j + 1;
+        words[bit / WORD_BITS] |= (uint64_t)CELL_BIT(cells[j]) << (bit % WORD_BITS);
+    }
+}
+
+/**
+ * Stores as row of the matrix the tam cells packed in words, cell j being
+ * bit j%64 of word j/64 (the rows of a state file). They only have to be
+ * moved one bit up to leave room for the ghost cell
+ * */
+void bitsliced_grid_set_packed_row(bitsliced_grid* grid, int row, const uint64_t* packed){
+    uint64_t* words = grid->words + (size_t)(row + 1) * grid->row_words + 1;
+    int k, packed_words = (grid->tam + WORD_BITS - 1) / WORD_BITS;
+    uint64_t word, carry = 0;
+
+    for(k=0; k<grid->data_words; k++){
+        word = (k < packed_words) ? packed[k] : 0;
+        if (k == packed_words - 1 && grid->tam % WORD_BITS != 0)
+            word &= ((uint64_t)1 << (grid->tam % WORD_BITS)) - 1;
+        words[k] = (word << 1) | carry;
+        carry = word >> (WORD_BITS - 1);
+    }
+}
+
+/**
+ * Writes row of the matrix into cells as tam '0'/'1' characters
+ * */
+void bitsliced_grid_get_row(const bitsliced_grid* grid, int row, char* cells){
+    const uint64_t* words = grid->words + (size_t)(row + 1) * grid->row_words + 1;
+    int j, bit;
+
+    for(j=0; j<grid->tam; j++){
+        bit = j + 1;
+        cells[j] = '0' + ((words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1);
+    }
+}
+
+/**
+ * Writes row of the matrix into packed, cell j being bit j%64 of word
+ * j/64 and the bits after the last cell 0 (the rows of a state file)
+ * */
+void bitsliced_grid_get_packed_row(const bitsliced_grid* grid, int row, uint64_t* packed){
+    const uint64_t* words = grid->words + (size_t)(row + 1) * grid->row_words + 1;
+    int k, packed_words = (grid->tam + WORD_BITS - 1) / WORD_BITS;
+
+    for(k=0; k<packed_words; k++) packed[k] = (words[k] >> 1) | (words[k+1] << (WORD_BITS - 1));
+    if (grid->tam % WORD_BITS != 0) packed[packed_words - 1] &= ((uint64_t)1 << (grid->tam % WORD_BITS)) - 1;
+}
+
+/**
+ * Copies rows stored rows of src, from row src_row of the matrix (or of
+ * the band) on, into dst from dst_row on, ghost cells included. Both must
+ * hold rows of the same size of matrix
+ * */
+void bitsliced_copy_rows(bitsliced_grid* dst, int dst_row, const bitsliced_grid* src, int src_row, int rows){
+    memcpy(dst->words + (size_t)(dst_row + 1) * dst->row_words, src->words + (size_t)(src_row + 1) * src->row_words,
+           sizeof(uint64_t) * src->row_words * rows);
+}
+
+/**
+ * The 64 bits of a stored row that start at bit (the ones past the end of
+ * the row are pad words)
+ * */
+static inline uint64_t get_bits(const uint64_t* words, int bit){
+    int w = bit / WORD_BITS, shift = bit % WORD_BITS;
+
+    return shift ? (words[w] >> shift) | (words[w + 1] << (WORD_BITS - shift)) : words[w];
+}
+
+/**
+ * Copies count cells of row src_row of src (of the matrix or of the band),
+ * from column src_col on, into row dst_row of dst from column dst_col on.
+ * The columns go from 0 to tam-1 in each grid, and the ghost cells are not
+ * refreshed. Different rows can be copied at the same time
+ * */
+void bitsliced_copy_cells(bitsliced_grid* dst, int dst_row, int dst_col, const bitsliced_grid* src, int src_row,
+                          int src_col, int count){
+    const uint64_t* from = src->words + (size_t)(src_row + 1) * src->row_words + 1;
+    uint64_t* to = dst->words + (size_t)(dst_row + 1) * dst->row_words + 1;
+    int src_bit = src_col + 1, dst_bit = dst_col + 1, shift, bits;
+    uint64_t mask;
+
+    //one word of dst at a time
+    while (count > 0){
+        shift = dst_bit % WORD_BITS;
+        bits = (WORD_BITS - shift < count) ? WORD_BITS - shift : count;
+        mask = ((bits == WORD_BITS) ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1) << shift;
+        to[dst_bit / WORD_BITS] = (to[dst_bit / WORD_BITS] & ~mask) | ((get_bits(from, src_bit) << shift) & mask);
+        src_bit += bits;
+        dst_bit += bits;
+        count -= bits;
+    }
+}
+
+/**
+ * Stores count '0'/'1' characters of cells into each of the rows
+ * first_row..last_row-1 of the matrix (or of the band), from column col
+ * on, -1 and tam being the ghost cells. The characters of a row follow
+ * stride characters after those of the row before. Different rows can be
+ * stored at the same time
+ * */
+void bitsliced_set_cells(bitsliced_grid* grid, int first_row, int last_row, int col, const char* cells,
+                         size_t stride, int count){
+    uint64_t* words;
+    const char* from;
+    int r, bit, shift, bits, left, k;
+    uint64_t mask, value;
+
+    for(r=first_row; r<last_row; r++, cells+=stride){
+        words = grid->words + (size_t)(r + 1) * grid->row_words + 1;
+        from = cells;
+        //one word at a time
+        for(bit=col+1, left=count; left>0; bit+=bits, left-=bits, from+=bits){
+            shift = bit % WORD_BITS;
+            bits = (WORD_BITS - shift < left) ? WORD_BITS - shift : left;
+            mask = ((bits == WORD_BITS) ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1) << shift;
+            for(value=0, k=0; k<bits; k++) value |= (uint64_t)CELL_BIT(from[k]) << k;
+            words[bit / WORD_BITS] = (words[bit / WORD_BITS] & ~mask) | (value << shift);
+        }
+    }
+}
+
+/**
+ * Writes count cells of each of the rows first_row..last_row-1 of the
+ * matrix (or of the band), from column col on, into cells as '0'/'1'
+ * characters, -1 and tam being the ghost cells, a row every stride
+ * characters
+ * */
+void bitsliced_get_cells(const bitsliced_grid* grid, int first_row, int last_row, int col, char* cells,
+                         size_t stride, int count){
+    const uint64_t* words;
+    char* to;
+    int r, bit, shift, bits, left, k;
+    uint64_t value;
+
+    for(r=first_row; r<last_row; r++, cells+=stride){
+        words = grid->words + (size_t)(r + 1) * grid->row_words + 1;
+        to = cells;
+        for(bit=col+1, left=count; left>0; bit+=bits, left-=bits, to+=bits){
+            shift = bit % WORD_BITS;
+            bits = (WORD_BITS - shift < left) ? WORD_BITS - shift : left;
+            value = words[bit / WORD_BITS] >> shift;
+            for(k=0; k<bits; k++) to[k] = '0' + ((value >> k) & 1);
+        }
+    }
+}
+
+/**
+ * Returns 1 if any of count cells of the rows first_row..last_row-1 from
+ * column col on (as in bitsliced_set_cells) is different in a than in b,
+ * which have the same size
+ * */
+int bitsliced_cells_differ(const bitsliced_grid* a, const bitsliced_grid* b, int first_row, int last_row, int col,
+                           int count){
+    const uint64_t *from, *to;
+    int r, bit, shift, bits, left;
+    uint64_t mask;
+
+    for(r=first_row; r<last_row; r++){
+        from = a->words + (size_t)(r + 1) * a->row_words + 1;
+        to = b->words + (size_t)(r + 1) * b->row_words + 1;
+        for(bit=col+1, left=count; left>0; bit+=bits, left-=bits){
+            shift = bit % WORD_BITS;
+            bits = (WORD_BITS - shift < left) ? WORD_BITS - shift : left;
+            mask = ((bits == WORD_BITS) ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1) << shift;
+            if ((from[bit / WORD_BITS] ^ to[bit / WORD_BITS]) & mask) return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads bit of a stored row
+ * */
+static inline uint64_t get_bit(const uint64_t* words, int bit){
+    return (words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+/**
+ * Sets bit of a stored row to value (0 or 1)
+ * */
+static inline void set_bit(uint64_t* words, int bit, uint64_t value){
+    words[bit / WORD_BITS] = (words[bit / WORD_BITS] & ~((uint64_t)1 << (bit % WORD_BITS)))
+                             | (value << (bit % WORD_BITS));
+}
+
+/**
+ * Copies the opposite edges of the matrix rows first_row..last_row-1 into
+ * their ghost cells, so that each row wraps around, and clears the bits
+ * after the right ghost cell, where the kernel leaves garbage. Different
+ * ranges can be refreshed at the same time
+ * */
+void bitsliced_refresh_cols(bitsliced_grid* grid, int first_row, int last_row){
+    int r, tam = grid->tam;
+    int used_bits = (tam + 2) - (grid->data_words - 1) * WORD_BITS;
+    uint64_t last_mask = (used_bits == WORD_BITS) ? ~(uint64_t)0 : ((uint64_t)1 << used_bits) - 1;
+    uint64_t* words;
+
+    for(r=first_row+1; r<=last_row; r++){
+        words = grid->words + (size_t)r * grid->row_words + 1;
+        words[grid->data_words - 1] &= last_mask;
+        set_bit(words, 0, get_bit(words, tam));
+        set_bit(words, tam + 1, get_bit(words, 1));
+    }
+}
+
+/**
+ * Refreshes the ghost cells of the matrix rows first_row..last_row-1, so
+ * that the grid behaves as a torus (see bitsliced_refresh_cols). The
+ * first and last rows are also copied into the ghost rows. Different
+ * ranges can be refreshed at the same time
+ * */
+void bitsliced_refresh_rows(bitsliced_grid* grid, int first_row, int last_row){
+    int tam = grid->tam;
+
+    bitsliced_refresh_cols(grid, first_row, last_row);
+    if (first_row <= tam - 1 && tam - 1 < last_row)
+        memcpy(grid->words, grid->words + (size_t)tam * grid->row_words,
+               sizeof(uint64_t) * grid->row_words);
+    if (first_row <= 0 && 0 < last_row)
+        memcpy(grid->words + (size_t)(tam + 1) * grid->row_words, grid->words + grid->row_words,
+               sizeof(uint64_t) * grid->row_words);
+}
+
+/**
+ * Refreshes the ghost cells of the whole grid
+ * */
+void bitsliced_refresh_border(bitsliced_grid* grid){
+    bitsliced_refresh_rows(grid, 0, grid->tam);
+}
+
+/**
+ * Computes the matrix rows first_row..last_row-1 of the next generation
+ * of in into out. Several ranges can be computed at the same time; the
+ * ghost cells of out have to be refreshed (see bitsliced_refresh_rows)
+ * before out is used as the input of another step
+ * */
+void bitsliced_step_rows(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+                         int first_row, int last_row){
+    select_kernel();
+    step_rows(brule, in, out, first_row, last_row, 1, in->data_words + 1);
+}
+
+/**
+ * Copies the stored words first..last-1 of stored row src into stored row dst
+ * */
+static void copy_words(bitsliced_grid* grid, int dst, int src, int first, int last){
+    memcpy(grid->words + (size_t)dst * grid->row_words + first, grid->words + (size_t)src * grid->row_words + first,
+           sizeof(uint64_t) * (last - first));
+}
+
+/**
+ * Refreshes the ghost cells that depend on the tile of words
+ * first_word..last_word-1 of rows first_row..last_row-1 (see
+ * bitsliced_step_tile), so that the tiles of a generation can be
+ * refreshed apart instead of whole rows at a time. The tile of the last
+ * words refreshes the ghost cells of its rows, which are in the first
+ * word too, so it has to go after the tile of the first words. Each tile
+ * copies its words of the first and last rows into the ghost rows, the
+ * one of the last words also the first word and the words past the cells
+ * */
+void bitsliced_refresh_tile(bitsliced_grid* grid, int first_row, int last_row, int first_word, int last_word){
+    int tam = grid->tam, last = (last_word == bitsliced_cell_words(grid));
+
+    if (last) bitsliced_refresh_cols(grid, first_row, last_row);
+    if (first_row <= tam - 1 && tam - 1 < last_row){
+        copy_words(grid, 0, tam, first_word + 1, last ? grid->row_words : last_word + 1);
+        if (last) copy_words(grid, 0, tam, 0, 2);
+    }
+    if (first_row <= 0 && 0 < last_row){
+        copy_words(grid, tam + 1, 1, first_word + 1, last ? grid->row_words : last_word + 1);
+        if (last) copy_words(grid, tam + 1, 1, 0, 2);
+    }
+}
+
+/**
+ * Computes the whole next generation of in into out, ghost cells included
+ * */
+void bitsliced_step(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out){
+    bitsliced_step_rows(brule, in, out, 0, in->tam);
+    bitsliced_refresh_border(out);
+}
+
+/**
+ * Number of words of a stored row that hold cells of the matrix (the
+ * last one may only hold the right ghost cell, and is not counted)
+ * */
+int bitsliced_cell_words(const bitsliced_grid* grid){
+    return grid->tam / WORD_BITS + 1;
+}
+
+/**
+ * Computes the words first_word..last_word-1 (0 being the first one, see
+ * bitsliced_cell_words) of the matrix rows first_row..last_row-1 of the
+ * next generation of in into out, like bitsliced_step_rows. Returns 1 if
+ * any cell of the tile is different from what out held before (with two
+ * grids in turn, the generation before in), and 0 otherwise
+ * */
+int bitsliced_step_tile(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+                        int first_row, int last_row, int first_word, int last_word){
+    select_kernel();
+    return step_rows(brule, in, out, first_row, last_row, first_word + 1, last_word + 1) != 0;
+}
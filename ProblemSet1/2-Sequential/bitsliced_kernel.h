@@ -0,0 +1,141 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+/**
+ * Body of the bit-sliced kernel, included several times by bitsliced.c to
+ * get one copy per instruction set. Before including it, define:
+ *   KERNEL_VEC    type holding KERNEL_LANES words (uint64_t or a GCC vector)
+ *   KERNEL_LANES  number of 64-bit words in KERNEL_VEC
+ *   KERNEL_TARGET function attributes for the instruction set (may be empty)
+ *   KERNEL_CHUNK  name of the function that computes one KERNEL_VEC
+ *   KERNEL_ROWS   name of the function that computes a range of rows
+ * The scalar copy (KERNEL_LANES 1, KERNEL_CHUNK step_chunk_scalar) has to
+ * be included first, since the others use it for the words left over at
+ * the end of each row.
+ * */
+
+/**
+ * Next state of the 64*KERNEL_LANES cells starting at word w of the row
+ * cur, given the rows above and below. The 8 neighbors are added with
+ * bit-sliced full adders into a 4 bit count (c8 c4 c2 c1) that is then
+ * matched against the terms of the rule
+ * */
+KERNEL_TARGET
+static inline __attribute__((always_inline)) KERNEL_VEC KERNEL_CHUNK(const bitsliced_rule* brule,
+        const uint64_t* up, const uint64_t* cur, const uint64_t* down, int w){
+    KERNEL_VEC u, c, d, ul, ur, cl, cr, dl, dr;
+    KERNEL_VEC s_up, k_up, s_mid, k_mid, s_dn, k_dn, k_ones, x, k_x, k_y;
+    KERNEL_VEC c1, c2, c4, c8, eq, result;
+    const bitsliced_term* term;
+    int t;
+
+    //each neighbor is a shifted copy of its row, carrying one bit from the next word
+    memcpy(&u, up + w, sizeof u);
+    memcpy(&ul, up + w - 1, sizeof ul);
+    memcpy(&ur, up + w + 1, sizeof ur);
+    ul = (u << 1) | (ul >> (WORD_BITS - 1));
+    ur = (u >> 1) | (ur << (WORD_BITS - 1));
+
+    memcpy(&c, cur + w, sizeof c);
+    memcpy(&cl, cur + w - 1, sizeof cl);
+    memcpy(&cr, cur + w + 1, sizeof cr);
+    cl = (c << 1) | (cl >> (WORD_BITS - 1));
+    cr = (c >> 1) | (cr << (WORD_BITS - 1));
+
+    memcpy(&d, down + w, sizeof d);
+    memcpy(&dl, down + w - 1, sizeof dl);
+    memcpy(&dr, down + w + 1, sizeof dr);
+    dl = (d << 1) | (dl >> (WORD_BITS - 1));
+    dr = (d >> 1) | (dr << (WORD_BITS - 1));
+
+    //one adder per row (the center row only contributes two neighbors)
+    s_up = ul ^ u ^ ur;
+    k_up = (ul & u) | (ur & (ul ^ u));
+    s_mid = cl ^ cr;
+    k_mid = cl & cr;
+    s_dn = dl ^ d ^ dr;
+    k_dn = (dl & d) | (dr & (dl ^ d));
+
+    //add the three partial sums column by column
+    c1 = s_up ^ s_mid ^ s_dn;
+    k_ones = (s_up & s_mid) | (s_dn & (s_up ^ s_mid));
+    x = k_up ^ k_mid ^ k_dn;
+    k_x = (k_up & k_mid) | (k_dn & (k_up ^ k_mid));
+    c2 = x ^ k_ones;
+    k_y = x & k_ones;
+    c4 = k_x ^ k_y;
+    c8 = k_x & k_y;
+
+    result = c ^ c;
+    for(t=0; t<brule->num_terms; t++){
+        term = &brule->terms[t];
+        eq = ~((c1 ^ term->count_masks[0]) | (c2 ^ term->count_masks[1])
+             | (c4 ^ term->count_masks[2]) | (c8 ^ term->count_masks[3]));
+        result |= eq & ((c & term->survive) | (~c & term->birth));
+    }
+    return result;
+}
+
+/**
+ * Computes the words first_word..last_word-1 (counting the pad word, so
+ * the first word of a row is 1) of the matrix rows first_row..last_row-1
+ * of the next generation of in into out. Returns the bits of the cells
+ * that are different from what out held before; the ghost cells of out
+ * are neither updated nor compared
+ * */
+KERNEL_TARGET
+static uint64_t KERNEL_ROWS(const bitsliced_rule* brule, const bitsliced_grid* in, bitsliced_grid* out,
+                            int first_row, int last_row, int first_word, int last_word){
+    const uint64_t *up, *cur, *down;
+    uint64_t* dst;
+    uint64_t word, changes = 0, lanes[KERNEL_LANES];
+    KERNEL_VEC chunk, old, diff, vec_changes;
+    int r, w, l, last_cell = in->tam / WORD_BITS + 1; //word holding the last cell of a row
+
+    memset(&vec_changes, 0, sizeof vec_changes);
+    for(r=first_row+1; r<=last_row; r++){
+        up = in->words + (size_t)(r-1) * in->row_words;
+        cur = up + in->row_words;
+        down = cur + in->row_words;
+        dst = out->words + (size_t)r * out->row_words;
+
+        for(w=first_word; w+KERNEL_LANES<=last_word; w+=KERNEL_LANES){
+            chunk = KERNEL_CHUNK(brule, up, cur, down, w);
+            memcpy(&old, dst + w, sizeof old);
+            diff = chunk ^ old;
+            if (w > 1 && w + KERNEL_LANES <= last_cell){
+                vec_changes |= diff;
+            } else {
+                memcpy(lanes, &diff, sizeof lanes);
+                for(l=0; l<KERNEL_LANES; l++) changes |= cell_changes(in, w + l, lanes[l]);
+            }
+            memcpy(dst + w, &chunk, sizeof chunk);
+        }
+        for(; w<last_word; w++){
+            word = step_chunk_scalar(brule, up, cur, down, w);
+            changes |= cell_changes(in, w, word ^ dst[w]);
+            dst[w] = word;
+        }
+    }
+
+    memcpy(lanes, &vec_changes, sizeof lanes);
+    for(l=0; l<KERNEL_LANES; l++) changes |= lanes[l];
+    return changes;
+}
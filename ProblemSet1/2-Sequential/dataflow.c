@@ -0,0 +1,182 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <sched.h>
+#include "dataflow.h"
+
+//attempts to find a tile before an idle worker starts yielding the processor
+#define SPIN_LIMIT 4096
+
+/**
+ * Allocates the scheduler of a rows x cols torus of tiles, all of them at
+ * generation 0, for num_workers workers that run task.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int dataflow_create(dataflow* flow, int rows, int cols, int num_workers, dataflow_task task, void* state){
+    int i, tiles = rows * cols, status = 0;
+
+    flow->rows = rows;
+    flow->cols = cols;
+    flow->num_workers = num_workers;
+    flow->target = 0;
+    flow->task = task;
+    flow->state = state;
+    atomic_init(&flow->finished, tiles);
+    flow->generations = (atomic_int*) calloc (sizeof(atomic_int), tiles);
+    flow->claimed = (atomic_int*) calloc (sizeof(atomic_int), tiles);
+    flow->queues = (dataflow_queue*) calloc (sizeof(dataflow_queue), num_workers);
+    if (!flow->generations || !flow->claimed || !flow->queues){
+        free(flow->generations);
+        free(flow->claimed);
+        free(flow->queues);
+        flow->queues = NULL;
+        return -1;
+    }
+    for(i=0; i<tiles; i++){
+        atomic_init(&flow->generations[i], 0);
+        atomic_init(&flow->claimed[i], 0);
+    }
+    //a tile is in one queue at most, so any queue can hold all of them
+    for(i=0; i<num_workers; i++){
+        pthread_mutex_init(&flow->queues[i].lock, NULL);
+        flow->queues[i].tiles = (int*) calloc (sizeof(int), tiles);
+        if (!flow->queues[i].tiles) status = -1;
+    }
+    if (status != 0) dataflow_destroy(flow);
+    return status;
+}
+
+void dataflow_destroy(dataflow* flow){
+    int i;
+
+    if (!flow->queues) return;
+    for(i=0; i<flow->num_workers; i++){
+        pthread_mutex_destroy(&flow->queues[i].lock);
+        free(flow->queues[i].tiles);
+    }
+    free(flow->queues);
+    free(flow->generations);
+    free(flow->claimed);
+    flow->queues = NULL;
+}
+
+static void queue_push(dataflow* flow, int worker, int tile){
+    dataflow_queue* q = &flow->queues[worker];
+
+    pthread_mutex_lock(&q->lock);
+    q->tiles[q->last % (flow->rows * flow->cols)] = tile;
+    q->last++;
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Takes a tile from the queue of a worker, the last one queued if it is
+ * the own queue and the first one otherwise. Returns -1 if it is empty
+ * */
+static int queue_take(dataflow* flow, int worker, int own){
+    dataflow_queue* q = &flow->queues[worker];
+    int tile = -1, capacity = flow->rows * flow->cols;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->first < q->last){
+        if (own) tile = q->tiles[--q->last % capacity];
+        else tile = q->tiles[q->first++ % capacity];
+    }
+    pthread_mutex_unlock(&q->lock);
+    return tile;
+}
+
+/**
+ * Tile (r, c) of the torus, for r and c up to one tile outside of it
+ * */
+static inline int tile_index(const dataflow* flow, int r, int c){
+    r = (r + flow->rows) % flow->rows;
+    c = (c + flow->cols) % flow->cols;
+    return r * flow->cols + c;
+}
+
+/**
+ * Queues tile in the queue of worker if it can go to its next generation
+ * and nobody else did it. Every tile looks at itself and its neighbors
+ * after reaching a generation, and the generations are sequentially
+ * consistent atomics, so the last dependency that is met always sees the
+ * others and the tile is never forgotten
+ * */
+static void try_schedule(dataflow* flow, int worker, int tile){
+    int r = tile / flow->cols, c = tile % flow->cols, dr, dc;
+    int generation = atomic_load(&flow->generations[tile]);
+
+    if (generation >= flow->target || atomic_load(&flow->claimed[tile]) != generation) return;
+    for(dr=-1; dr<=1; dr++)
+        for(dc=-1; dc<=1; dc++)
+            if (atomic_load(&flow->generations[tile_index(flow, r + dr, c + dc)]) < generation) return;
+    if (c == flow->cols - 1 && c != 0 && atomic_load(&flow->generations[r * flow->cols]) <= generation) return;
+    if (atomic_compare_exchange_strong(&flow->claimed[tile], &generation, generation + 1))
+        queue_push(flow, worker, tile);
+}
+
+/**
+ * Sets the generation the tiles go up to, and queues the tiles that can
+ * start, each one in the queue of the worker that owns its part of the
+ * torus. Must be called while no worker runs
+ * */
+void dataflow_start(dataflow* flow, int target){
+    int tile, tiles = flow->rows * flow->cols, finished = 0;
+
+    flow->target = target;
+    for(tile=0; tile<tiles; tile++)
+        if (atomic_load(&flow->generations[tile]) >= target) finished++;
+    atomic_store(&flow->finished, finished);
+    for(tile=0; tile<tiles; tile++)
+        try_schedule(flow, (int) ((long)tile * flow->num_workers / tiles), tile);
+}
+
+/**
+ * Work of a worker until all the tiles reach the target generation: runs
+ * the tiles of its queue, or of the others if it is empty, and queues the
+ * tiles that can go on afterwards
+ * */
+void dataflow_run(dataflow* flow, int worker){
+    int tile, generation, i, dr, dc, spins = 0, tiles = flow->rows * flow->cols;
+
+    while (atomic_load(&flow->finished) < tiles){
+        tile = queue_take(flow, worker, 1);
+        for(i=1; i<flow->num_workers && tile < 0; i++)
+            tile = queue_take(flow, (worker + i) % flow->num_workers, 0);
+        if (tile < 0){
+            if (spins < SPIN_LIMIT) spins++;
+            else sched_yield();
+            continue;
+        }
+        spins = 0;
+
+        generation = atomic_load(&flow->generations[tile]);
+        flow->task(flow->state, worker, tile / flow->cols, tile % flow->cols, generation);
+        atomic_store(&flow->generations[tile], generation + 1);
+        if (generation + 1 == flow->target) atomic_fetch_add(&flow->finished, 1);
+
+        for(dr=-1; dr<=1; dr++)
+            for(dc=-1; dc<=1; dc++)
+                try_schedule(flow, worker, tile_index(flow, tile / flow->cols + dr, tile % flow->cols + dc));
+    }
+}
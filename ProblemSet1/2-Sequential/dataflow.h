@@ -0,0 +1,75 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * Computes a tile of the torus: goes from the given generation of tile
+ * (r, c) to the next one. It runs in worker worker
+ * */
+typedef void (*dataflow_task)(void* state, int worker, int r, int c, int generation);
+
+/**
+ * Tiles waiting to be computed by a worker. The worker takes the last
+ * one it queued (its neighbors are still in the cache) and the others
+ * steal the first one
+ * */
+typedef struct {
+    pthread_mutex_t lock;
+    int* tiles;         //ring of capacity tiles
+    long first, last;   //tiles[first%capacity..(last-1)%capacity] are queued
+    char padding[64];   //queues of different workers do not share a cache line
+} dataflow_queue;
+
+/**
+ * Scheduler of a rows x cols torus of tiles with no barrier between
+ * generations: every tile has a generation of its own, and it goes to the
+ * next one as soon as its 8 neighbors have reached its generation, so
+ * that their cells are there to be read and none of them still reads the
+ * buffer it writes (with two buffers, the generation before). Two
+ * neighbors are never more than a generation apart. The tiles of the last
+ * column also wait for the first tile of their row to reach the next
+ * generation, since they refresh the ghost cells of the row (see
+ * simulation_tile). A tile whose dependencies are met is claimed by the
+ * worker that saw it and queued; idle workers steal from the others.
+ * Tiles do not go past the target generation
+ * */
+typedef struct {
+    int rows, cols;
+    int num_workers;
+    int target;
+    atomic_int* generations;   //generation reached by every tile
+    atomic_int* claimed;       //generation every tile has been queued to reach
+    atomic_int finished;       //tiles that reached the target
+    dataflow_queue* queues;
+    dataflow_task task;
+    void* state;
+} dataflow;
+
+int dataflow_create(dataflow* flow, int rows, int cols, int num_workers, dataflow_task task, void* state);
+void dataflow_destroy(dataflow* flow);
+void dataflow_start(dataflow* flow, int target);
+void dataflow_run(dataflow* flow, int worker);
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include "functions.h"
+
+#define MAX_CHAR 1024
+
+
+/**
+ * Reads the whole transformation function file once and stores it in
+ * table. Every line must be "<num_inputs binary digits> <0|1>" and every
+ * possible neighborhood must appear, so that the engines never have to
+ * deal with missing entries inside their loops.
+ * Returns 0 on success and -1 if the file is not a complete function
+ * */
+int rule_table_load(rule_table* table, FILE* funct, int num_inputs){
+    char line[MAX_CHAR];
+    char *function_input = NULL, *function_output = NULL;
+    char* defined = NULL;
+    int i, index, line_number = 0;
+
+    table->num_inputs = num_inputs;
+    table->num_entries = 1 << num_inputs;
+    table->outputs = (char*) calloc (sizeof(char), table->num_entries);
+    defined = (char*) calloc (sizeof(char), table->num_entries);
+    if (!table->outputs || !defined){
+        fprintf(stderr, "Not enough memory for the transformation function\n");
+        free(defined);
+        rule_table_destroy(table);
+        return -1;
+    }
+
+    rewind(funct);
+    while(fgets(line, sizeof line, funct) != NULL){
+        line_number++;
+        function_input = strtok(line, " \t\r\n");
+        if (!function_input) continue; //blank line
+        function_output = strtok(NULL, " \t\r\n");
+
+        if ((int)strlen(function_input) != num_inputs || !function_output
+                || (function_output[0] != '0' && function_output[0] != '1')
+                || function_output[1] != '\0'){
+            fprintf(stderr, "Transformation function: line %d is not a valid "
+                            "entry for a %d cell neighborhood\n", line_number, num_inputs);
+            free(defined);
+            rule_table_destroy(table);
+            return -1;
+        }
+
+        index = 0;
+        for(i=0; i<num_inputs; i++){
+            if (function_input[i] != '0' && function_input[i] != '1'){
+                fprintf(stderr, "Transformation function: line %d contains non-boolean value\n",
+                                line_number);
+                free(defined);
+                rule_table_destroy(table);
+                return -1;
+            }
+            index = (index << 1) | CELL_BIT(function_input[i]);
+        }
+
+        if (defined[index] && table->outputs[index] != function_output[0]){
+            fprintf(stderr, "Transformation function: line %d contradicts a previous entry "
+                            "for %s\n", line_number, function_input);
+            free(defined);
+            rule_table_destroy(table);
+            return -1;
+        }
+        table->outputs[index] = function_output[0];
+        defined[index] = 1;
+    }
+
+    for(index=0; index<table->num_entries; index++){
+        if (!defined[index]){
+            fprintf(stderr, "Transformation function: missing entry for ");
+            for(i=num_inputs-1; i>=0; i--) fputc('0' + ((index >> i) & 1), stderr);
+            fprintf(stderr, "\n");
+            free(defined);
+            rule_table_destroy(table);
+            return -1;
+        }
+    }
+
+    free(defined);
+    return 0;
+}
+
+/**
+ * Frees the memory of a table filled in by rule_table_load
+ * */
+void rule_table_destroy(rule_table* table){
+    if (table->outputs) free(table->outputs);
+    table->outputs = NULL;
+}
+
+/**
+ * Checks whether a 2D table is outer-totalistic, i.e. the output only
+ * depends on the center cell and on how many of its 8 neighbors are 1
+ * (like the Game of Life). If it is, bit n of birth (survive) is set when
+ * a 0 (1) center cell with n neighbors in state 1 becomes 1.
+ * Returns 1 if the table is outer-totalistic and 0 otherwise
+ * */
+int rule_table_outer_totalistic(const rule_table* table, int* birth, int* survive){
+    int index, k, count, center, seen[2] = {0, 0}, result[2] = {0, 0};
+
+    if (table->num_inputs != RULE_2D_INPUTS) return 0;
+
+    for(index=0; index<table->num_entries; index++){
+        center = (index >> RULE_2D_CENTER) & 1;
+        count = 0;
+        for(k=0; k<RULE_2D_INPUTS; k++)
+            if (k != RULE_2D_CENTER) count += (index >> k) & 1;
+
+        if (seen[center] & (1 << count)){
+            if (((result[center] >> count) & 1) != CELL_BIT(table->outputs[index])) return 0;
+        } else {
+            seen[center] |= 1 << count;
+            result[center] |= CELL_BIT(table->outputs[index]) << count;
+        }
+    }
+
+    *birth = result[0];
+    *survive = result[1];
+    return 1;
+}
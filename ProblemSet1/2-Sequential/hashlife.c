@@ -0,0 +1,489 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hashlife.h"
+
+#define BASE_LEVEL 4       //results of 16x16 squares are computed cell by cell
+#define LEAF_SIDE 8
+#define MIN_NODES 1024
+#define INITIAL_BUCKETS 4096
+
+enum {NW, NE, SW, SE};
+
+static uint64_t leaf_bits(const hashlife_node* node){
+    return (uint64_t)node->child[0] | (uint64_t)node->child[1] << 32;
+}
+
+static uint32_t hash_key(int level, const uint32_t child[4]){
+    uint64_t key = (uint64_t)(level + 1) * 0x9E3779B97F4A7C15ULL;
+    int i;
+    for(i=0; i<4; i++){
+        key = (key ^ child[i]) * 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 32;
+    }
+    return (uint32_t) key;
+}
+
+/**
+ * Keeps the node alive until the stack is cut below it.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+static int protect(hashlife* h, uint32_t node){
+    uint32_t* stack;
+    size_t capacity;
+
+    if (h->stack_size == h->stack_capacity){
+        capacity = h->stack_capacity ? 2 * h->stack_capacity : 256;
+        stack = (uint32_t*) realloc (h->stack, sizeof(uint32_t) * capacity);
+        if (!stack) return -1;
+        h->stack = stack;
+        h->stack_capacity = capacity;
+    }
+    h->stack[h->stack_size++] = node;
+    return 0;
+}
+
+static void insert_node(hashlife* h, uint32_t node){
+    uint32_t bucket = hash_key(h->nodes[node].level, h->nodes[node].child) & (h->num_buckets - 1);
+    h->nodes[node].next = h->buckets[bucket];
+    h->buckets[bucket] = node;
+}
+
+static void mark(hashlife* h, uint32_t node){
+    hashlife_node* n = &h->nodes[node];
+    int i;
+
+    if (!node || n->marked) return;
+    n->marked = 1;
+    if (n->level > HASHLIFE_LEAF_LEVEL)
+        for(i=0; i<4; i++) mark(h, n->child[i]);
+    mark(h, n->result);
+}
+
+/**
+ * Frees every node that can not be reached from the stack, going
+ * through children and memoized results
+ * */
+static void collect(hashlife* h){
+    uint32_t node;
+    size_t i;
+
+    for(i=0; i<h->stack_size; i++) mark(h, h->stack[i]);
+
+    memset(h->buckets, 0, sizeof(uint32_t) * h->num_buckets);
+    h->free_list = 0;
+    h->live_nodes = 0;
+    for(node=h->num_nodes-1; node>0; node--){
+        if (h->nodes[node].marked){
+            h->nodes[node].marked = 0;
+            insert_node(h, node);
+            h->live_nodes++;
+        } else {
+            h->nodes[node].level = -1;
+            h->nodes[node].result = 0;
+            h->nodes[node].next = h->free_list;
+            h->free_list = node;
+        }
+    }
+}
+
+/**
+ * Doubles the hash table when it holds more nodes than buckets.
+ * If there is no memory for it the chains just get longer
+ * */
+static void grow_buckets(hashlife* h){
+    uint32_t* buckets;
+    uint32_t node;
+
+    if (h->live_nodes <= h->num_buckets || h->num_buckets >= ((uint32_t)1 << 31)) return;
+    buckets = (uint32_t*) calloc (sizeof(uint32_t), (size_t)h->num_buckets * 2);
+    if (!buckets) return;
+    free(h->buckets);
+    h->buckets = buckets;
+    h->num_buckets *= 2;
+    for(node=1; node<h->num_nodes; node++)
+        if (h->nodes[node].level >= 0) insert_node(h, node);
+}
+
+/**
+ * Hands out an unused node, collecting garbage first if the pool is full
+ * and at the memory cap. If a collection frees little, the pool is let
+ * grow past the cap instead of collecting again and again. Returns 0 if
+ * there is not enough memory
+ * */
+static uint32_t new_node(hashlife* h){
+    hashlife_node* nodes;
+    uint32_t node, capacity;
+
+    if (!h->free_list && h->num_nodes == h->capacity && h->capacity >= h->collect_limit){
+        collect(h);
+        if (h->live_nodes > h->capacity - h->capacity / 4){
+            if (!h->over_cap) fprintf(stderr, "Warning: the nodes in use do not fit in the memory cap\n");
+            h->over_cap = 1;
+            h->collect_limit = 2 * h->capacity;
+        }
+    }
+    if (h->free_list){
+        node = h->free_list;
+        h->free_list = h->nodes[node].next;
+        return node;
+    }
+
+    if (h->num_nodes == h->capacity){
+        if (h->capacity >= UINT32_MAX / 2) return 0;
+        capacity = 2 * h->capacity;
+        if (capacity > h->max_nodes && h->capacity < h->max_nodes) capacity = h->max_nodes;
+        nodes = (hashlife_node*) realloc (h->nodes, sizeof(hashlife_node) * capacity);
+        if (!nodes) return 0;
+        h->nodes = nodes;
+        h->capacity = capacity;
+    }
+    return h->num_nodes++;
+}
+
+/**
+ * Returns the only node with the given level and children, creating it
+ * if needed, and protects it. Returns 0 if there is not enough memory
+ * */
+static uint32_t find_node(hashlife* h, int level, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se){
+    uint32_t child[4] = {nw, ne, sw, se};
+    uint32_t node = h->buckets[hash_key(level, child) & (h->num_buckets - 1)];
+    hashlife_node* n;
+
+    while (node){
+        n = &h->nodes[node];
+        if (n->level == level && n->child[0] == nw && n->child[1] == ne
+            && n->child[2] == sw && n->child[3] == se) break;
+        node = n->next;
+    }
+
+    if (!node){
+        node = new_node(h);
+        if (!node) return 0;
+        n = &h->nodes[node];
+        memcpy(n->child, child, sizeof(child));
+        n->level = (int8_t) level;
+        n->result = 0;
+        n->result_step = -1;
+        n->marked = 0;
+        insert_node(h, node);
+        h->live_nodes++;
+        grow_buckets(h);
+    }
+    return (protect(h, node) == 0) ? node : 0;
+}
+
+static uint32_t find_leaf(hashlife* h, uint64_t bits){
+    return find_node(h, HASHLIFE_LEAF_LEVEL, (uint32_t) bits, (uint32_t)(bits >> 32), 0, 0);
+}
+
+/**
+ * Node made of the inner quadrants of four nodes of the given level
+ * that form a square: the center of that square
+ * */
+static uint32_t centered(hashlife* h, int level, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se){
+    uint64_t parts[4], bits = 0;
+    int r, c;
+
+    if (level > HASHLIFE_LEAF_LEVEL)
+        return find_node(h, level, h->nodes[nw].child[SE], h->nodes[ne].child[SW],
+                         h->nodes[sw].child[NE], h->nodes[se].child[NW]);
+
+    parts[NW] = leaf_bits(&h->nodes[nw]);
+    parts[NE] = leaf_bits(&h->nodes[ne]);
+    parts[SW] = leaf_bits(&h->nodes[sw]);
+    parts[SE] = leaf_bits(&h->nodes[se]);
+    for(r=0; r<LEAF_SIDE; r++)
+        for(c=0; c<LEAF_SIDE; c++)
+            bits |= ((parts[(r >= 4) * 2 + (c >= 4)] >> (((r + 4) % 8) * 8 + (c + 4) % 8)) & 1)
+                    << (r * 8 + c);
+    return find_leaf(h, bits);
+}
+
+/**
+ * Result of a 16x16 node: its center 8x8 cells advanced 2^step (1, 2
+ * or 4) generations, computed cell by cell with the lookup table
+ * */
+static uint32_t step_base(hashlife* h, uint32_t node, int step){
+    uint8_t cells[2][16][16];
+    uint64_t parts[4], bits = 0;
+    int i, r, c, t, cur = 0, gens = 1 << step;
+    const char* outputs = h->rule->outputs;
+
+    for(i=0; i<4; i++) parts[i] = leaf_bits(&h->nodes[h->nodes[node].child[i]]);
+    for(r=0; r<16; r++)
+        for(c=0; c<16; c++)
+            cells[0][r][c] = (parts[(r / 8) * 2 + c / 8] >> ((r % 8) * 8 + c % 8)) & 1;
+
+    //every generation the valid square loses one cell per side
+    for(t=1; t<=gens; t++){
+        for(r=t; r<16-t; r++){
+            for(c=t; c<16-t; c++){
+                cells[1-cur][r][c] = CELL_BIT(outputs[
+                      cells[cur][r-1][c-1] << 8 | cells[cur][r-1][c] << 7 | cells[cur][r-1][c+1] << 6
+                    | cells[cur][r][c-1] << 5   | cells[cur][r][c] << 4   | cells[cur][r][c+1] << 3
+                    | cells[cur][r+1][c-1] << 2 | cells[cur][r+1][c] << 1 | cells[cur][r+1][c+1]]);
+            }
+        }
+        cur = 1 - cur;
+    }
+
+    for(r=0; r<LEAF_SIDE; r++)
+        for(c=0; c<LEAF_SIDE; c++)
+            bits |= (uint64_t)cells[cur][r+4][c+4] << (r * 8 + c);
+    return find_leaf(h, bits);
+}
+
+/**
+ * Returns the center half of the node advanced 2^step generations, with
+ * step <= level-2. The node is split in 9 overlapping squares of the level
+ * below, which are advanced; for the largest step their results are
+ * joined in 4 squares that are advanced again, and otherwise their
+ * centers are joined. Returns 0 if there is not enough memory
+ * */
+static uint32_t step_node(hashlife* h, uint32_t node, int step){
+    hashlife_node* n = &h->nodes[node];
+    int level = n->level, full = (step == level - 2);
+    int a, b, sub_step = full ? level - 3 : step;
+    uint32_t grand[4][4], res[3][3], quad[4], sub, joined, result = 0;
+    size_t base = h->stack_size;
+
+    if (n->result && n->result_step == step) return n->result;
+
+    if (level == BASE_LEVEL){
+        result = step_base(h, node, step);
+    } else {
+        for(a=0; a<4; a++)
+            for(b=0; b<4; b++)
+                grand[a][b] = h->nodes[h->nodes[node].child[(a/2)*2 + b/2]].child[(a%2)*2 + b%2];
+
+        for(a=0; a<3; a++){
+            for(b=0; b<3; b++){
+                sub = find_node(h, level - 1, grand[a][b], grand[a][b+1], grand[a+1][b], grand[a+1][b+1]);
+                if (!sub || !(res[a][b] = step_node(h, sub, sub_step))) return 0;
+            }
+        }
+
+        for(a=0; a<2; a++){
+            for(b=0; b<2; b++){
+                if (full){
+                    joined = find_node(h, level - 1, res[a][b], res[a][b+1], res[a+1][b], res[a+1][b+1]);
+                    quad[a*2 + b] = joined ? step_node(h, joined, sub_step) : 0;
+                } else {
+                    quad[a*2 + b] = centered(h, level - 2, res[a][b], res[a][b+1], res[a+1][b], res[a+1][b+1]);
+                }
+                if (!quad[a*2 + b]) return 0;
+            }
+        }
+        result = find_node(h, level - 1, quad[NW], quad[NE], quad[SW], quad[SE]);
+    }
+    if (!result) return 0;
+
+    //the result stays alive through the node, everything else made here can go
+    h->stack_size = base;
+    n = &h->nodes[node];
+    n->result = result;
+    n->result_step = (int8_t) step;
+    return result;
+}
+
+/**
+ * Nodes already built for the squares of the periodic plane, by level
+ * and position of the top left corner modulo the torus size
+ * */
+typedef struct {
+    uint64_t* keys;
+    uint32_t* values;
+    size_t capacity, size;
+} plane_memo;
+
+static uint32_t* memo_slot(plane_memo* memo, uint64_t key){
+    size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & (memo->capacity - 1);
+    while (memo->keys[i] && memo->keys[i] != key) i = (i + 1) & (memo->capacity - 1);
+    if (!memo->keys[i]){
+        memo->keys[i] = key;
+        memo->values[i] = 0;
+    }
+    return &memo->values[i];
+}
+
+static int memo_grow(plane_memo* memo){
+    plane_memo bigger;
+    size_t i;
+
+    bigger.capacity = memo->capacity ? 2 * memo->capacity : 4096;
+    bigger.size = memo->size;
+    bigger.keys = (uint64_t*) calloc (sizeof(uint64_t), bigger.capacity);
+    bigger.values = (uint32_t*) calloc (sizeof(uint32_t), bigger.capacity);
+    if (!bigger.keys || !bigger.values){
+        free(bigger.keys);
+        free(bigger.values);
+        return -1;
+    }
+    for(i=0; i<memo->capacity; i++)
+        if (memo->keys[i]) *memo_slot(&bigger, memo->keys[i]) = memo->values[i];
+    free(memo->keys);
+    free(memo->values);
+    *memo = bigger;
+    return 0;
+}
+
+/**
+ * Node for the 2^level square of the plane tiled with the torus whose
+ * top left corner is (row, col) modulo tam. half[l] is 2^(l-1) mod tam
+ * */
+static uint32_t build(hashlife* h, plane_memo* memo, char** matrix, int tam, const int* half,
+                      int level, int row, int col){
+    uint64_t key = (uint64_t)level << 58 | (uint64_t)row << 29 | (uint64_t)col, bits = 0;
+    uint32_t *slot, child[4];
+    int r, c, i;
+
+    if (memo->size * 2 >= memo->capacity && memo_grow(memo) != 0) return 0;
+    slot = memo_slot(memo, key);
+    if (*slot) return *slot;
+
+    if (level == HASHLIFE_LEAF_LEVEL){
+        for(r=0; r<LEAF_SIDE; r++)
+            for(c=0; c<LEAF_SIDE; c++)
+                bits |= (uint64_t)CELL_BIT(matrix[(row + r) % tam][(col + c) % tam]) << (r * 8 + c);
+        child[0] = find_leaf(h, bits);
+    } else {
+        for(i=0; i<4; i++){
+            child[i] = build(h, memo, matrix, tam, half, level - 1,
+                             (row + (i / 2) * half[level]) % tam, (col + (i % 2) * half[level]) % tam);
+            if (!child[i]) return 0;
+        }
+        child[0] = find_node(h, level, child[NW], child[NE], child[SW], child[SE]);
+    }
+    if (!child[0]) return 0;
+
+    //the memo may have moved while building the children
+    *memo_slot(memo, key) = child[0];
+    memo->size++;
+    return child[0];
+}
+
+/**
+ * Writes the square of the node that falls in the tam x tam window at
+ * (0, 0) of the plane into the torus, shifted by shift cells
+ * */
+static void extract(const hashlife* h, uint32_t node, int level, long long row, long long col,
+                    int tam, int shift, char** matrix){
+    const hashlife_node* n = &h->nodes[node];
+    long long half;
+    uint64_t bits;
+    int r, c, i;
+
+    if (row >= tam || col >= tam) return;
+    if (level == HASHLIFE_LEAF_LEVEL){
+        bits = leaf_bits(n);
+        for(r=0; r<LEAF_SIDE && row + r < tam; r++)
+            for(c=0; c<LEAF_SIDE && col + c < tam; c++)
+                matrix[(shift + row + r) % tam][(shift + col + c) % tam] = ((bits >> (r * 8 + c)) & 1) ? '1' : '0';
+        return;
+    }
+    half = 1LL << (level - 1);
+    for(i=0; i<4; i++)
+        extract(h, n->child[i], level - 1, row + (i / 2) * half, col + (i % 2) * half, tam, shift, matrix);
+}
+
+/**
+ * Prepares an empty universe for the rule, whose node pool takes at
+ * most (about) max_bytes. Returns 0 on success and -1 if there is not
+ * enough memory
+ * */
+int hashlife_create(hashlife* h, const rule_table* rule, size_t max_bytes){
+    size_t max_nodes = max_bytes / (sizeof(hashlife_node) + sizeof(uint32_t));
+
+    memset(h, 0, sizeof(hashlife));
+    h->rule = rule;
+    h->max_nodes = (max_nodes < MIN_NODES) ? MIN_NODES
+                 : (max_nodes > UINT32_MAX / 2) ? UINT32_MAX / 2 : (uint32_t) max_nodes;
+    h->capacity = MIN_NODES;
+    h->collect_limit = h->max_nodes;
+    h->num_nodes = 1; //node 0 means none
+    h->num_buckets = INITIAL_BUCKETS;
+    h->nodes = (hashlife_node*) calloc (sizeof(hashlife_node), h->capacity);
+    h->buckets = (uint32_t*) calloc (sizeof(uint32_t), h->num_buckets);
+    if (!h->nodes || !h->buckets){
+        hashlife_destroy(h);
+        return -1;
+    }
+    return 0;
+}
+
+void hashlife_destroy(hashlife* h){
+    if(h->nodes) free(h->nodes);
+    if(h->buckets) free(h->buckets);
+    if(h->stack) free(h->stack);
+    h->nodes = NULL;
+    h->buckets = NULL;
+    h->stack = NULL;
+}
+
+/**
+ * Advances the tam x tam torus stored in matrix the given number of
+ * generations, one jump of 2^j generations per bit set. For every jump
+ * the torus is tiled over a square of the plane big enough for the
+ * result to cover a whole period, which evolves just like the torus.
+ * The nodes stay cached for the next jumps. Returns 0 on success and
+ * -1 if there is not enough memory
+ * */
+int hashlife_advance(hashlife* h, char** matrix, int tam, unsigned long long generations){
+    plane_memo memo = {NULL, NULL, 0, 0};
+    int half[HASHLIFE_MAX_JUMP + 3];
+    int j, l, level, min_level = HASHLIFE_LEAF_LEVEL + 1, status = 0;
+    uint32_t root, result;
+
+    if (generations >> (HASHLIFE_MAX_JUMP + 1)) return -1;
+    while ((1LL << (min_level - 1)) < tam) min_level++;
+    half[1] = 1 % tam;
+    for(l=2; l<HASHLIFE_MAX_JUMP + 3; l++) half[l] = (2 * half[l-1]) % tam;
+
+    for(j=0; j<=HASHLIFE_MAX_JUMP && status == 0; j++){
+        if (!((generations >> j) & 1)) continue;
+        level = (j + 2 > min_level) ? j + 2 : min_level;
+
+        h->stack_size = 0;
+        memo.size = 0;
+        if (memo.keys) memset(memo.keys, 0, sizeof(uint64_t) * memo.capacity);
+        root = build(h, &memo, matrix, tam, half, level, 0, 0);
+        h->stack_size = 0;
+        if (!root || protect(h, root) != 0){
+            status = -1;
+            break;
+        }
+
+        result = step_node(h, root, j);
+        if (!result){
+            status = -1;
+            break;
+        }
+        extract(h, result, level - 1, 0, 0, tam, half[level - 1], matrix);
+    }
+
+    h->stack_size = 0;
+    free(memo.keys);
+    free(memo.values);
+    return status;
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define OUTPUT_TITLE 128          //longest title of a frame
+#define OUTPUT_BUFFER (1 << 20)   //bytes formatted before each write
+
+/**
+ * Layout of the frames: text keeps the one of the engines (one row per
+ * line, every cell written as one of two symbols), RLE writes each frame
+ * as a pattern in run length encoding (b = dead, o = alive, $ = end of
+ * row), which takes a few bytes per run instead of one per cell
+ * */
+typedef enum {OUTPUT_TEXT, OUTPUT_RLE} output_format;
+
+/**
+ * Frame of the queue: its title, written as is before it (as #C comments
+ * with RLE), and rows x cols cells, '0' or '1'
+ * */
+typedef struct {
+    char title[OUTPUT_TITLE];
+    char* cells;
+    int rows, cols;
+} output_frame;
+
+/**
+ * Output stage of a simulation. The thread that publishes the generations
+ * fills a frame of a bounded queue and goes back to computing, while a
+ * background thread formats the frames into a large buffer and writes them
+ * in order. Only when every frame of the queue is taken does the publisher
+ * wait for the writer, so frames are never dropped. There must be a single
+ * publisher. If the writer thread can not be created, the frames are
+ * written by the publisher itself
+ * */
+typedef struct {
+    FILE* out;
+    output_format format;
+    char symbols[2];              //text of a dead and of a live cell
+    output_frame* frames;
+    int num_frames;
+    int first, queued;            //first frame waiting to be written, and how many are
+    int closing, failed, threaded;
+    char* buffer;
+    size_t used;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t writer;
+} output_pipeline;
+
+int output_format_parse(const char* name, output_format* format);
+int output_open(output_pipeline* p, FILE* out, output_format format, const char* symbols,
+                int num_frames, size_t frame_cells);
+char* output_frame_begin(output_pipeline* p, int rows, int cols, const char* title);
+void output_frame_end(output_pipeline* p);
+int output_close(output_pipeline* p);
+
+#endif
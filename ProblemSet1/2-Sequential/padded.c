@@ -0,0 +1,225 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include "padded.h"
+
+#define PADDED_ALIGN 64
+#define PADDED_CHUNK 256  //column codes computed at a time
+
+/**
+ * Builds the table indexed by columns from the table of the rule, whose
+ * index holds the neighborhood row by row (up-left in bit 8, down-right
+ * in bit 0)
+ * */
+void padded_rule_init(padded_rule* prule, const rule_table* table){
+    int index, left, center, right;
+
+    for(index=0; index<512; index++){
+        left = index >> 6;
+        center = (index >> 3) & 7;
+        right = index & 7;
+        prule->outputs[index] = table->outputs[
+              (left >> 2) << 8       | (center >> 2) << 7       | (right >> 2) << 6
+            | ((left >> 1) & 1) << 5 | ((center >> 1) & 1) << 4 | ((right >> 1) & 1) << 3
+            | (left & 1) << 2        | (center & 1) << 1        | (right & 1)];
+    }
+}
+
+/**
+ * Allocates a tam x tam grid with all cells 0 ('\0', which reads as a
+ * dead cell until a row is stored).
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int padded_grid_create(padded_grid* grid, int tam){
+    return padded_band_create(grid, tam, tam);
+}
+
+/**
+ * Bytes of a stored row of a grid (or band) of tam columns
+ * */
+size_t padded_row_bytes(int tam){
+    return (size_t)(tam + 2 + PADDED_ALIGN - 1) / PADDED_ALIGN * PADDED_ALIGN;
+}
+
+/**
+ * Allocates a band of rows rows of a tam x tam grid, with all cells 0.
+ * Only the ghost cells of its rows are kept (see padded_refresh_cols):
+ * the rows above and below the band are not part of it.
+ * Returns 0 on success and -1 if there is not enough memory
+ * */
+int padded_band_create(padded_grid* grid, int tam, int rows){
+    size_t bytes;
+
+    grid->tam = tam;
+    grid->stride = (int) padded_row_bytes(tam);
+    bytes = (size_t)grid->stride * (rows + 2);
+    grid->cells = (char*) aligned_alloc(PADDED_ALIGN, bytes);
+    if (!grid->cells) return -1;
+    memset(grid->cells, 0, bytes);
+    return 0;
+}
+
+void padded_grid_destroy(padded_grid* grid){
+    if (grid->cells) free(grid->cells);
+    grid->cells = NULL;
+}
+
+/**
+ * The tam cells of row of the matrix, which can be read and written in
+ * place. The ghost cells are only updated by padded_refresh_rows
+ * */
+char* padded_grid_row(const padded_grid* grid, int row){
+    return grid->cells + (size_t)(row + 1) * grid->stride + 1;
+}
+
+/**
+ * Copies rows stored rows of src, from row src_row of the matrix (or of
+ * the band) on, into dst from dst_row on, ghost cells included. Both must
+ * hold rows of the same size of matrix
+ * */
+void padded_copy_rows(padded_grid* dst, int dst_row, const padded_grid* src, int src_row, int rows){
+    memcpy(dst->cells + (size_t)(dst_row + 1) * dst->stride, src->cells + (size_t)(src_row + 1) * src->stride,
+           (size_t)src->stride * rows);
+}
+
+/**
+ * Copies count cells of row src_row of src (of the matrix or of the band),
+ * from column src_col on, into row dst_row of dst from column dst_col on.
+ * The ghost cells are not refreshed
+ * */
+void padded_copy_cells(padded_grid* dst, int dst_row, int dst_col, const padded_grid* src, int src_row,
+                       int src_col, int count){
+    memcpy(padded_grid_row(dst, dst_row) + dst_col, padded_grid_row(src, src_row) + src_col, count);
+}
+
+/**
+ * Copies the opposite edges of the matrix rows first_row..last_row-1 into
+ * their ghost cells, so that each row wraps around. Different ranges can
+ * be refreshed at the same time
+ * */
+void padded_refresh_cols(padded_grid* grid, int first_row, int last_row){
+    int r, tam = grid->tam;
+    char* row;
+
+    for(r=first_row; r<last_row; r++){
+        row = padded_grid_row(grid, r);
+        row[-1] = row[tam - 1];
+        row[tam] = row[0];
+    }
+}
+
+/**
+ * Refreshes the ghost cells of the matrix rows first_row..last_row-1 (see
+ * padded_refresh_cols), and copies the first and last rows of the matrix
+ * into the ghost rows, so that the grid behaves as a torus. Different
+ * ranges can be refreshed at the same time
+ * */
+void padded_refresh_rows(padded_grid* grid, int first_row, int last_row){
+    int tam = grid->tam;
+
+    padded_refresh_cols(grid, first_row, last_row);
+    if (first_row <= tam - 1 && tam - 1 < last_row)
+        memcpy(grid->cells, grid->cells + (size_t)tam * grid->stride, grid->stride);
+    if (first_row <= 0 && 0 < last_row)
+        memcpy(grid->cells + (size_t)(tam + 1) * grid->stride, grid->cells + grid->stride, grid->stride);
+}
+
+/**
+ * Refreshes the ghost cells that depend on the tile of columns
+ * first_col..last_col-1 of rows first_row..last_row-1, so that the tiles
+ * of a generation can be refreshed apart instead of whole rows at a time.
+ * The tile of the last columns refreshes the ghost cells of its rows,
+ * which copy the first column too, so it has to go after the tile of the
+ * first columns. Each tile copies its columns of the first and last rows
+ * into the ghost rows, the one of the last columns also the ghost cells
+ * */
+void padded_refresh_tile(padded_grid* grid, int first_row, int last_row, int first_col, int last_col){
+    int tam = grid->tam, last = (last_col == tam);
+    char* top = grid->cells + 1;
+    char* bottom = grid->cells + (size_t)(tam + 1) * grid->stride + 1;
+
+    if (last) padded_refresh_cols(grid, first_row, last_row);
+    if (first_row <= tam - 1 && tam - 1 < last_row){
+        memcpy(top + first_col, padded_grid_row(grid, tam - 1) + first_col, last_col - first_col);
+        if (last){
+            top[-1] = padded_grid_row(grid, tam - 1)[-1];
+            top[tam] = padded_grid_row(grid, tam - 1)[tam];
+        }
+    }
+    if (first_row <= 0 && 0 < last_row){
+        memcpy(bottom + first_col, padded_grid_row(grid, 0) + first_col, last_col - first_col);
+        if (last){
+            bottom[-1] = padded_grid_row(grid, 0)[-1];
+            bottom[tam] = padded_grid_row(grid, 0)[tam];
+        }
+    }
+}
+
+/**
+ * Refreshes the ghost cells of the whole grid
+ * */
+void padded_refresh_border(padded_grid* grid){
+    padded_refresh_rows(grid, 0, grid->tam);
+}
+
+/**
+ * Computes the rows first_row..last_row-1 and columns first_col..last_col-1
+ * of the next generation of in into out. The column codes of a piece of a
+ * row are computed first, in a loop without branches nor table lookups
+ * that the compiler vectorizes, and then every cell takes one lookup.
+ * Returns 1 if any cell of the tile is different from what out held
+ * before (with two grids in turn, the generation before in), and 0
+ * otherwise. The ghost cells of out have to be refreshed before out is
+ * used as the input of another step
+ * */
+int padded_step_tile(const padded_rule* prule, const padded_grid* in, padded_grid* out,
+                     int first_row, int last_row, int first_col, int last_col){
+    unsigned char codes[PADDED_CHUNK + 2];
+    const char *up, *cur, *down;
+    char* dst;
+    int i, j, col0, count, index;
+    unsigned changed = 0;
+    char cell;
+
+    for(i=first_row; i<last_row; i++){
+        cur = padded_grid_row(in, i);
+        up = cur - in->stride;
+        down = cur + in->stride;
+        dst = padded_grid_row(out, i);
+        for(col0=first_col; col0<last_col; col0+=count){
+            count = (last_col - col0 < PADDED_CHUNK) ? last_col - col0 : PADDED_CHUNK;
+            //codes[k] is the column col0+k-1, the ghost cells included
+            for(j=0; j<count+2; j++)
+                codes[j] = CELL_BIT(up[col0+j-1]) << 2 | CELL_BIT(cur[col0+j-1]) << 1 | CELL_BIT(down[col0+j-1]);
+            index = codes[0] << 3 | codes[1];
+            for(j=0; j<count; j++){
+                index = (index << 3 | codes[j+2]) & 511;
+                cell = prule->outputs[index];
+                changed |= (unsigned char)(cell ^ dst[col0+j]);
+                dst[col0+j] = cell;
+            }
+        }
+    }
+    return changed != 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#ifndef PADDED_H
+#define PADDED_H
+
+#include "functions.h"
+
+/**
+ * Transformation function of a 2D automaton indexed by columns: the 3
+ * cells of a column of the neighborhood (up, center, down) make a code of
+ * 3 bits, and the output of a cell is outputs[left << 6 | center << 3 |
+ * right] for the codes of its 3 columns. Moving to the next cell of a row
+ * then only shifts a new column code into the index
+ * */
+typedef struct {
+    char outputs[512];
+} padded_rule;
+
+/**
+ * tam x tam torus of '0'/'1' characters in a single buffer with one ghost
+ * cell all around it, so that the 8 neighbors of every cell are at fixed
+ * offsets and the kernel never computes a module. Row r of the matrix is
+ * stored row r+1, starting at column 1, and the ghost cells hold copies
+ * of the opposite edges (see padded_refresh_rows). Every stored row
+ * starts on a cache line. A band (padded_band_create) stores its rows the
+ * same way, but holds only a range of rows of the matrix, without ghost
+ * rows
+ * */
+typedef struct {
+    int tam;
+    int stride;   //distance between consecutive stored rows
+    char* cells;
+} padded_grid;
+
+void padded_rule_init(padded_rule* prule, const rule_table* table);
+
+int padded_grid_create(padded_grid* grid, int tam);
+int padded_band_create(padded_grid* grid, int tam, int rows);
+size_t padded_row_bytes(int tam);
+void padded_grid_destroy(padded_grid* grid);
+char* padded_grid_row(const padded_grid* grid, int row);
+void padded_copy_rows(padded_grid* dst, int dst_row, const padded_grid* src, int src_row, int rows);
+void padded_copy_cells(padded_grid* dst, int dst_row, int dst_col, const padded_grid* src, int src_row,
+                       int src_col, int count);
+void padded_refresh_cols(padded_grid* grid, int first_row, int last_row);
+void padded_refresh_rows(padded_grid* grid, int first_row, int last_row);
+void padded_refresh_border(padded_grid* grid);
+void padded_refresh_tile(padded_grid* grid, int first_row, int last_row, int first_col, int last_col);
+int padded_step_tile(const padded_rule* prule, const padded_grid* in, padded_grid* out,
+                     int first_row, int last_row, int first_col, int last_col);
+
+#endif
@@ -0,0 +1,381 @@
+/**
+ * Copyright 2019 Lucia Fuentes Villodres
+ * Permission is hereby granted, free of charge, to any person obtaining a copy 
+ * of this software and associated documentation files (the "Software"), to deal 
+ * in the Software without restriction, including without limitation the rights 
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all 
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ *  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A 
+ *  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT 
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE 
+ *  OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  //madvise
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "state.h"
+
+/**
+ * '0'/'1' characters of the 4 cells held by every value of 4 bits, the
+ * lowest bit first
+ * */
+static const char nibble_cells[16][4] = {
+    {'0','0','0','0'}, {'1','0','0','0'}, {'0','1','0','0'}, {'1','1','0','0'},
+    {'0','0','1','0'}, {'1','0','1','0'}, {'0','1','1','0'}, {'1','1','1','0'},
+    {'0','0','0','1'}, {'1','0','0','1'}, {'0','1','0','1'}, {'1','1','0','1'},
+    {'0','0','1','1'}, {'1','0','1','1'}, {'0','1','1','1'}, {'1','1','1','1'}
+};
+
+/**
+ * Bytes before the first row: the header and the rule, if there is one
+ * */
+static uint64_t header_size(int rule_inputs){
+    uint64_t bytes = sizeof(state_header);
+    if (rule_inputs > 0) bytes += sizeof(uint64_t) * STATE_RULE_WORDS(rule_inputs);
+    return (bytes + STATE_ALIGN - 1) / STATE_ALIGN * STATE_ALIGN;
+}
+
+static uint64_t row_words(uint64_t cols){
+    return (cols + STATE_WORD_BITS - 1) / STATE_WORD_BITS;
+}
+
+/**
+ * Returns 1 if f starts like a binary state file and 0 if it does not (a
+ * text configuration). f is left at its beginning
+ * */
+int state_is_binary(FILE* f){
+    char magic[sizeof(((state_header*)0)->magic)];
+    int binary;
+
+    rewind(f);
+    binary = fread(magic, 1, sizeof magic, f) == sizeof magic
+             && memcmp(magic, STATE_MAGIC, sizeof magic) == 0;
+    rewind(f);
+    return binary;
+}
+
+/**
+ * Fills in the header of a rows x cols state
+ * */
+void state_header_init(state_header* header, uint64_t rows, uint64_t cols, uint64_t generation,
+                       uint64_t rule_id){
+    memset(header, 0, sizeof *header);
+    memcpy(header->magic, STATE_MAGIC, sizeof header->magic);
+    header->header_size = (uint32_t) header_size(0);
+    header->byte_order = STATE_BYTE_ORDER;
+    header->rows = rows;
+    header->cols = cols;
+    header->generation = generation;
+    header->rule_id = rule_id;
+    header->row_words = row_words(cols);
+}
+
+/**
+ * Stores table in the header: bit i%64 of bits[i/64] (STATE_RULE_WORDS
+ * words, written right after the header) is the output of entry i
+ * */
+void state_header_set_rule(state_header* header, const rule_table* table, uint64_t* bits){
+    int i;
+
+    memset(bits, 0, sizeof(uint64_t) * STATE_RULE_WORDS(table->num_inputs));
+    for(i=0; i<table->num_entries; i++)
+        bits[i / STATE_WORD_BITS] |= (uint64_t)CELL_BIT(table->outputs[i]) << (i % STATE_WORD_BITS);
+    header->rule_inputs = (uint32_t) table->num_inputs;
+    header->header_size = (uint32_t) header_size(table->num_inputs);
+    header->rule_id = state_rule_id(table);
+}
+
+/**
+ * Fills table with the rule stored in header (bits being the words that
+ * follow it). Returns 0 on success and -1 if there is no rule or it does
+ * not match the rule id
+ * */
+int state_rule_load(const state_header* header, const uint64_t* bits, rule_table* table){
+    int i;
+
+    if (header->rule_inputs == 0) return -1;
+    table->num_inputs = (int) header->rule_inputs;
+    table->num_entries = 1 << table->num_inputs;
+    table->outputs = (char*) calloc (sizeof(char), table->num_entries);
+    if (!table->outputs) return -1;
+    for(i=0; i<table->num_entries; i++)
+        table->outputs[i] = '0' + ((bits[i / STATE_WORD_BITS] >> (i % STATE_WORD_BITS)) & 1);
+    if (state_rule_id(table) != header->rule_id){
+        rule_table_destroy(table);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Checks that header, read from the beginning of a file of file_size
+ * bytes (name is only used in the messages), describes the whole file.
+ * Returns 0 if it does and -1 otherwise
+ * */
+int state_check_header(const state_header* header, uint64_t file_size, const char* name){
+    if (file_size < header_size(0)){
+        fprintf(stderr, "%s: too short for a state file\n", name);
+        return -1;
+    }
+    if (memcmp(header->magic, STATE_MAGIC, sizeof header->magic) != 0){
+        fprintf(stderr, "%s: not a state file\n", name);
+        return -1;
+    }
+    if (header->byte_order != STATE_BYTE_ORDER){
+        fprintf(stderr, "%s: written by a machine with another byte order\n", name);
+        return -1;
+    }
+    if (header->rule_inputs > STATE_MAX_RULE_INPUTS
+        || header->header_size < header_size(header->rule_inputs) || header->header_size % STATE_ALIGN != 0
+        || header->header_size > file_size || header->rows < 1 || header->cols < 1
+        || header->row_words != row_words(header->cols)
+        || header->rows > (file_size - header->header_size) / sizeof(uint64_t) / header->row_words){
+        fprintf(stderr, "%s: the header of the state file does not match its size\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Maps the state file open in f (name is only used in the messages) and
+ * checks that its header describes the whole file.
+ * Returns 0 on success and -1 if the file is not a valid state
+ * */
+int state_map(state_file* state, FILE* f, const char* name){
+    struct stat info;
+
+    state->map = NULL;
+    state->map_size = 0;
+    if (fstat(fileno(f), &info) != 0 || (uint64_t)info.st_size < header_size(0)){
+        fprintf(stderr, "%s: too short for a state file\n", name);
+        return -1;
+    }
+
+    state->map_size = (size_t)info.st_size;
+    state->map = mmap(NULL, state->map_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (state->map == MAP_FAILED){
+        fprintf(stderr, "%s: the state file could not be mapped in memory\n", name);
+        state->map = NULL;
+        return -1;
+    }
+    state->header = *(const state_header*) state->map;
+    if (state_check_header(&state->header, state->map_size, name) != 0){
+        state_unmap(state);
+        return -1;
+    }
+
+    //the engines read the rows from the first to the last
+    state->rows = (const uint64_t*) ((const char*) state->map + state->header.header_size);
+    posix_madvise(state->map, state->map_size, POSIX_MADV_SEQUENTIAL);
+    return 0;
+}
+
+void state_unmap(state_file* state){
+    if (state->map) munmap(state->map, state->map_size);
+    state->map = NULL;
+    state->rows = NULL;
+}
+
+/**
+ * Gives the kernel advice on the pages that hold the rows
+ * first_row..first_row+num_rows-1 of a mapped state
+ * */
+static void advise_rows(const state_file* state, uint64_t first_row, uint64_t num_rows, int advice){
+    uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+    uint64_t begin = state->header.header_size + first_row * state->header.row_words * sizeof(uint64_t);
+    uint64_t end = begin + num_rows * state->header.row_words * sizeof(uint64_t);
+
+    begin = begin / page * page;
+    if (end > state->map_size) end = state->map_size;
+    if (begin < end) madvise((char*) state->map + begin, end - begin, advice);
+}
+
+/**
+ * Starts reading the given rows of a mapped state in the background
+ * */
+void state_prefetch_rows(const state_file* state, uint64_t first_row, uint64_t num_rows){
+    advise_rows(state, first_row, num_rows, MADV_WILLNEED);
+}
+
+/**
+ * Lets the pages of the given rows of a mapped state go; they are read
+ * again from the file if they are used later
+ * */
+void state_release_rows(const state_file* state, uint64_t first_row, uint64_t num_rows){
+    advise_rows(state, first_row, num_rows, MADV_DONTNEED);
+}
+
+/**
+ * Writes num_cols cells of a packed row, starting at bit first_col of
+ * words, into cells as '0'/'1' characters. The cells are taken 4 at a
+ * time once the bit is a multiple of 4
+ * */
+void state_unpack_cells(const uint64_t* words, uint64_t first_col, uint64_t num_cols, char* cells){
+    uint64_t j = 0, bit = first_col;
+
+    for(; j<num_cols && bit % 4 != 0; j++, bit++)
+        cells[j] = '0' + ((words[bit / STATE_WORD_BITS] >> (bit % STATE_WORD_BITS)) & 1);
+    for(; j + 4 <= num_cols; j += 4, bit += 4)
+        memcpy(cells + j, nibble_cells[(words[bit / STATE_WORD_BITS] >> (bit % STATE_WORD_BITS)) & 15], 4);
+    for(; j<num_cols; j++, bit++)
+        cells[j] = '0' + ((words[bit / STATE_WORD_BITS] >> (bit % STATE_WORD_BITS)) & 1);
+}
+
+/**
+ * Writes num_cols cells of row, starting at column first_col, into cells
+ * as '0'/'1' characters
+ * */
+void state_get_cells(const state_file* state, uint64_t row, uint64_t first_col, uint64_t num_cols,
+                     char* cells){
+    state_unpack_cells(state_row(state, row), first_col, num_cols, cells);
+}
+
+/**
+ * Packs the num_cols '0'/'1' characters of cells into a row of words, the
+ * bits after the last cell being 0
+ * */
+void state_pack_cells(const char* cells, uint64_t num_cols, uint64_t* words){
+    uint64_t j;
+
+    memset(words, 0, sizeof(uint64_t) * row_words(num_cols));
+    for(j=0; j<num_cols; j++)
+        words[j / STATE_WORD_BITS] |= (uint64_t)CELL_BIT(cells[j]) << (j % STATE_WORD_BITS);
+}
+
+/**
+ * Identifies a transformation function by a 64-bit FNV-1a hash of its
+ * outputs, so that a state can tell which rule produced it. Never 0, the
+ * id of an unknown rule
+ * */
+uint64_t state_rule_id(const rule_table* table){
+    uint64_t hash = 14695981039346656037ULL;
+    int i;
+
+    hash = (hash ^ (uint64_t)table->num_inputs) * 1099511628211ULL;
+    for(i=0; i<table->num_entries; i++)
+        hash = (hash ^ (uint64_t)CELL_BIT(table->outputs[i])) * 1099511628211ULL;
+    return hash ? hash : 1;
+}
+
+/**
+ * Mixes the bits of x (the finalizer of splitmix64)
+ * */
+static inline uint64_t mix64(uint64_t x){
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Partial checksum of count words of the rows, the first of them being
+ * word first_index counting from the first word of the first row. The
+ * checksum of a state is the sum of the partial checksums of all its
+ * words, taken in any order, so that every process can add up its own
+ * words and the sums can be reduced
+ * */
+uint64_t state_words_checksum(const uint64_t* words, uint64_t first_index, uint64_t count){
+    uint64_t i, sum = 0;
+
+    for(i=0; i<count; i++) sum += mix64(words[i] ^ mix64(first_index + i));
+    return sum;
+}
+
+/**
+ * Checksum stored in the header for the given sum of partial checksums
+ * */
+uint32_t state_checksum_fold(uint64_t sum){
+    uint32_t checksum = (uint32_t) (sum ^ (sum >> 32));
+    return checksum ? checksum : 1;
+}
+
+/**
+ * Creates the state file path for a rows x cols matrix and writes its
+ * header, with rule if it is not NULL. The rows are then given one by one
+ * with state_writer_put_row.
+ * Returns 0 on success and -1 if the file could not be created
+ * */
+int state_writer_open(state_writer* w, const char* path, uint64_t rows, uint64_t cols,
+                      uint64_t generation, const rule_table* rule){
+    uint64_t area[STATE_MAX_HEADER_WORDS] = {0};
+
+    state_header_init(&w->header, rows, cols, generation, 0);
+    if (rule) state_header_set_rule(&w->header, rule, area + sizeof(state_header) / sizeof(uint64_t));
+    memcpy(area, &w->header, sizeof w->header);
+    w->rows_written = 0;
+    w->checksum = 0;
+
+    w->file = fopen(path, "wb");
+    w->row = (uint64_t*) calloc (sizeof(uint64_t), w->header.row_words);
+    if (!w->file || !w->row || fwrite(area, 1, w->header.header_size, w->file) != w->header.header_size){
+        fprintf(stderr, "%s: the state file could not be created\n", path);
+        if (w->file) fclose(w->file);
+        free(w->row);
+        w->file = NULL;
+        w->row = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Packs the next row of the matrix, given as cols '0'/'1' characters, and
+ * appends it to the file. Returns 0 on success and -1 on a write error
+ * */
+int state_writer_put_row(state_writer* w, const char* cells){
+    state_pack_cells(cells, w->header.cols, w->row);
+    return state_writer_put_words(w, w->row);
+}
+
+/**
+ * Appends the next row of the matrix, already packed into row_words words
+ * whose bits after the last cell are 0. Returns 0 on success and -1 on a
+ * write error
+ * */
+int state_writer_put_words(state_writer* w, const uint64_t* words){
+    if (fwrite(words, sizeof(uint64_t), w->header.row_words, w->file) != w->header.row_words){
+        fprintf(stderr, "Could not write row %llu of the state file\n", (unsigned long long)w->rows_written);
+        return -1;
+    }
+    w->checksum += state_words_checksum(words, w->rows_written * w->header.row_words, w->header.row_words);
+    w->rows_written++;
+    return 0;
+}
+
+/**
+ * Writes the checksum of the rows in the header and closes the file.
+ * Returns -1 if it could not be written completely or if it got fewer
+ * rows than its header announces, and 0 otherwise
+ * */
+int state_writer_close(state_writer* w){
+    int status = 0, written;
+
+    if (w->rows_written != w->header.rows){
+        fprintf(stderr, "The state file got %llu of its %llu rows\n",
+                (unsigned long long)w->rows_written, (unsigned long long)w->header.rows);
+        status = -1;
+    }
+    w->header.checksum = state_checksum_fold(w->checksum);
+    written = fseek(w->file, 0, SEEK_SET) == 0 && fwrite(&w->header, sizeof w->header, 1, w->file) == 1;
+    if (fclose(w->file) != 0 || !written){
+        fprintf(stderr, "Could not write the state file\n");
+        status = -1;
+    }
+    free(w->row);
+    w->file = NULL;
+    w->row = NULL;
+    return status;
+}
@@ -0,0 +1,236 @@
+#!/bin/sh
+# Copyright 2019 Lucia Fuentes Villodres
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Benchmark of the engines of one dimension. Every engine is run with its
+# output disabled and -B, which makes it time its generations (MPI_Wtime or
+# a monotonic clock, never clock()) and report them in a BENCH line; the
+# best of the repetitions is kept. Three studies are written, as CSV or JSON:
+#   engines  every engine on the same lattice, with 1 process and 1 thread
+#   strong   the parallel engines on the same lattice with more processes
+#            and threads
+#   weak     the same, with a lattice that grows with processes x threads
+#   still    (2D) the sequential and the MPI engine with 1 process and 1
+#            thread on a dead lattice, where they skip every tile after the
+#            first generation
+# speedup is the rate of cell updates per second over the one of the run
+# with 1 process and 1 thread of the same study and engine, and efficiency
+# that speedup divided by processes x threads. The script fails if an
+# engine of the still study is not at least twice as fast there as in the
+# engines study, which means it is not skipping the tiles.
+# MPIEXEC and MPIFLAGS choose how the MPI engines are started (for example
+# MPIFLAGS="--oversubscribe").
+
+usage(){
+    cat >&2 <<EOF
+Usage: $0 [-d 1|2] [-n size] [-g generations] [-p "processes..."] [-t "threads..."]
+          [-r repetitions] [-S seed] [-f csv|json] [-o output]
+  -d D  dimension of the engines (default 2)
+  -n N  cells of the side (2D) or of the lattice (1D) with 1 process and
+        1 thread (default 2048 in 2D, 1048576 in 1D)
+  -g G  generations of every run (default 100)
+  -p P  numbers of MPI processes (default "1 2 4")
+  -t T  numbers of threads (default "1 2 4")
+  -r R  repetitions of every run, the fastest is kept (default 3)
+  -S S  seed of the random configurations (default 1)
+  -f F  format of the report: csv (default) or json
+  -o F  file of the report (default: standard output)
+EOF
+    exit 1
+}
+
+dimension=2; size=""; generations=100; procs="1 2 4"; threads="1 2 4"
+repetitions=3; seed=1; format=csv; output=""
+while getopts "d:n:g:p:t:r:S:f:o:" option; do
+    case $option in
+        d) dimension=$OPTARG ;;
+        n) size=$OPTARG ;;
+        g) generations=$OPTARG ;;
+        p) procs=$OPTARG ;;
+        t) threads=$OPTARG ;;
+        r) repetitions=$OPTARG ;;
+        S) seed=$OPTARG ;;
+        f) format=$OPTARG ;;
+        o) output=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+case $dimension in 1|2) ;; *) usage ;; esac
+case $format in csv|json) ;; *) usage ;; esac
+[ -n "$size" ] || { [ "$dimension" = 2 ] && size=2048 || size=1048576; }
+MPIEXEC=${MPIEXEC:-mpiexec}
+
+root=$(cd "$(dirname "$0")" && pwd)
+sequential=$root/$dimension-Sequential
+parallel=$root/$dimension-Parallel
+make -s -C "$sequential" >&2 && make -s -C "$parallel" >&2 || exit 1
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT INT TERM
+results=$work/results.txt
+
+# input N: path of a random configuration of side (2D) or length (1D) N,
+# generated once per size. 2D inputs are state files, which every engine
+# loads without parsing
+input(){
+    if [ "$dimension" = 2 ]; then
+        [ -f "$work/in$1.state" ] || "$sequential/Cellular2D-Convert" -n "$1" -S "$seed" "$work/in$1.state" >&2
+        echo "$work/in$1.state"
+    else
+        [ -f "$work/in$1.txt" ] || awk -v n="$1" -v seed="$seed" 'BEGIN {
+            srand(seed); printf "%d\n", n
+            for (i = 0; i < n; i++) printf "%d", (rand() < 0.5)
+            printf "\n" }' > "$work/in$1.txt"
+        echo "$work/in$1.txt"
+    fi
+}
+
+# generated N: the same kind of configuration, generated in memory by
+# every process of a parallel engine for its own part, so that large
+# lattices need no file (in 2D, the same cells as input N)
+generated(){
+    echo "random:$1:0.5:$seed"
+}
+
+# size_for UNITS: size of the lattice that gives every one of UNITS
+# processes x threads the work of the base size
+size_for(){
+    awk -v n="$size" -v u="$1" -v d="$dimension" 'BEGIN {
+        printf "%d\n", (d == 2) ? int(n * sqrt(u) + 0.5) : n * u }'
+}
+
+# run STUDY PROCESSES THREADS COMMAND...: runs the command the given
+# times and adds the fastest report to the results
+run(){
+    study=$1; p=$2; t=$3; shift 3
+    best=""
+    i=0
+    while [ $i -lt "$repetitions" ]; do
+        line=$(cd "$work" && "$@" 2>&1 >/dev/null | grep '^BENCH' | tail -n 1)
+        if [ -z "$line" ]; then
+            echo "No report from: $*" >&2
+            return
+        fi
+        best=$(printf '%s\n%s\n' "$best" "$line" | awk '/^BENCH/ {
+            split($7, s, "="); if (!found || s[2] < min) { min = s[2]; keep = $0; found = 1 } }
+            END { print keep }')
+        i=$((i + 1))
+    done
+    echo "$best" | awk -v study="$study" '{
+        for (i = 2; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] }
+        print study, v["engine"], v["cells"], v["generations"], v["processes"], v["threads"],
+              v["seconds"], v["cell_updates_per_second"] }' >> "$results"
+    echo "$study $* done" >&2
+}
+
+# mpi PROCESSES COMMAND...: the command started by MPIEXEC
+mpi(){
+    n=$1; shift
+    # shellcheck disable=SC2086
+    $MPIEXEC $MPIFLAGS -n "$n" "$@"
+}
+
+if [ "$dimension" = 2 ]; then
+    rule=$sequential/gameOfLife.txt
+    in=$(input "$size")
+    run engines 1 1 "$sequential/Cellular2D-Sequential" -B -o 0 -t 1 "$in" "$rule" "$generations"
+    run engines 1 1 "$sequential/Cellular2D-Hashlife" -B -o 0 "$in" "$rule" "$generations"
+    run engines 1 1 "$sequential/Cellular2D-Stream" -B "$in" "$rule" "$generations" "$work/out.state"
+    run engines 1 1 mpi 1 "$parallel/Cellular2D-Parallel" -B -o 0 -t 1 "$(generated "$size")" "$rule" "$generations"
+    "$sequential/Cellular2D-Convert" -n "$size" -p 0 "$work/still$size.state" >&2
+    run still 1 1 "$sequential/Cellular2D-Sequential" -B -o 0 -t 1 "$work/still$size.state" "$rule" "$generations"
+    run still 1 1 mpi 1 "$parallel/Cellular2D-Parallel" -B -o 0 -t 1 "random:$size:0:$seed" "$rule" "$generations"
+    for study in strong weak; do
+        for t in $threads; do
+            n=$size; [ $study = weak ] && n=$(size_for "$t")
+            run $study 1 "$t" "$sequential/Cellular2D-Sequential" -B -o 0 -t "$t" "$(input "$n")" "$rule" "$generations"
+            for p in $procs; do
+                n=$size; [ $study = weak ] && n=$(size_for $((p * t)))
+                run $study "$p" "$t" mpi "$p" "$parallel/Cellular2D-Parallel" -B -o 0 -t "$t" \
+                    "$(generated "$n")" "$rule" "$generations"
+            done
+        done
+    done
+else
+    rule=$sequential/mod2.txt
+    in=$(input "$size")
+    run engines 1 1 "$sequential/Cellular1D-Packed" -B -o 0 -t 1 "$in" "$rule" "$generations"
+    run engines 1 1 "$sequential/Cellular1D-Hashlife" -B -o 0 "$in" "$rule" "$generations"
+    run engines 1 1 mpi 1 "$parallel/Cellular1D-Parallel" -B -o 0 "$(generated "$size")" "$rule" "$generations"
+    for study in strong weak; do
+        for t in $threads; do
+            n=$size; [ $study = weak ] && n=$(size_for "$t")
+            run $study 1 "$t" "$sequential/Cellular1D-Packed" -B -o 0 -t "$t" "$(input "$n")" "$rule" "$generations"
+        done
+        for p in $procs; do
+            n=$size; [ $study = weak ] && n=$(size_for "$p")
+            run $study "$p" 1 mpi "$p" "$parallel/Cellular1D-Parallel" -B -o 0 "$(generated "$n")" "$rule" \
+                "$generations"
+        done
+    done
+fi
+
+# speedup and efficiency against the run of 1 process and 1 thread of the
+# same study and engine
+report(){
+    awk -v format="$format" '
+        { row[NR] = $0; if ($5 == 1 && $6 == 1) base[$1 " " $2] = $8 }
+        END {
+            if (format == "csv")
+                print "study,engine,cells,generations,processes,threads,seconds,cell_updates_per_second,speedup,efficiency"
+            else
+                print "["
+            for (i = 1; i <= NR; i++) {
+                split(row[i], f, " ")
+                b = base[f[1] " " f[2]]
+                speedup = (b > 0) ? f[8] / b : 0
+                efficiency = speedup / (f[5] * f[6])
+                if (format == "csv")
+                    printf "%s,%s,%s,%s,%s,%s,%s,%s,%.4f,%.4f\n", f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8],
+                           speedup, efficiency
+                else
+                    printf "  {\"study\": \"%s\", \"engine\": \"%s\", \"cells\": %s, \"generations\": %s, " \
+                           "\"processes\": %s, \"threads\": %s, \"seconds\": %s, \"cell_updates_per_second\": %s, " \
+                           "\"speedup\": %.4f, \"efficiency\": %.4f}%s\n", f[1], f[2], f[3], f[4], f[5], f[6], f[7],
+                           f[8], speedup, efficiency, (i < NR) ? "," : ""
+            }
+            if (format == "json") print "]"
+        }' "$results"
+}
+
+# check_still: fails if an engine updates the dead lattice of the still
+# study less than twice as fast as the random one of the engines study
+check_still(){
+    awk '
+        $1 == "engines" { random[$2] = $8 }
+        $1 == "still" { still[$2] = $8 }
+        END {
+            for (engine in still) {
+                if (!(engine in random) || still[engine] >= 2 * random[engine]) continue
+                printf "%s is only %.2f times as fast on a dead lattice as on a random one: it is not skipping " \
+                       "the tiles that can not change\n", engine, still[engine] / random[engine] > "/dev/stderr"
+                failed = 1
+            }
+            exit failed
+        }' "$results"
+}
+
+[ -f "$results" ] || { echo "No run could be timed" >&2; exit 1; }
+if [ -n "$output" ]; then report > "$output"; else report; fi
+check_still